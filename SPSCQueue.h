@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// lock-free single producer / single consumer ring buffer
+// push() must only be called by one thread, pop() / waitPop() by one other thread
+template <typename T>
+class SPSCQueue
+{
+public:
+  SPSCQueue(size_t capacity = 1) { reset(capacity); }
+
+  // not thread safe, only call while neither side uses the queue
+  void reset(size_t capacity)
+  {
+    // one element stays unused to tell full from empty
+    m_items.assign(capacity + 1, T());
+    m_head = 0;
+    m_tail = 0;
+  }
+
+  // returns false if the queue is full
+  bool push(const T& item)
+  {
+    size_t const tail = m_tail.load(std::memory_order_relaxed);
+    size_t const next = (tail + 1) % m_items.size();
+    if(next == m_head.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    m_items[tail] = item;
+    m_tail.store(next, std::memory_order_release);
+
+    m_event.fetch_add(1, std::memory_order_release);
+    m_event.notify_one();
+    return true;
+  }
+
+  // returns false if the queue is empty
+  bool pop(T& item)
+  {
+    size_t const head = m_head.load(std::memory_order_relaxed);
+    if(head == m_tail.load(std::memory_order_acquire))
+    {
+      return false;
+    }
+
+    item = m_items[head];
+    m_head.store((head + 1) % m_items.size(), std::memory_order_release);
+    return true;
+  }
+
+  // blocks until an item was pushed or wake() was called
+  // returns false without an item if cancel is set or on wake()
+  bool waitPop(T& item, const std::atomic<bool>& cancel)
+  {
+    uint32_t const event = m_event.load(std::memory_order_acquire);
+    if(pop(item))
+    {
+      return true;
+    }
+    if(cancel)
+    {
+      return false;
+    }
+
+    m_event.wait(event, std::memory_order_acquire);
+    return pop(item);
+  }
+
+  // waitPop() with a deadline, returns false without an item once it passed
+  // std::atomic::wait() can't time out, so this polls in short sleeps
+  template <typename Clock, typename Duration>
+  bool waitPopUntil(T& item, const std::atomic<bool>& cancel, std::chrono::time_point<Clock, Duration> deadline)
+  {
+    while(!pop(item))
+    {
+      if(cancel || Clock::now() >= deadline)
+      {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+  }
+
+  // wakes up a consumer blocked in waitPop(), may be called from any thread
+  void wake()
+  {
+    m_event.fetch_add(1, std::memory_order_release);
+    m_event.notify_all();
+  }
+
+private:
+  std::vector<T>        m_items;
+  std::atomic<size_t>   m_head{ 0 };   // next item to pop, written by the consumer
+  std::atomic<size_t>   m_tail{ 0 };   // next item to push, written by the producer
+  std::atomic<uint32_t> m_event{ 0 };  // incremented on push() and wake()
+};
@@ -23,691 +23,4089 @@
 #include "VKDDisplay.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
+#include <stdexcept>
 
 
 VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 
 
-typedef VkResult(*PFN_vkAcquireWinrtDisplayNV)(VkPhysicalDevice physicalDevice, VkDisplayKHR display);
-PFN_vkAcquireWinrtDisplayNV pfn_vkAcquireWinrtDisplayNV = nullptr;
-
 // required instance extenstions
 const std::vector<const char*> requiredInstanceExtensions = { 
   VK_KHR_SURFACE_EXTENSION_NAME, 
-  VK_KHR_DISPLAY_EXTENSION_NAME,
   VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
   VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME,
-  VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME,
-  VK_EXT_DIRECT_MODE_DISPLAY_EXTENSION_NAME 
+  VK_KHR_EXTERNAL_SEMAPHORE_CAPABILITIES_EXTENSION_NAME
+};
+
+// instance extensions for display plane surfaces
+const std::vector<const char*> displayInstanceExtensions = {
+  VK_KHR_DISPLAY_EXTENSION_NAME,
+  VK_EXT_DIRECT_MODE_DISPLAY_EXTENSION_NAME
+};
+
+// instance extensions for Config::headless
+const std::vector<const char*> headlessInstanceExtensions = {
+  VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME
+};
+
+// instance extension needed for VK_EXT_display_control, Config::beamRacingSlices
+const std::vector<const char*> displayControlInstanceExtensions = {
+  VK_EXT_DISPLAY_SURFACE_COUNTER_EXTENSION_NAME
 };
 
 // required device extensions
 const std::vector<const char*> requiredDeviceExtensions = {
   VK_KHR_SWAPCHAIN_EXTENSION_NAME,
   VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
-  VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
-  VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME,
-  VK_KHR_EXTERNAL_SEMAPHORE_WIN32_EXTENSION_NAME,
-  VK_NV_ACQUIRE_WINRT_DISPLAY_EXTENSION_NAME
+  VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME
+  // + VKDPlatform::getDeviceExtensions()
 };
 
-VKDirectDisplay::VKDirectDisplay() {}
+// device extensions needed for SyncMode::eTimeline
+const std::vector<const char*> timelineDeviceExtensions = {
+  VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+  VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME
+};
+
+// device extensions to query if interop images need a dedicated allocation (Config::pooledInteropMemory)
+const std::vector<const char*> dedicatedDeviceExtensions = {
+  VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME,
+  VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME
+};
+
+// device extensions needed for Config::framePacing
+const std::vector<const char*> presentWaitDeviceExtensions = {
+  VK_KHR_PRESENT_ID_EXTENSION_NAME,
+  VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+};
+
+// consecutive budget timeouts before a wait gives up, see waitReleased() and acquireImage()
+const uint32_t maxStallTimeouts = 10;
 
-bool VKDirectDisplay::init()
+namespace {
+double toMs(std::chrono::steady_clock::duration d)
 {
-  try
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::chrono::steady_clock::duration fromMs(double ms)
+{
+  return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(ms));
+}
+
+// sleep for most of the time, spin for the last bit to hit the target accurately
+void sleepUntil(std::chrono::steady_clock::time_point t)
+{
+  auto const spin = std::chrono::milliseconds(1);
+  auto       now  = std::chrono::steady_clock::now();
+  if(t - now > spin)
   {
-    createInstance();
-    pickGPU();
-    createDisplaySurface();
-    createLogicalDevice();
-    createCommandPool();
-    createSwapchain();
-    createSyncObjects();
-    createSyncs();
-    createCommandBuffers();
-    return true;
+    std::this_thread::sleep_until(t - spin);
   }
-  catch(std::exception const& e)
+  while(std::chrono::steady_clock::now() < t)
   {
-    PRINTE("VKDirectDisplay::init() failed: {}\n", e.what());
-    return false;
+    std::this_thread::yield();
   }
 }
 
-void VKDirectDisplay::shutdown()
+// lower case hex digits, for device UUIDs
+std::string toHex(const uint8_t* data, size_t size)
 {
-  m_device->waitIdle();
+  static const char digits[] = "0123456789abcdef";
+  std::string       hex;
+  for(size_t i = 0; i < size; ++i)
+  {
+    hex += digits[data[i] >> 4];
+    hex += digits[data[i] & 15];
+  }
+  return hex;
 }
 
-GLuint VKDirectDisplay::getTexture()
+// releases a semaphore imported into GL and its exported handle
+void deleteInteropSemaphore(GLuint& g, VKDPlatform::Handle& h)
 {
-  // GL: wait for VK image available
-  glWaitSemaphoreEXT(m_syncData[m_frameIndex].m_availableGL, 0, nullptr, 0, nullptr, nullptr);
-
-  return m_syncData[m_frameIndex].m_textureGL;
+  if(g)
+  {
+    glDeleteSemaphoresEXT(1, &g);
+    g = 0;
+  }
+  VKDPlatform::closeHandle(h);
 }
 
-void VKDirectDisplay::submitTexture()
+// bytes per texel of the formats VKDPlatform::getGLFormat() knows
+uint32_t getTexelSize(vk::Format format)
 {
-  // GL: signal rendering is done
-  // VK: acquire image from swapchain
-  // VK: blit texture to swapchain image (wait for GL finished, VK image acquired. signal VK blit done)
-  // present (wait for VK blit done. signal VK image available)
-
-  // limit frames in flight
-  m_device->waitForFences(m_fences[m_frameIndex].get(), VK_TRUE, UINT64_MAX);
-  m_device->resetFences({ m_fences[m_frameIndex].get() });
-
-  // GL: signal to VK that rendering is done
-  glSignalSemaphoreEXT(m_syncData[m_frameIndex].m_finishedGL, 0, nullptr, 0, nullptr, nullptr);
+  return format == vk::Format::eR16G16B16A16Sfloat ? 8 : 4;
+}
 
-  // RFE: handle return values
-  auto r = m_device->acquireNextImageKHR(m_swapchain.get(), std::numeric_limits<uint64_t>::max(),
-                                         m_imageAcquiredSemaphores[m_frameIndex].get());
-  assert(m_frameIndex == r.value);  // this should be guaranteed, decoupling would mean N*M prepared blit command buffers
-  
-  // wait for GL finished & VK imageAcquired
-  // blit/copy current texture onto current swapchain image
-  // signal VK blit finished
-  std::vector<vk::Semaphore> blitWaitSemaphores{m_syncData[m_frameIndex].m_finished.get(),
-                                                m_imageAcquiredSemaphores[m_frameIndex].get()};
-  std::vector<vk::PipelineStageFlags> blitWaitStages{vk::PipelineStageFlagBits::eColorAttachmentOutput, 
-                                                     vk::PipelineStageFlagBits::eColorAttachmentOutput};
-  std::vector<vk::Semaphore> blitSignalSemaphores{m_blitFinishedSemaphores[m_frameIndex].get()};
+// moves the destination of a blit by shift and clips it to extent, the source follows
+// false if nothing is left
+bool clipBlit(std::array<vk::Offset3D, 2>& src, std::array<vk::Offset3D, 2>& dst, vk::Offset2D shift, vk::Extent2D extent)
+{
+  auto clipAxis = [](int32_t& s0, int32_t& s1, int32_t& d0, int32_t& d1, int32_t limit) {
+    // d0 > d1 for a flipped axis, source positions map linearly
+    float const   scale = float(s1 - s0) / float(d1 - d0);
+    int32_t const c0    = std::clamp(d0, 0, limit);
+    int32_t const c1    = std::clamp(d1, 0, limit);
+    int32_t const base  = s0;
+    s0                  = base + int32_t(float(c0 - d0) * scale);
+    s1                  = base + int32_t(float(c1 - d0) * scale);
+    d0                  = c0;
+    d1                  = c1;
+    return c0 != c1;
+  };
 
-  vk::SubmitInfo submitInfo{blitWaitSemaphores,
-                            blitWaitStages, 
-                            m_blitCommandBuffers[m_frameIndex],
-                            blitSignalSemaphores };
-  m_presentQueue.submit(submitInfo, m_fences[m_frameIndex].get());
+  dst[0].x += shift.x;
+  dst[1].x += shift.x;
+  dst[0].y += shift.y;
+  dst[1].y += shift.y;
+  bool const x = clipAxis(src[0].x, src[1].x, dst[0].x, dst[1].x, int32_t(extent.width));
+  bool const y = clipAxis(src[0].y, src[1].y, dst[0].y, dst[1].y, int32_t(extent.height));
+  return x && y;
+}
 
-  // wait for VK blit finished
-  // present
-  std::vector<vk::Semaphore> presentWaitSemaphores{m_blitFinishedSemaphores[m_frameIndex].get()};
-  vk::PresentInfoKHR presentInfo{ presentWaitSemaphores,
-                                 m_swapchain.get(),
-                                 m_frameIndex };  
-  // VK_KHR_display
-  // present on Direct Display output
-  auto const present_result = m_presentQueue.presentKHR(presentInfo);
+// the legacy stage bits have the same values in VK_KHR_synchronization2
+vk::PipelineStageFlags2KHR toStage2(vk::PipelineStageFlags stages)
+{
+  return vk::PipelineStageFlags2KHR(VkPipelineStageFlags2KHR(VkPipelineStageFlags(stages)));
+}
+}  // namespace
 
-  // signal to GL that the interop texture is available
-  vk::SubmitInfo signalInfo{ {},{},{}, m_syncData[m_frameIndex].m_available.get() };
-  m_presentQueue.submit(signalInfo);
+VKDirectDisplay::VKDirectDisplay() {}
 
-  m_frameIndex = (m_frameIndex + 1) % m_swapchainImages.size();
+bool VKDirectDisplay::init(const Config& config)
+{
+  return initDevice(config) && initInterop();
 }
 
-void VKDirectDisplay::createInstance()
+bool VKDirectDisplay::initDevice(const Config& config)
 {
-#if VK_HEADER_VERSION >= 304
-  vk::detail::DynamicLoader dl;
-#else
-  vk::DynamicLoader dl;
-#endif
-  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr =
-    dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
-  VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
-
-  // check for required instance extensions
-  std::vector<vk::ExtensionProperties> availableInstanceExtensions = vk::enumerateInstanceExtensionProperties();
+  try
   {
-    uint32_t major = VK_API_VERSION_MAJOR(VK_HEADER_VERSION_COMPLETE);
-    uint32_t minor = VK_API_VERSION_MINOR(VK_HEADER_VERSION_COMPLETE);
-    uint32_t patch = VK_API_VERSION_PATCH(VK_HEADER_VERSION_COMPLETE);
-    PRINTI("\n\nVK Header version: {}.{}.{}\n", major, minor, patch);
-  }
-
-  std::cout << "\nChecking Instance Extensions\n";
+    m_config                   = config;
+    m_syncMode                 = config.syncMode;
+    m_requestedFramesInFlight  = config.framesInFlight;
+    m_requestedSwapchainImages = config.swapchainImageCount;
+    m_presentPolicy            = config.presentPolicy;
+    m_requestedPresentMode     = config.presentMode;
+    m_dropFramesOnStall        = config.dropFramesOnStall;
+    m_requestedCopyFastPath    = config.copyFastPath;
+    m_requestedPooledMemory    = config.pooledInteropMemory;
+    m_requestedTransferQueue   = config.transferQueue;
+    m_requestedPresentThread   = config.presentThread;
+    m_headless                 = config.headless;
+    m_native                   = config.nativeRenderer;
+    m_compositor               = config.layerCount && !config.nativeRenderer;
+    // the native renderer and the compositor always render at full resolution
+    m_resolution.enabled       = config.dynamicResolution && !config.nativeRenderer && !m_compositor;
+    m_resolution.automatic     = config.autoRenderScale;
+    m_resolution.budget        = config.renderBudget;
+    m_resolution.minScale      = std::clamp(config.minRenderScale, 0.1f, 1.0f);
+    m_resolution.scale         = 1.0f;
+    std::copy(std::begin(config.stallBudgetMs), std::end(config.stallBudgetMs), m_stallBudgetMs);
 
-  for(const auto& required : requiredInstanceExtensions)
-  {
-    bool found = false;
-    for(const auto& available : availableInstanceExtensions)
+    createInstance();
+    pickGPU();
+    createDisplaySurfaces();
+    if(m_syncMode == SyncMode::eTimeline && !checkTimelineSupport())
     {
-      if(std::string(required) == available.extensionName)
+      PRINTW("Timeline semaphores not supported, falling back to binary semaphores\n");
+      m_syncMode = SyncMode::eBinary;
+    }
+    if(m_native)
+    {
+      // no GL to synchronize with, the per frame fences are all that's needed
+      m_syncMode = SyncMode::eBinary;
+      if(m_requestedPresentThread)
       {
-        found = true;
-        PRINTOK("OK: {}\n", required);
-        break;
+        PRINTW("The present thread is not available with the native renderer, disabling it\n");
+        m_requestedPresentThread = false;
       }
     }
-    if(!found)
+    if(config.layerCount && m_native)
     {
-      throw std::exception(("Required instance extension not found: " + std::string(required) + "\n").c_str());
+      PRINTW("The compositor is not available with the native renderer, disabling it\n");
     }
+    if(m_compositor)
+    {
+      // each layer synchronizes with its producer through timeline semaphores of its own,
+      // the composed frames are VK only and use the per frame fences like the native renderer's, see usesFences()
+      if(m_syncMode != SyncMode::eTimeline)
+      {
+        throw std::runtime_error("the compositor needs timeline semaphores");
+      }
+      if(m_requestedPresentThread)
+      {
+        PRINTW("The present thread is not available with the compositor, disabling it\n");
+        m_requestedPresentThread = false;
+      }
+    }
+    m_frameSynthesis = config.frameSynthesis && m_requestedPresentThread;
+    m_reprojection   = config.reprojection;
+    if(config.frameSynthesis && !m_frameSynthesis)
+    {
+      // without the present thread nothing runs while GL renders
+      PRINTW("Frame synthesis needs the present thread, disabling it\n");
+    }
+    m_beamRacing.slices = std::min(config.beamRacingSlices, 64u);
+    m_beamRacing.leadMs = config.beamRacingLeadMs;
+    if(m_beamRacing.slices
+       && (m_syncMode != SyncMode::eTimeline || m_requestedPresentThread || config.framePacing || m_resolution.enabled || m_native || m_compositor))
+    {
+      // every slice is a GL -> VK timeline value, handed over by the GL thread in step with the scanout
+      PRINTW("Beam racing needs timeline semaphores and is not available with the present thread, frame pacing, "
+             "dynamic resolution, the native renderer or the compositor, disabling it\n");
+      m_beamRacing.slices = 0;
+    }
+    if(m_beamRacing.slices)
+    {
+      // the tears at the slice boundaries are the point
+      m_presentPolicy        = PresentPolicy::eExplicit;
+      m_requestedPresentMode = vk::PresentModeKHR::eImmediate;
+    }
+    m_hasDisplayControl = m_beamRacing.slices && m_hasSurfaceCounter && VKDPlatform::hasDeviceExtension(m_gpu, VK_EXT_DISPLAY_CONTROL_EXTENSION_NAME);
+    m_incrementalPresent = config.incrementalPresent && VKDPlatform::hasDeviceExtension(m_gpu, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+    // Config::crossDeviceTransfer: whether it's needed is only known once GL is up, enable it on the display GPU just in case
+    m_hasHostImport = config.crossDeviceTransfer && !m_native && VKDPlatform::hasDeviceExtension(m_gpu, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+    if(config.incrementalPresent && !m_incrementalPresent)
+    {
+      PRINTW("NOT FOUND: {}, presenting without damage\n", VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+    }
+    m_pacing.enabled  = config.framePacing;
+    m_pacing.marginMs = config.pacingMarginMs;
+    m_governor.divisor         = config.refreshDivisor;
+    m_governor.variableRefresh = config.variableRefresh;
+    m_governor.last            = {};
+    if(m_pacing.enabled && config.presentThread)
+    {
+      // vkWaitForPresentKHR would race with vkQueuePresentKHR on the present thread
+      PRINTW("Frame pacing is not available together with the present thread, disabling it\n");
+      m_pacing.enabled = false;
+    }
+    if(m_pacing.enabled && !checkPresentWaitSupport())
+    {
+      PRINTW("Present wait not supported, disabling frame pacing\n");
+      m_pacing.enabled = false;
+    }
+    // Config::refreshDivisor: the governor puts its grid on measured vblanks if it can, see measureVblank()
+    m_pacing.presentWait = m_pacing.enabled || (m_governor.divisor && !config.presentThread && checkPresentWaitSupport());
+    // the first display sets the pace
+    m_pacing.periodMs = 1.0e6 / m_outputs[0].display.modeProperties.parameters.refreshRate;  // refreshRate is in mHz
+    m_pacing.epoch    = Pacing::Clock::now();
+    createLogicalDevice();
+    createCommandPool();
+    createSwapchain();
+    if(m_beamRacing.slices && m_presentMode != vk::PresentModeKHR::eImmediate)
+    {
+      PRINTW("Immediate present mode not supported, disabling beam racing\n");
+      m_beamRacing.slices = 0;
+    }
+    return true;
   }
-  vk::InstanceCreateInfo createInfo{
-      vk::InstanceCreateFlags(), nullptr, 0, nullptr,
-      uint32_t(requiredInstanceExtensions.size()), requiredInstanceExtensions.data()};
-  m_instance = vk::createInstanceUnique(createInfo);
-
-  VULKAN_HPP_DEFAULT_DISPATCHER.init(m_instance.get());
-
+  catch(std::exception const& e)
   {
-    uint32_t apiVersion;
-    vkEnumerateInstanceVersion(&apiVersion);
-    uint32_t major = VK_API_VERSION_MAJOR(apiVersion);
-    uint32_t minor = VK_API_VERSION_MINOR(apiVersion);
-    uint32_t patch = VK_API_VERSION_PATCH(apiVersion);
-    PRINTI("Instance version: {}.{}.{}", major, minor, patch);
+    PRINTE("VKDirectDisplay::initDevice() failed: {}\n", e.what());
+    return false;
   }
-
-  pfn_vkAcquireWinrtDisplayNV = (PFN_vkAcquireWinrtDisplayNV)vkGetInstanceProcAddr(m_instance.get(), "vkAcquireWinrtDisplayNV");
 }
 
-bool VKDirectDisplay::checkDeviceExtensionSupport(vk::PhysicalDevice device)
+bool VKDirectDisplay::initInterop()
 {
-  std::vector<vk::ExtensionProperties> availableDeviceExtensions = device.enumerateDeviceExtensionProperties();
-
-  std::cout << "\nChecking Device Extensions\n";
-
-  for(const auto& required : requiredDeviceExtensions)
+  try
   {
-    bool found = false;
-    for(const auto& available : availableDeviceExtensions)
+    if(m_native)
     {
-      if(std::string(required) == available.extensionName)
+      m_renderer.init(m_gpu, m_device.get(), m_graphicsFamily, m_graphicsQueue);
+    }
+    else
+    {
+      // the interop textures have to live on the GPU GL renders on
+      vk::PhysicalDevice const glGpu = VKDTransfer::findGLDevice(m_instance.get());
+      if(glGpu && glGpu != m_gpu)
       {
-        found = true;
-        PRINTOK("OK: {}\n", required);
-        break;
+        if(m_compositor)
+        {
+          throw std::runtime_error("the compositor needs GL to render on the display GPU");
+        }
+        if(!m_config.crossDeviceTransfer)
+        {
+          throw std::runtime_error("GL renders on another GPU than the display GPU");
+        }
+        if(m_syncMode != SyncMode::eTimeline)
+        {
+          throw std::runtime_error("the cross device transfer needs timeline semaphores");
+        }
+        if(m_beamRacing.slices)
+        {
+          PRINTW("Beam racing is not available with the cross device transfer, disabling it\n");
+          m_beamRacing.slices = 0;
+        }
+        if(!m_requestedPresentThread)
+        {
+          // VKDTransfer::copy() waits on the host for the render GPU, on the present thread that overlaps GL's next frame
+          PRINTW("The cross device transfer needs the present thread, turning it on\n");
+          m_requestedPresentThread = true;
+          // vkWaitForPresentKHR would race with vkQueuePresentKHR on the present thread
+          if(m_pacing.enabled)
+          {
+            PRINTW("Frame pacing is not available together with the present thread, disabling it\n");
+          }
+          m_pacing.enabled     = false;
+          m_pacing.presentWait = false;
+        }
+        m_transfer.init(m_instance.get(), glGpu, m_gpu, m_device.get(), m_hasHostImport);
       }
     }
-    if(!found)
+    if(!m_config.exportName.empty())
     {
-      std::cerr << "\x1B[31mNOT FOUND: " << required << "\033[0m\n";
-      return false;
+      if(m_native || m_compositor || m_transfer.isActive() || m_syncMode != SyncMode::eTimeline || m_resolution.enabled || m_beamRacing.slices)
+      {
+        PRINTW("Exporting frames needs timeline semaphores and GL textures shared with this device, not exporting them\n");
+      }
+      else
+      {
+        // consumers are optional, the display works without them
+        try
+        {
+          m_export.init(m_config.exportName, m_gpu);
+        }
+        catch(std::exception const& e)
+        {
+          PRINTW("Exporting frames failed: {}\n", e.what());
+          m_export.deinit();
+        }
+      }
+    }
+    createSyncObjects();
+    if(m_compositor)
+    {
+      createLayers();
+    }
+    createSyncs();
+    createCommandBuffers();
+    if(m_requestedPresentThread)
+    {
+      startPresentThread();
+    }
+    if(m_beamRacing.slices)
+    {
+      startVblankThread();
     }
+    return true;
+  }
+  catch(std::exception const& e)
+  {
+    PRINTE("VKDirectDisplay::initInterop() failed: {}\n", e.what());
+    return false;
   }
-  return true;
 }
 
-void VKDirectDisplay::pickGPU()
+void VKDirectDisplay::shutdown()
 {
-  // pick a GPU that has the required device extensions and has a display device attached
-  std::vector<vk::PhysicalDevice> devices = m_instance->enumeratePhysicalDevices();
-  PRINTI("\n\nFinding GPU with suitable display...\n\n");
-  for(const auto& device : devices)
+  if(!m_device)
   {
-    const auto props = device.getProperties();
-    PRINTI("\nName:        {}\n", props.deviceName.data());
+    return;
+  }
 
-    uint32_t major = VK_API_VERSION_MAJOR(props.apiVersion);
-    uint32_t minor = VK_API_VERSION_MINOR(props.apiVersion);
-    uint32_t patch = VK_API_VERSION_PATCH(props.apiVersion);
-    PRINTI("API version: {}.{}.{}\n", major, minor, patch);
+  // GL may still reference the interop textures, VK may still blit from them
+  stopPresentThread();
+  stopVblankThread();
+  releaseLayers();
+  glFinish();
+  m_device->waitIdle();
 
-    if(!device.getDisplayPropertiesKHR().empty() && checkDeviceExtensionSupport(device))
-    {
-      // VK_KHR_display
-      // GPU with ddisplay found
-      PRINTI("Suitable device found\n");
-      m_gpu = device;
-      break;
-    }
-    PRINTE("Device not suitable\n");
+  // children before parents: interop objects, per frame objects, swapchain, device, surface, display, instance
+  destroySyncObjects();
+  destroyLayers();
+  m_renderer.deinit();
+  m_transfer.deinit();
+  m_export.deinit();
+  m_fences.clear();
+  m_synthFence.reset();
+  m_timestampPool.reset();
+  for(auto& o : m_outputs)
+  {
+    o.freeAcquireSemaphores.clear();
+    o.imageAcquireSemaphores.clear();
+    o.acquireSemaphores.clear();
+    o.blitFinishedSemaphores.clear();
+    o.ownedSemaphores.clear();
+    o.synthAcquired.reset();
+    o.sliceAcquired.clear();
+    o.swapchain.reset();
   }
-  if(!m_gpu)
+  m_blitPool = nullptr;
+  m_presentPool.reset();
+  m_transferPool.reset();
+  m_commandPool.reset();
+  m_device.reset();
+  for(auto& o : m_outputs)
   {
-    throw std::exception("Could not find a GPU with suitable display device!");
+    o.surface.reset();
+    if(o.display.acquired)
+    {
+      m_gpu.releaseDisplayEXT(o.display.displayKHR);
+      o.display.acquired = false;
+    }
   }
+  m_outputs.clear();
+  m_platform.shutdown();
+  m_gpu = nullptr;
+  m_instance.reset();
 
+  m_frameIndex    = 0;
+  m_pacing        = Pacing();
+  m_recreateFlags = 0;
 }
 
-void VKDirectDisplay::createDisplaySurface()
+bool VKDirectDisplay::isSuspended() const
 {
-  // RFE: make display id & resolution cmd line controllable?
+  return std::none_of(m_outputs.begin(), m_outputs.end(), [](const Output& o) { return bool(o.swapchain); });
+}
 
-  // VK_KHR_display
-  // create a display surface for ddisplay
+bool VKDirectDisplay::reinit()
+{
+  Config const config = m_config;
+  shutdown();
+  return init(config);
+}
 
-  // pick first available display
-  m_display.displayProperties = m_gpu.getDisplayPropertiesKHR()[0];
-  m_display.displayKHR        = m_display.displayProperties.display;
+const char* VKDirectDisplay::getDisplayName(uint32_t output) const
+{
+  const char* name = m_outputs[output].display.displayProperties.displayName;
+  return name ? name : "unnamed";
+}
 
-  // acquire display
-  m_gpu.acquireWinrtDisplayNV(m_display.displayKHR);
+std::vector<VKDirectDisplay::DisplayModeInfo> VKDirectDisplay::getDisplayModes(uint32_t output) const
+{
+  auto const& display = m_outputs[output].display;
+  auto const& active  = display.modeProperties.parameters;
+  if(m_headless)
+  {
+    return {{active.visibleRegion, active.refreshRate / 1000.0f, true}};
+  }
 
-  // pick highest available resolution
-  auto modes               = m_gpu.getDisplayModePropertiesKHR(m_display.displayKHR);
-  m_display.modeProperties = modes[0];
-  for(auto& m : modes)
+  std::vector<DisplayModeInfo> infos;
+  for(const auto& m : m_gpu.getDisplayModePropertiesKHR(display.displayKHR))
   {
-    auto ires = m.parameters.visibleRegion;
-    auto ifreq = m.parameters.refreshRate;
-    auto cres = m_display.modeProperties.parameters.visibleRegion;
-    auto cfreq = m_display.modeProperties.parameters.refreshRate;
-    if(ires.height * ires.width + ifreq > cres.height * cres.width + cfreq )
-    {
-      m_display.modeProperties = m;
-    }
+    infos.push_back({m.parameters.visibleRegion, m.parameters.refreshRate / 1000.0f, m.displayMode == display.modeProperties.displayMode});
   }
+  return infos;
+}
 
-  // pick first compatible plane
-  auto     planes = m_gpu.getDisplayPlanePropertiesKHR();
-  uint32_t planeIndex;
-  bool     foundPlane = false;
-  for(uint32_t i = 0; i < planes.size(); ++i)
+void VKDirectDisplay::setModePolicy(ModePolicy policy, uint32_t width, uint32_t height, float refreshHz)
+{
+  m_config.modePolicy    = policy;
+  m_config.modeWidth     = width;
+  m_config.modeHeight    = height;
+  m_config.modeRefreshHz = refreshHz;
+}
+
+float VKDirectDisplay::fitModeToRenderTime()
+{
+  if(m_pacing.renderMs <= 0.0)
   {
-    auto p = planes[i];
+    return 0.0f;
+  }
 
-    // skip planes bound to different display
-    if(p.currentDisplay && (p.currentDisplay != m_display.displayKHR))
-    {
-      continue;
-    }
+  // what a frame takes from the start of GL rendering until it can be presented
+  m_config.modePolicy      = ModePolicy::eFitRenderTime;
+  m_config.modeFrameTimeMs = float(m_pacing.renderMs + m_pacing.blitMs + m_pacing.marginMs);
+  return m_config.modeFrameTimeMs;
+}
 
-    auto supportedDisplays = m_gpu.getDisplayPlaneSupportedDisplaysKHR(i);
+bool VKDirectDisplay::setFrameCounts(uint32_t framesInFlight, uint32_t swapchainImageCount)
+{
+  try
+  {
+    // GL may still reference the interop textures, VK may still blit from them
+    bool const presentThread = m_presentThread.joinable();
+    stopPresentThread();
+    releaseLayers();
+    glFinish();
+    m_device->waitIdle();
 
-    for(auto& d : supportedDisplays)
+    destroySyncObjects();
+
+    m_requestedFramesInFlight    = framesInFlight;
+    m_config.framesInFlight      = framesInFlight;
+    m_config.swapchainImageCount = swapchainImageCount;
+    if(swapchainImageCount != m_requestedSwapchainImages)
     {
-      if(d == m_display.displayKHR)
-      {
-        foundPlane = true;
-        planeIndex = i;
-        break;
-      }
+      m_requestedSwapchainImages = swapchainImageCount;
+      createSwapchain();
     }
 
-    if(foundPlane)
+    createSyncObjects();
+    createSyncs();
+    createCommandBuffers();
+    m_frameIndex = 0;
+    if(presentThread)
     {
-      break;
+      startPresentThread();
     }
+
+    PRINTI("VKDirectDisplay: {} frames in flight, {} swapchain images\n", getFramesInFlight(), getSwapchainImageCount());
+    return true;
+  }
+  catch(std::exception const& e)
+  {
+    PRINTE("VKDirectDisplay::setFrameCounts() failed: {}\n", e.what());
+    return false;
   }
+}
 
-  if(!foundPlane)
+bool VKDirectDisplay::setPresentPolicy(PresentPolicy policy, vk::PresentModeKHR mode)
+{
+  if(m_beamRacing.slices)
   {
-    throw std::exception("Could not find a compatible display plane!");
+    PRINTW("VKDirectDisplay: beam racing needs immediate present mode, keeping it\n");
+    return false;
   }
 
-  // find alpha mode bit
-  auto planeCapabilities = m_gpu.getDisplayPlaneCapabilitiesKHR(m_display.modeProperties.displayMode, planeIndex);
-  vk::DisplayPlaneAlphaFlagBitsKHR alphaMode     = vk::DisplayPlaneAlphaFlagBitsKHR::eOpaque;
-  vk::DisplayPlaneAlphaFlagBitsKHR alphaModes[4] = {vk::DisplayPlaneAlphaFlagBitsKHR::eOpaque,
+  m_presentPolicy        = policy;
+  m_requestedPresentMode = mode;
+  m_config.presentPolicy = policy;
+  m_config.presentMode   = mode;
+  if(choosePresentMode(m_supportedPresentModes) == m_presentMode)
+  {
+    return true;
+  }
+
+  try
+  {
+    bool const presentThread = m_presentThread.joinable();
+    stopPresentThread();
+
+    recreateSwapchain();
+
+    if(presentThread)
+    {
+      startPresentThread();
+    }
+
+    PRINTI("VKDirectDisplay: present mode {}\n", vk::to_string(m_presentMode));
+    return true;
+  }
+  catch(std::exception const& e)
+  {
+    PRINTE("VKDirectDisplay::setPresentPolicy() failed: {}\n", e.what());
+    return false;
+  }
+}
+
+std::vector<VKDirectDisplay::PresentModeStats> VKDirectDisplay::getPresentModeStats()
+{
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+
+  std::vector<PresentModeStats> result;
+  for(const auto& [mode, stats] : m_presentModeStats)
+  {
+    double seconds = stats.seconds;
+    if(mode == m_presentMode)
+    {
+      seconds += toMs(std::chrono::steady_clock::now() - m_presentModeStart) * 1.0e-3;
+    }
+    result.push_back({mode, stats.frames, seconds, seconds > 0.0 ? stats.frames / seconds : 0.0,
+                      stats.frames ? double(stats.queueDepthSum) / stats.frames : 0.0});
+  }
+  return result;
+}
+
+uint32_t VKDirectDisplay::getQueueDepth()
+{
+  // frames handed to VK whose blit hasn't finished yet
+  if(!usesFences())
+  {
+    return uint32_t(m_timeline.m_value - m_device->getSemaphoreCounterValueKHR(m_timeline.m_vkDone.get()));
+  }
+
+  uint32_t depth = 0;
+  for(const auto& f : m_fences)
+  {
+    depth += m_device->getFenceStatus(f.get()) == vk::Result::eNotReady ? 1 : 0;
+  }
+  return depth;
+}
+
+void VKDirectDisplay::updatePresentStats()
+{
+  uint32_t const depth = getQueueDepth();
+
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  auto& stats = m_presentModeStats[m_presentMode];
+  stats.frames++;
+  stats.queueDepthSum += depth;
+}
+
+VKDirectDisplay::StallStats VKDirectDisplay::getStallStats()
+{
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  return m_stallStats;
+}
+
+const char* VKDirectDisplay::getStallStageName(StallStage stage)
+{
+  switch(stage)
+  {
+    case StallStage::eGLFinish:
+      return "GL finish";
+    case StallStage::eAcquire:
+      return "acquire";
+    case StallStage::eBlit:
+      return "blit";
+    case StallStage::ePresent:
+      return "present";
+    default:
+      return "unknown";
+  }
+}
+
+uint64_t VKDirectDisplay::getBudgetNs(StallStage stage) const
+{
+  return uint64_t(double(m_stallBudgetMs[uint32_t(stage)]) * 1.0e6);
+}
+
+void VKDirectDisplay::recordStall(StallStage stage, double ms, bool timeout)
+{
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  uint64_t const count = ++m_stallStats.stalls[uint32_t(stage)];
+  m_stallStats.timeouts += timeout ? 1 : 0;
+  m_stallStats.lastStage = stage;
+  m_stallStats.lastMs    = ms;
+
+  // don't flood the log if the display keeps stalling
+  if(count <= 8)
+  {
+    PRINTW("VKDirectDisplay: {} stall, {:.2f} ms (budget {:.2f} ms)\n", getStallStageName(stage), ms,
+           m_stallBudgetMs[uint32_t(stage)]);
+  }
+}
+
+void VKDirectDisplay::recordStageTime(StallStage stage, double ms)
+{
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  m_stallStats.totalMs[uint32_t(stage)] += ms;
+  m_stallStats.samples[uint32_t(stage)]++;
+}
+
+void VKDirectDisplay::countResult(vk::Result result)
+{
+  if(result == vk::Result::eSuboptimalKHR || result == vk::Result::eErrorOutOfDateKHR)
+  {
+    requestRecreate(eRecreateSwapchain);
+  }
+  else if(result == vk::Result::eErrorSurfaceLostKHR)
+  {
+    requestRecreate(eRecreateSurface);
+  }
+
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  m_stallStats.suboptimal += result == vk::Result::eSuboptimalKHR ? 1 : 0;
+  m_stallStats.outOfDate += result == vk::Result::eErrorOutOfDateKHR ? 1 : 0;
+  m_stallStats.surfaceLost += result == vk::Result::eErrorSurfaceLostKHR ? 1 : 0;
+}
+
+GLuint VKDirectDisplay::getTexture()
+{
+  // rebuild what acquire / present reported as broken, before any interop texture is handed out
+  recover();
+
+  // present thread: take the next interop texture it handed back
+  if(m_presentThread.joinable())
+  {
+    while(!m_freeQueue.waitPop(m_frameIndex, m_presentThreadStop) && !m_presentThreadFailed)
+    {
+    }
+    if(m_presentThreadFailed)
+    {
+      // it handed back what it held and stopped, the textures are free once VK is done with them
+      // m_frameIndex is stale if the wait was cancelled, take a slot that was actually handed back
+      stopPresentThread();
+      uint32_t frameIndex = 0;
+      while(m_freeQueue.pop(frameIndex))
+      {
+        m_frameIndex = frameIndex;
+      }
+      PRINTE("VKDirectDisplay: the present thread failed, presenting on the GL thread from now on\n");
+    }
+  }
+
+  auto& s = m_syncData[m_frameIndex];
+
+  // GL: wait for VK image available
+  if(m_syncMode == SyncMode::eTimeline)
+  {
+    // Config::crossDeviceTransfer: the texture is free once the render GPU copied it out
+    GLuint const vkDone = m_transfer.isActive() ? m_transfer.getCopyDoneSemaphore() : m_timeline.m_vkDoneGL;
+    glSemaphoreParameterui64vEXT(vkDone, GL_TIMELINE_SEMAPHORE_VALUE_NV, &s.m_releaseValue);
+    glWaitSemaphoreEXT(vkDone, 0, nullptr, 0, nullptr, nullptr);
+  }
+  else
+  {
+    glWaitSemaphoreEXT(s.m_availableGL, 0, nullptr, 0, nullptr, nullptr);
+  }
+
+  // GL render time: results of the last frame that used this texture, then start a new measurement
+  readRenderTimestamps(m_frameIndex);
+  glQueryCounter(s.m_timerQueries[0], GL_TIMESTAMP);
+
+  // Config::dynamicResolution: the extent GL renders this frame at, the blit picks it up from the texture
+  updateRenderScale();
+  m_renderExtent   = m_resolution.enabled ? getScaledExtent(m_resolution.scale) : m_interopExtent;
+  s.m_renderExtent = m_renderExtent;
+
+  return s.m_textureGL;
+}
+
+bool VKDirectDisplay::isFrameRateGoverned() const
+{
+  // FIFO blocks in acquire once the swapchain is full, beam racing times its slices against the scanout
+  bool const blocking = m_presentMode == vk::PresentModeKHR::eFifo || m_presentMode == vk::PresentModeKHR::eFifoRelaxed;
+  return m_governor.divisor && !blocking && !m_pacing.enabled && !m_beamRacing.slices && m_pacing.periodMs > 0.0;
+}
+
+void VKDirectDisplay::governFrameRate()
+{
+  // don't render frames the displays never show
+  if(!isFrameRateGoverned())
+  {
+    return;
+  }
+
+  using Clock         = Governor::Clock;
+  auto const interval = fromMs(m_pacing.periodMs * m_governor.divisor);
+  measureVblank(interval);
+
+  auto const now  = Clock::now();
+  auto       next = now;
+  if(m_pacing.lastVblank != Clock::time_point() && !m_governor.variableRefresh)
+  {
+    // every divisor-th vblank from the last measured one, the first slot after the last governed frame
+    auto const slots = std::max<Clock::rep>(1, (now - m_pacing.lastVblank + interval - Clock::duration(1)) / interval);
+    next             = m_pacing.lastVblank + interval * slots;
+    while(next <= m_governor.last)
+    {
+      next += interval;
+    }
+  }
+  else if(m_governor.last != Clock::time_point())
+  {
+    if(m_governor.variableRefresh)
+    {
+      // any frame time above the minimum is shown as it comes
+      next = std::max(m_governor.last + interval, now);
+    }
+    else
+    {
+      // stay on the grid of every divisor-th vblank, a late frame waits for the next slot
+      auto const slots = std::max<Clock::rep>(1, (now - m_governor.last + interval - Clock::duration(1)) / interval);
+      next             = m_governor.last + interval * slots;
+    }
+  }
+  sleepUntil(next);
+  m_governor.last = next;
+}
+
+void VKDirectDisplay::measureVblank(Governor::Clock::duration interval)
+{
+  // VK_KHR_present_wait
+  // in mailbox mode a frame is shown at a vblank: if waiting for the last present blocks, it returns on the grid
+  // a present that completed earlier says nothing about when, the grid keeps its phase then
+  if(!m_pacing.presentWait || m_presentMode != vk::PresentModeKHR::eMailbox || m_pacing.presentId <= m_pacing.waitedId
+     || !m_outputs[0].swapchain)
+  {
+    return;
+  }
+
+  // never longer than the governor would sleep anyway
+  using Clock       = Governor::Clock;
+  uint64_t const id = m_pacing.presentId;
+  auto const now    = Clock::now();
+  auto const wait   = m_governor.last != Clock::time_point() ? std::max(m_governor.last + interval - now, Clock::duration(0)) : interval;
+  try
+  {
+    auto const result = m_device->waitForPresentKHR(m_outputs[0].swapchain.get(), id,
+                                                    uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count()));
+    if(result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR)
+    {
+      auto const done = Clock::now();
+      if(done - now > std::chrono::microseconds(100))
+      {
+        m_pacing.lastVblank = done;
+      }
+      m_pacing.waitedId = id;
+    }
+  }
+  catch(vk::SystemError const& e)
+  {
+    PRINTW("VKDirectDisplay::measureVblank(): {}\n", e.what());
+    m_pacing.waitedId = id;
+  }
+}
+
+void VKDirectDisplay::waitForRenderStart()
+{
+  if(!m_pacing.enabled || !m_outputs[0].swapchain)
+  {
+    governFrameRate();
+    return;
+  }
+
+  // VK_KHR_present_wait
+  // the last present tells us where the vblank grid is
+  if(m_pacing.presentId > m_pacing.waitedId)
+  {
+    uint64_t const id = m_pacing.presentId;
+    try
+    {
+      auto const result = m_device->waitForPresentKHR(m_outputs[0].swapchain.get(), id, uint64_t(m_pacing.periodMs * 4.0e6));
+      if(result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR)
+      {
+        m_pacing.lastVblank      = Pacing::Clock::now();
+        m_pacing.waitedId        = id;
+        m_pacing.lastActualMs    = toMs(m_pacing.lastVblank - m_pacing.epoch);
+        m_pacing.lastPredictedMs = m_pacing.predictedMs[id % 16];
+      }
+    }
+    catch(vk::SystemError const& e)
+    {
+      PRINTW("VKDirectDisplay::waitForRenderStart(): {}\n", e.what());
+    }
+  }
+
+  if(m_pacing.waitedId == 0)
+  {
+    // nothing presented yet
+    return;
+  }
+
+  // the next vblank that leaves enough time to render and blit
+  auto const   now      = Pacing::Clock::now();
+  double const budgetMs = m_pacing.renderMs + m_pacing.blitMs + m_pacing.marginMs;
+  double const sinceMs  = toMs(now - m_pacing.lastVblank);
+  double const periods  = std::max(1.0, std::ceil((sinceMs + budgetMs) / m_pacing.periodMs));
+  double const vblankMs = periods * m_pacing.periodMs;
+
+  m_pacing.nextPredictedMs = toMs(m_pacing.lastVblank - m_pacing.epoch) + vblankMs;
+
+  auto const start = m_pacing.lastVblank
+                     + std::chrono::duration_cast<Pacing::Clock::duration>(std::chrono::duration<double, std::milli>(vblankMs - budgetMs));
+  sleepUntil(start);
+}
+
+vk::Extent2D VKDirectDisplay::getScaledExtent(float scale) const
+{
+  // multiples of 8 pixels, small changes of the scale don't re-record the blits every frame
+  auto scaled = [&](uint32_t size) {
+    return std::clamp(uint32_t(float(size) * scale / 8.0f + 0.5f) * 8, std::min(8u, size), size);
+  };
+  return { scaled(m_interopExtent.width), scaled(m_interopExtent.height) };
+}
+
+void VKDirectDisplay::setRenderScale(float scale)
+{
+  m_resolution.scale = std::clamp(scale, m_resolution.minScale, 1.0f);
+}
+
+void VKDirectDisplay::updateRenderScale()
+{
+  // proportional controller on the render area, GL render time grows about linearly with the pixel count
+  // the target leaves room for the blit within the budgeted part of the refresh period
+  if(!m_resolution.enabled || !m_resolution.automatic || m_pacing.renderMs <= 0.0)
+  {
+    return;
+  }
+
+  double const targetMs = std::max(m_pacing.periodMs * m_resolution.budget - m_pacing.blitMs, 0.1);
+  double const desired  = m_resolution.scale * std::sqrt(targetMs / m_pacing.renderMs);
+
+  // the render time is a moving average over frames at older scales, move slowly to not oscillate
+  double const scale = m_resolution.scale + 0.1 * (desired - m_resolution.scale);
+  m_resolution.scale = float(std::clamp(scale, double(m_resolution.minScale), 1.0));
+}
+
+VKDirectDisplay::PacingStats VKDirectDisplay::getPacingStats() const
+{
+  return {m_pacing.renderMs, m_pacing.blitMs, m_pacing.periodMs, m_pacing.lastPredictedMs, m_pacing.lastActualMs};
+}
+
+void VKDirectDisplay::readRenderTimestamps(uint32_t frameIndex)
+{
+  auto& s = m_syncData[frameIndex];
+  if(!s.m_timerPending)
+  {
+    return;
+  }
+
+  GLint available = 0;
+  glGetQueryObjectiv(s.m_timerQueries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if(available)
+  {
+    GLuint64 begin = 0;
+    GLuint64 end   = 0;
+    glGetQueryObjectui64v(s.m_timerQueries[0], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(s.m_timerQueries[1], GL_QUERY_RESULT, &end);
+    m_pacing.renderMs = 0.9 * m_pacing.renderMs + 0.1 * double(end - begin) * 1.0e-6;
+  }
+  s.m_timerPending = false;
+}
+
+void VKDirectDisplay::recordSliceCommandBuffer(vk::CommandBuffer buf, const Output& o, vk::Image syncImg, vk::Image swapImg, uint32_t top, uint32_t bottom)
+{
+  vk::CommandBufferBeginInfo commandBufferBeginInfo {};
+  buf.begin(commandBufferBeginInfo);
+
+  // the rest of the image is still scanned out if the next slice is late, keep it
+  // there's no ownership transfer with beam racing, see createSyncObjects()
+  transitionImage(buf, swapImg, vk::AccessFlagBits::eMemoryRead, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::ePresentSrcKHR,
+                  vk::ImageLayout::eTransferDstOptimal, m_blitStage, vk::PipelineStageFlagBits::eTransfer);
+  transitionImage(buf, syncImg, m_interopAccess, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eColorAttachmentOptimal,
+                  vk::ImageLayout::eTransferSrcOptimal, m_blitStage, vk::PipelineStageFlagBits::eTransfer);
+
+  // outputs are top aligned, the lower ones may not reach the slice
+  int32_t const              y0 = int32_t(std::min(top, o.extent.height));
+  int32_t const              y1 = int32_t(std::min(bottom, o.extent.height));
+  int32_t const              x0 = o.offset.x;
+  int32_t const              x1 = o.offset.x + int32_t(o.extent.width);
+  vk::ImageSubresourceLayers layers{ vk::ImageAspectFlags{ vk::ImageAspectFlagBits::eColor }, 0, 0, 1 };
+  if(y0 < y1 && m_copyFastPath && m_interopFormat == o.format)
+  {
+    vk::ImageCopy region{ layers, vk::Offset3D{ x0, y0, 0 }, layers, vk::Offset3D{ 0, y0, 0 }, vk::Extent3D{ o.extent.width, uint32_t(y1 - y0), 1 } };
+    buf.copyImage(syncImg, vk::ImageLayout::eTransferSrcOptimal, swapImg, vk::ImageLayout::eTransferDstOptimal, region);
+  }
+  else if(y0 < y1)
+  {
+    // GL rendered upside down with the copy fast path, flip otherwise
+    int32_t const               height = int32_t(m_interopExtent.height);
+    std::array<vk::Offset3D, 2> srcoffsets{ vk::Offset3D{ x0, y0, 0 }, vk::Offset3D{ x1, y1, 1 } };
+    std::array<vk::Offset3D, 2> dstoffsets{ vk::Offset3D{ 0, y0, 0 }, vk::Offset3D{ int32_t(o.extent.width), y1, 1 } };
+    if(!m_copyFastPath)
+    {
+      srcoffsets = { vk::Offset3D{ x0, height - y1, 0 }, vk::Offset3D{ x1, height - y0, 1 } };
+      dstoffsets = { vk::Offset3D{ 0, y1, 0 }, vk::Offset3D{ int32_t(o.extent.width), y0, 1 } };
+    }
+    vk::ImageBlit region{ layers, srcoffsets, layers, dstoffsets };
+    buf.blitImage(syncImg, vk::ImageLayout::eTransferSrcOptimal, swapImg, vk::ImageLayout::eTransferDstOptimal, region, vk::Filter::eNearest);
+  }
+
+  transitionImage(buf, swapImg, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eNone, vk::ImageLayout::eTransferDstOptimal,
+                  vk::ImageLayout::ePresentSrcKHR, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe);
+  transitionImage(buf, syncImg, vk::AccessFlagBits::eTransferRead, m_interopAccess, vk::ImageLayout::eTransferSrcOptimal,
+                  vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eTransfer, m_blitStage);
+
+  buf.end();
+}
+
+void VKDirectDisplay::readBlitTimestamps(uint32_t frameIndex)
+{
+  // call this once the last blit of the texture is known to be complete
+  auto& s = m_syncData[frameIndex];
+  if(!m_timestampPool || s.m_lastBlit < 0)
+  {
+    return;
+  }
+
+  std::array<uint64_t, 2> timestamps{};
+  auto const result = m_device->getQueryPoolResults(m_timestampPool.get(), uint32_t(s.m_lastBlit) * 2, 2,
+                                                    sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                                                    vk::QueryResultFlagBits::e64);
+  if(result == vk::Result::eSuccess)
+  {
+    double const ms = double(timestamps[1] - timestamps[0]) * m_timestampPeriod * 1.0e-6;
+    m_pacing.blitMs = 0.9 * m_pacing.blitMs + 0.1 * ms;
+    recordStageTime(StallStage::eBlit, ms);
+    if(ms > m_stallBudgetMs[uint32_t(StallStage::eBlit)])
+    {
+      recordStall(StallStage::eBlit, ms, false);
+    }
+  }
+  s.m_lastBlit = -1;
+}
+
+void VKDirectDisplay::queuePresent(const std::vector<Acquired>& acquired, const std::vector<vk::Rect2D>& damage)
+{
+  // wait for VK blit finished
+  // present all outputs in one call, so they flip in the same batch
+  std::vector<vk::Semaphore>      waitSemaphores;
+  std::vector<vk::SwapchainKHR>   swapchains;
+  std::vector<uint32_t>           imageIndices;
+  std::vector<vk::Result>         results(acquired.size(), vk::Result::eSuccess);
+  for(const auto& a : acquired)
+  {
+    auto& o = m_outputs[a.output];
+    waitSemaphores.push_back(needsOwnershipTransfer() ? o.ownedSemaphores[a.image].get() : o.blitFinishedSemaphores[a.image].get());
+    swapchains.push_back(o.swapchain.get());
+    imageIndices.push_back(a.image);
+  }
+  vk::PresentInfoKHR presentInfo{ waitSemaphores, swapchains, imageIndices, results };
+
+  // VK_KHR_incremental_present
+  // the damage clipped to each output's region, in swapchain image coordinates
+  // acquireImages() skipped the outputs it doesn't touch, a region without rects means the whole image changed,
+  // so does an output that missed the last frame
+  vk::PresentRegionsKHR                      presentRegions;
+  std::vector<vk::PresentRegionKHR>          regions;
+  std::vector<std::vector<vk::RectLayerKHR>> rects(acquired.size());
+  if(m_incrementalPresent && !damage.empty())
+  {
+    for(size_t i = 0; i < acquired.size(); ++i)
+    {
+      auto const& o = m_outputs[acquired[i].output];
+      if(!o.stale)
+      {
+        rects[i] = clipDamage(o, damage);
+      }
+      regions.push_back(vk::PresentRegionKHR(rects[i]));
+    }
+    presentRegions.setRegions(regions);
+    presentInfo.setPNext(&presentRegions);
+  }
+
+  // VK_KHR_present_id
+  // tag the present so waitForRenderStart() or measureVblank() can wait for it, same id on all swapchains
+  vk::PresentIdKHR      presentId;
+  std::vector<uint64_t> ids;
+  if(m_pacing.presentWait)
+  {
+    uint64_t const id = ++m_pacing.presentId;
+    m_pacing.predictedMs[id % 16] = m_pacing.nextPredictedMs;
+    ids.assign(acquired.size(), id);
+    presentId.setPresentIds(ids);
+    presentId.setPNext(presentInfo.pNext);
+    presentInfo.setPNext(&presentId);
+  }
+
+  // VK_KHR_display
+  // present on Direct Display outputs
+  auto const start   = std::chrono::steady_clock::now();
+  vk::Result overall = vk::Result::eSuccess;
+  try
+  {
+    overall = m_presentQueue.presentKHR(presentInfo);
+  }
+  catch(vk::OutOfDateKHRError const&)
+  {
+    // the wait on the blit semaphores still happens
+    overall = vk::Result::eErrorOutOfDateKHR;
+  }
+  catch(vk::SurfaceLostKHRError const&)
+  {
+    overall = vk::Result::eErrorSurfaceLostKHR;
+  }
+
+  double const ms = toMs(std::chrono::steady_clock::now() - start);
+  recordStageTime(StallStage::ePresent, ms);
+  if(ms > m_stallBudgetMs[uint32_t(StallStage::ePresent)])
+  {
+    recordStall(StallStage::ePresent, ms, false);
+  }
+
+  // per swapchain results, fall back to the overall one if the driver didn't report them
+  bool reported = false;
+  for(auto r : results)
+  {
+    countResult(r);
+    reported = reported || r != vk::Result::eSuccess;
+  }
+  if(!reported && overall != vk::Result::eSuccess)
+  {
+    countResult(overall);
+  }
+  auto const shown = [](vk::Result r) { return r == vk::Result::eSuccess || r == vk::Result::eSuboptimalKHR; };
+  for(size_t i = 0; i < acquired.size(); ++i)
+  {
+    m_outputs[acquired[i].output].stale = !shown(overall) || !shown(results[i]);
+  }
+  // Sample::think() skips frames once this is false, every display has to show the latest frame by then
+  m_frameRequired = std::any_of(m_outputs.begin(), m_outputs.end(), [](const Output& o) { return o.stale; });
+}
+
+bool VKDirectDisplay::needsPresent(const Output& o, const std::vector<vk::Rect2D>& damage) const
+{
+  return o.stale || damage.empty() || !clipDamage(o, damage).empty();
+}
+
+std::vector<vk::RectLayerKHR> VKDirectDisplay::clipDamage(const Output& o, const std::vector<vk::Rect2D>& damage) const
+{
+  std::vector<vk::RectLayerKHR> rects;
+  for(const auto& d : damage)
+  {
+    int32_t const x0 = std::max(d.offset.x, o.offset.x);
+    int32_t const y0 = std::max(d.offset.y, o.offset.y);
+    int32_t const x1 = std::min(d.offset.x + int32_t(d.extent.width), o.offset.x + int32_t(o.extent.width));
+    int32_t const y1 = std::min(d.offset.y + int32_t(d.extent.height), o.offset.y + int32_t(o.extent.height));
+    if(x0 < x1 && y0 < y1)
+    {
+      rects.push_back({ { x0 - o.offset.x, y0 - o.offset.y }, { uint32_t(x1 - x0), uint32_t(y1 - y0) }, 0 });
+    }
+  }
+  return rects;
+}
+
+bool VKDirectDisplay::waitReleased(uint32_t frameIndex)
+{
+  // limit frames in flight: wait for the blit that last used this interop texture,
+  // which itself waited for GL to finish rendering into it
+  // native renderer: wait for the frame that last used this slot
+  // false if it's still in use after maxStallTimeouts budgets, the swapchain is rebuilt then
+  if(!usesFences() && !m_syncData[frameIndex].m_releaseValue)
+  {
+    return true;
+  }
+
+  auto wait = [&](uint64_t timeout) {
+    if(!usesFences())
+    {
+      vk::SemaphoreWaitInfo waitInfo{ {}, m_timeline.m_vkDone.get(), m_syncData[frameIndex].m_releaseValue };
+      return m_device->waitSemaphoresKHR(waitInfo, timeout);
+    }
+    return m_device->waitForFences(m_fences[frameIndex].get(), VK_TRUE, timeout);
+  };
+
+  // the texture and the semaphores of this slot are still in use, there's no way around waiting,
+  // but only in budget sized steps
+  auto const start    = std::chrono::steady_clock::now();
+  uint32_t   timeouts = 0;
+  while(wait(getBudgetNs(StallStage::eGLFinish)) == vk::Result::eTimeout && ++timeouts < maxStallTimeouts)
+  {
+  }
+  double const ms = toMs(std::chrono::steady_clock::now() - start);
+  if(timeouts)
+  {
+    recordStall(StallStage::eGLFinish, ms, true);
+  }
+  recordStageTime(StallStage::eGLFinish, ms);
+  if(timeouts == maxStallTimeouts)
+  {
+    PRINTW("VKDirectDisplay: interop frame {} still in use after {:.0f} ms, rebuilding the swapchain\n", frameIndex, ms);
+    requestRecreate(eRecreateSwapchain);
+    return false;
+  }
+  return true;
+}
+
+bool VKDirectDisplay::acquireImage(uint32_t output, vk::Semaphore semaphore, uint32_t& imageIndex)
+{
+  // false if there's no image to blit into, the output is skipped this frame and misses it
+  // otherwise it stays stale until queuePresent() showed the frame
+  auto&      o     = m_outputs[output];
+  bool const stale = o.stale;
+  o.stale          = true;
+  if(!o.swapchain)
+  {
+    return false;
+  }
+
+  // acquired in budget sized steps, a swapchain that times out maxStallTimeouts times in a row is rebuilt,
+  // Config::dropFramesOnStall gives up after the first step
+  auto const start = std::chrono::steady_clock::now();
+  try
+  {
+    auto r = m_device->acquireNextImageKHR(o.swapchain.get(), getBudgetNs(StallStage::eAcquire), semaphore);
+    bool const stalled = r.result == vk::Result::eTimeout || r.result == vk::Result::eNotReady;
+    while(r.result == vk::Result::eTimeout || r.result == vk::Result::eNotReady)
+    {
+      if(++o.acquireTimeouts >= maxStallTimeouts)
+      {
+        PRINTW("VKDirectDisplay: no swapchain image on display {} after {} timeouts, rebuilding the swapchain\n", output, o.acquireTimeouts);
+        o.acquireTimeouts = 0;
+        requestRecreate(eRecreateSwapchain);
+      }
+      if(m_dropFramesOnStall || !o.acquireTimeouts)
+      {
+        recordStall(StallStage::eAcquire, toMs(std::chrono::steady_clock::now() - start), true);
+        return false;
+      }
+      r = m_device->acquireNextImageKHR(o.swapchain.get(), getBudgetNs(StallStage::eAcquire), semaphore);
+    }
+    if(stalled)
+    {
+      recordStall(StallStage::eAcquire, toMs(std::chrono::steady_clock::now() - start), true);
+    }
+    o.acquireTimeouts = 0;
+    o.stale           = stale;
+    recordStageTime(StallStage::eAcquire, toMs(std::chrono::steady_clock::now() - start));
+    countResult(r.result);
+    imageIndex = r.value;
+    return true;
+  }
+  catch(vk::OutOfDateKHRError const&)
+  {
+    // rebuilt by the next getTexture()
+    countResult(vk::Result::eErrorOutOfDateKHR);
+    return false;
+  }
+  catch(vk::SurfaceLostKHRError const&)
+  {
+    countResult(vk::Result::eErrorSurfaceLostKHR);
+    return false;
+  }
+}
+
+std::vector<VKDirectDisplay::Acquired> VKDirectDisplay::acquireImages(const std::vector<vk::Rect2D>& damage)
+{
+  // the frame is dropped if no output has an image
+  // acquiring an image again means its last present, and so the blit that waited for its last acquire semaphore, is done,
+  // that semaphore is free again without waiting for the interop texture's frame on the host
+  std::vector<Acquired> acquired;
+  for(uint32_t i = 0; i < m_outputs.size(); ++i)
+  {
+    // Config::skipUnchanged: an output that shows the last frame and isn't touched by the damage keeps its image,
+    // it's neither blitted nor presented
+    auto& o = m_outputs[i];
+    if(!needsPresent(o, damage))
+    {
+      continue;
+    }
+
+    vk::Semaphore const semaphore  = o.freeAcquireSemaphores.back();
+    uint32_t            imageIndex = 0;
+    if(acquireImage(i, semaphore, imageIndex))
+    {
+      o.freeAcquireSemaphores.pop_back();
+      if(o.imageAcquireSemaphores[imageIndex])
+      {
+        o.freeAcquireSemaphores.push_back(o.imageAcquireSemaphores[imageIndex]);
+      }
+      o.imageAcquireSemaphores[imageIndex] = semaphore;
+      acquired.push_back({ i, imageIndex, semaphore });
+    }
+  }
+  return acquired;
+}
+
+void VKDirectDisplay::dropFrame(uint32_t frameIndex, uint64_t value)
+{
+  // nothing gets presented, but the GL signal still has to be consumed
+  // and the texture handed back to GL as if it had been blitted
+  auto& s = m_syncData[frameIndex];
+  if(m_syncMode == SyncMode::eTimeline)
+  {
+    vk::SemaphoreSubmitInfoKHR waitInfo{ m_timeline.m_glDone.get(), value, vk::PipelineStageFlagBits2KHR::eAllCommands };
+    vk::SemaphoreSubmitInfoKHR signalInfo{ m_timeline.m_vkDone.get(), value, vk::PipelineStageFlagBits2KHR::eAllCommands };
+    vk::SubmitInfo2KHR         submitInfo{ {}, waitInfo, {}, signalInfo };
+    m_blitQueue.submit2KHR(submitInfo);
+    s.m_releaseValue = value;
+  }
+  else
+  {
+    // the fence was reset for the blit, signal it again
+    vk::Semaphore          waitSemaphore   = s.m_finished.get();
+    vk::Semaphore          signalSemaphore = s.m_available.get();
+    vk::PipelineStageFlags waitStage       = vk::PipelineStageFlagBits::eAllCommands;
+    vk::SubmitInfo         submitInfo{ waitSemaphore, waitStage, {}, signalSemaphore };
+    m_blitQueue.submit(submitInfo, m_fences[frameIndex].get());
+  }
+
+  // Config::skipUnchanged: nothing is missed if the damage didn't touch any display
+  if(std::none_of(m_outputs.begin(), m_outputs.end(), [&](const Output& o) { return needsPresent(o, s.m_damage); }))
+  {
+    return;
+  }
+
+  // the displays still show an older frame, the next one can't be skipped
+  m_frameRequired = true;
+
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  m_stallStats.droppedFrames++;
+}
+
+void VKDirectDisplay::submitTexture()
+{
+  // GL: signal to VK that rendering is done
+  uint64_t value = 0;
+  glQueryCounter(m_syncData[m_frameIndex].m_timerQueries[1], GL_TIMESTAMP);
+  m_syncData[m_frameIndex].m_timerPending = true;
+
+  if(m_frameSynthesis)
+  {
+    // the view the frame was rendered with, to reproject it if it has to be presented again
+    std::lock_guard<std::mutex> lock(m_viewMutex);
+    m_syncData[m_frameIndex].m_viewProj = m_viewProj;
+  }
+
+  // VK_KHR_incremental_present
+  // read when presenting this texture, the queue push orders it for the present thread
+  m_syncData[m_frameIndex].m_damage.swap(m_damage);
+  m_damage.clear();
+  m_idle = false;
+
+  if(m_syncMode == SyncMode::eTimeline)
+  {
+    value = ++m_timeline.m_value;
+    GLuint const glDone = m_transfer.isActive() ? m_transfer.getGLDoneSemaphore() : m_timeline.m_glDoneGL;
+    glSemaphoreParameterui64vEXT(glDone, GL_TIMELINE_SEMAPHORE_VALUE_NV, &value);
+    glSignalSemaphoreEXT(glDone, 0, nullptr, 0, nullptr, nullptr);
+  }
+  else
+  {
+    glSignalSemaphoreEXT(m_syncData[m_frameIndex].m_finishedGL, 0, nullptr, 0, nullptr, nullptr);
+  }
+
+  if(m_presentThread.joinable() || m_transfer.isActive())
+  {
+    // the present thread or the cross device copy waits for the signal, make sure it reaches the GPU
+    glFlush();
+  }
+
+  if(m_presentThread.joinable())
+  {
+    // never blocks, there can't be more requests than interop textures
+    m_submitQueue.push({m_frameIndex, value});
+    return;
+  }
+
+  presentFrame(m_frameIndex, value);
+  m_frameIndex = (m_frameIndex + 1) % m_syncData.size();
+}
+
+void VKDirectDisplay::presentFrame(uint32_t frameIndex, uint64_t value)
+{
+  if(m_transfer.isActive())
+  {
+    stageFrame(frameIndex, value);
+  }
+  if(m_syncMode == SyncMode::eTimeline)
+  {
+    presentFrameTimeline(frameIndex, value);
+  }
+  else
+  {
+    presentFrameBinary(frameIndex);
+  }
+}
+
+void VKDirectDisplay::stageFrame(uint32_t frameIndex, uint64_t value)
+{
+  // Config::crossDeviceTransfer, SyncMode::eTimeline only
+  // render GPU: wait for GL frame <value>, copy it into the staging slot, hand the texture back to GL
+  // display GPU: upload it into the image the blits read, the upload signals m_glDone in GL's place
+  auto& s = m_syncData[frameIndex];
+
+  // the staging slot is free once the last upload from it is done
+  if(s.m_releaseValue)
+  {
+    vk::SemaphoreWaitInfo waitInfo{ {}, m_timeline.m_glDone.get(), s.m_releaseValue };
+    m_device->waitSemaphoresKHR(waitInfo, UINT64_MAX);
+  }
+  m_transfer.copy(frameIndex, value);
+
+  // the image is free once the last blit from it is done
+  vk::SemaphoreSubmitInfoKHR     waitInfo{ m_timeline.m_vkDone.get(), s.m_releaseValue, toStage2(m_blitStage) };
+  vk::SemaphoreSubmitInfoKHR     signalInfo{ m_timeline.m_glDone.get(), value, vk::PipelineStageFlagBits2KHR::eAllCommands };
+  vk::CommandBufferSubmitInfoKHR cmdInfo{ m_uploadCommandBuffers[frameIndex] };
+  vk::SubmitInfo2KHR             submitInfo{ {}, waitInfo, cmdInfo, signalInfo };
+  m_blitQueue.submit2KHR(submitInfo);
+}
+
+void VKDirectDisplay::presentFrameBinary(uint32_t frameIndex)
+{
+  // GL: signal rendering is done (see submitTexture())
+  // VK: acquire image from each output's swapchain
+  // VK: blit texture to swapchain images (wait for GL finished, VK images acquired. signal VK blits done)
+  // present (wait for VK blits done. signal VK image available)
+
+  // limit frames in flight
+  // GL already signaled the slot's semaphore, neither it nor the fence can be reused while the slot is busy
+  if(!waitReleased(frameIndex))
+  {
+    throw std::runtime_error("interop texture not released by Vulkan");
+  }
+  m_device->resetFences({ m_fences[frameIndex].get() });
+  readBlitTimestamps(frameIndex);
+
+  // the swapchain image index is independent of the interop frame index,
+  // there's a prepared blit command buffer for each combination
+  auto const acquired = acquireImages(m_syncData[frameIndex].m_damage);
+  if(acquired.empty())
+  {
+    dropFrame(frameIndex, 0);
+    return;
+  }
+
+  // wait for GL finished & VK imageAcquired
+  // blit/copy current texture onto current swapchain images, one submission for all outputs
+  // signal VK blit finished
+  std::vector<vk::Semaphore>          blitWaitSemaphores{m_syncData[frameIndex].m_finished.get()};
+  std::vector<vk::PipelineStageFlags> blitWaitStages{m_blitStage};
+  std::vector<vk::CommandBuffer>      blitCommandBuffers;
+  std::vector<vk::Semaphore>          blitSignalSemaphores;
+  for(const auto& a : acquired)
+  {
+    auto& o = m_outputs[a.output];
+    blitWaitSemaphores.push_back(a.semaphore);
+    blitWaitStages.push_back(m_blitStage);
+    blitCommandBuffers.push_back(prepareBlitCommandBuffer(a, frameIndex));
+    blitSignalSemaphores.push_back(o.blitFinishedSemaphores[a.image].get());
+  }
+
+  vk::SubmitInfo submitInfo{blitWaitSemaphores,
+                            blitWaitStages, 
+                            blitCommandBuffers,
+                            blitSignalSemaphores };
+  m_blitQueue.submit(submitInfo, m_fences[frameIndex].get());
+  m_syncData[frameIndex].m_lastBlit = int32_t(getBlitQueryPair(acquired[0], frameIndex));
+
+  if(needsOwnershipTransfer())
+  {
+    submitOwnershipTransfer(acquired);
+  }
+  queuePresent(acquired, m_syncData[frameIndex].m_damage);
+  updatePresentStats();
+
+  // signal to GL that the interop texture is available, after the blit on the same queue
+  vk::SubmitInfo signalInfo{ {},{},{}, m_syncData[frameIndex].m_available.get() };
+  m_blitQueue.submit(signalInfo);
+}
+
+void VKDirectDisplay::presentFrameTimeline(uint32_t frameIndex, uint64_t value)
+{
+  // GL: signal rendering of frame <value> is done (see submitTexture())
+  // VK: acquire image from each output's swapchain
+  // VK: blit texture to swapchain images (wait for GL frame <value>, VK images acquired. signal VK blits done and VK frame <value>)
+  // present (wait for VK blits done)
+  auto& s = m_syncData[frameIndex];
+
+  // no host wait for the slot's last blit: GL waited for it on the GPU before rendering <value> and this blit waits for GL,
+  // the acquire semaphores are recycled per swapchain image and the blit command buffers allow simultaneous use
+  if(m_device->getSemaphoreCounterValueKHR(m_timeline.m_vkDone.get()) >= s.m_releaseValue)
+  {
+    readBlitTimestamps(frameIndex);
+  }
+
+  // the swapchain image index is independent of the interop frame index,
+  // there's a prepared blit command buffer for each combination
+  auto const acquired = acquireImages(s.m_damage);
+  if(acquired.empty())
+  {
+    dropFrame(frameIndex, value);
+    return;
+  }
+
+  // single batch for all outputs: blit and signal texture availability to GL
+  std::vector<vk::SemaphoreSubmitInfoKHR> waitInfos{
+      vk::SemaphoreSubmitInfoKHR{ m_timeline.m_glDone.get(), value, toStage2(m_blitStage) } };
+  std::vector<vk::SemaphoreSubmitInfoKHR> signalInfos{
+      vk::SemaphoreSubmitInfoKHR{ m_timeline.m_vkDone.get(), value, vk::PipelineStageFlagBits2KHR::eAllCommands } };
+  std::vector<vk::CommandBufferSubmitInfoKHR> cmdInfos;
+  for(const auto& a : acquired)
+  {
+    auto& o = m_outputs[a.output];
+    waitInfos.push_back({ a.semaphore, 0, toStage2(m_blitStage) });
+    signalInfos.push_back({ o.blitFinishedSemaphores[a.image].get(), 0, vk::PipelineStageFlagBits2KHR::eAllCommands });
+    cmdInfos.push_back({ prepareBlitCommandBuffer(a, frameIndex) });
+  }
+
+  // Config::exportName: consumers reading the copy of this slot from now on throw their result away
+  // dropped frames aren't copied, and nothing is while no consumer's heartbeat arrives, the slot keeps the older frame
+  bool const exported = !m_exportCommandBuffers.empty() && m_export.hasConsumers();
+  if(exported)
+  {
+    m_export.beginFrame(frameIndex);
+    cmdInfos.push_back({ m_exportCommandBuffers[frameIndex] });
+  }
+
+  vk::SubmitInfo2KHR submitInfo{ {}, waitInfos, cmdInfos, signalInfos };
+  m_blitQueue.submit2KHR(submitInfo);
+  s.m_releaseValue = value;
+  s.m_lastBlit     = int32_t(getBlitQueryPair(acquired[0], frameIndex));
+  if(exported)
+  {
+    m_export.endFrame(frameIndex, value);
+  }
+
+  if(needsOwnershipTransfer())
+  {
+    submitOwnershipTransfer(acquired);
+  }
+  queuePresent(acquired, s.m_damage);
+  updatePresentStats();
+}
+
+void VKDirectDisplay::setViewProjection(const glm::mat4& viewProj)
+{
+  std::lock_guard<std::mutex> lock(m_viewMutex);
+  m_viewProj = viewProj;
+}
+
+void VKDirectDisplay::setDamage(const std::vector<vk::Rect2D>& rects)
+{
+  m_damage = rects;
+}
+
+void VKDirectDisplay::skipFrame()
+{
+  m_idle = true;
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stallStats.skippedFrames++;
+  }
+
+  // Config::framePacing: waitForRenderStart() already waited for the next vblank
+  // Config::refreshDivisor: so did governFrameRate(), for the next slot of the grid
+  if((m_pacing.enabled && m_pacing.waitedId) || isFrameRateGoverned())
+  {
+    return;
+  }
+
+  // no present to block on, don't spin
+  auto const period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(m_pacing.periodMs));
+  m_lastSkip        = std::max(m_lastSkip + period, std::chrono::steady_clock::now());
+  sleepUntil(m_lastSkip);
+}
+
+vk::Offset2D VKDirectDisplay::getReprojectionShift(uint32_t frameIndex)
+{
+  // image space motion of the scene origin between the view the frame was rendered with and the newest one,
+  // a translation only approximation of the view change, good enough to follow camera motion for a frame or two
+  glm::mat4 viewProj;
+  {
+    std::lock_guard<std::mutex> lock(m_viewMutex);
+    viewProj = m_viewProj;
+  }
+  glm::vec4 const rendered = m_syncData[frameIndex].m_viewProj * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  glm::vec4 const current  = viewProj * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  if(rendered.w <= 0.0f || current.w <= 0.0f)
+  {
+    return {};
+  }
+
+  // NDC y points up, the canvas y down
+  glm::vec2 const delta = glm::vec2(current) / current.w - glm::vec2(rendered) / rendered.w;
+  return { int32_t(delta.x * 0.5f * float(m_interopExtent.width)), int32_t(-delta.y * 0.5f * float(m_interopExtent.height)) };
+}
+
+void VKDirectDisplay::waitSynthesized()
+{
+  // the repeated frame's blit reads from the held texture, and its acquire semaphores are reused by the next one
+  if(m_synthPending)
+  {
+    (void)m_device->waitForFences(m_synthFence.get(), VK_TRUE, UINT64_MAX);
+    m_synthPending = false;
+  }
+}
+
+void VKDirectDisplay::synthesizeFrame(uint32_t frameIndex)
+{
+  // present thread: present the held interop texture again, no GL involved
+  // the texture is available to VK, its first blit already waited for GL
+  waitSynthesized();
+
+  std::vector<Acquired> acquired;
+  for(uint32_t i = 0; i < m_outputs.size(); ++i)
+  {
+    uint32_t imageIndex = 0;
+    if(m_outputs[i].synthCommandBuffer && acquireImage(i, m_outputs[i].synthAcquired.get(), imageIndex))
+    {
+      acquired.push_back({ i, imageIndex });
+    }
+  }
+  if(acquired.empty())
+  {
+    return;
+  }
+
+  // reprojection needs a queue that can clear and blit
+  bool const   reproject = m_reprojection && (m_queueFamilies[m_blitFamily].queueFlags & vk::QueueFlagBits::eGraphics);
+  vk::Offset2D const shift = reproject ? getReprojectionShift(frameIndex) : vk::Offset2D();
+
+  std::vector<vk::Semaphore>          waitSemaphores;
+  std::vector<vk::PipelineStageFlags> waitStages;
+  std::vector<vk::CommandBuffer>      commandBuffers;
+  std::vector<vk::Semaphore>          signalSemaphores;
+  for(const auto& a : acquired)
+  {
+    auto& o = m_outputs[a.output];
+    o.synthCommandBuffer.reset();
+    recordBlitCommandBuffer(o.synthCommandBuffer, o, m_syncData[frameIndex].m_image.get(), o.images[a.image], ~0u,
+                            m_syncData[frameIndex].m_renderExtent, shift);
+    waitSemaphores.push_back(o.synthAcquired.get());
+    waitStages.push_back(m_blitStage);
+    commandBuffers.push_back(o.synthCommandBuffer);
+    signalSemaphores.push_back(o.blitFinishedSemaphores[a.image].get());
+  }
+
+  m_device->resetFences(m_synthFence.get());
+  vk::SubmitInfo submitInfo{ waitSemaphores, waitStages, commandBuffers, signalSemaphores };
+  m_blitQueue.submit(submitInfo, m_synthFence.get());
+  m_synthPending = true;
+
+  if(needsOwnershipTransfer())
+  {
+    submitOwnershipTransfer(acquired);
+  }
+  queuePresent(acquired);
+  updatePresentStats();
+
+  std::lock_guard<std::mutex> lock(m_statsMutex);
+  m_stallStats.synthesizedFrames++;
+}
+
+void VKDirectDisplay::submitOwnershipTransfer(const std::vector<Acquired>& acquired)
+{
+  // the present family acquires the swapchain images released at the end of the blits,
+  // present waits for this instead of the blits
+  std::vector<vk::Semaphore>          waitSemaphores;
+  std::vector<vk::PipelineStageFlags> waitStages;
+  std::vector<vk::CommandBuffer>      commandBuffers;
+  std::vector<vk::Semaphore>          signalSemaphores;
+  for(const auto& a : acquired)
+  {
+    auto& o = m_outputs[a.output];
+    waitSemaphores.push_back(o.blitFinishedSemaphores[a.image].get());
+    waitStages.push_back(vk::PipelineStageFlagBits::eAllCommands);
+    commandBuffers.push_back(o.ownershipCommandBuffers[a.image]);
+    signalSemaphores.push_back(o.ownedSemaphores[a.image].get());
+  }
+
+  vk::SubmitInfo submitInfo{ waitSemaphores, waitStages, commandBuffers, signalSemaphores };
+  m_presentQueue.submit(submitInfo);
+}
+
+void VKDirectDisplay::setNativeGeometry(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<uint32_t>& indices)
+{
+  if(m_native && m_device)
+  {
+    m_renderer.setGeometry(positions, normals, indices);
+  }
+}
+
+void VKDirectDisplay::renderNative(const SceneData& scene, const std::vector<VKDRenderer::Draw>& draws)
+{
+  // same flow as presentFrameBinary(), with the blit replaced by rendering the scene
+  recover();
+  uint32_t const frameIndex = m_frameIndex;
+
+  // limit frames in flight, the slot is tried again next frame
+  if(!waitReleased(frameIndex))
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stallStats.droppedFrames++;
+    return;
+  }
+
+  // the fence stays signaled if nothing is submitted
+  auto const acquired = acquireImages();
+  if(acquired.empty())
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stallStats.droppedFrames++;
+    return;
+  }
+  m_device->resetFences({ m_fences[frameIndex].get() });
+
+  std::vector<VKDRenderer::TargetImage> images;
+  std::vector<vk::Semaphore>            waitSemaphores;
+  std::vector<vk::PipelineStageFlags>   waitStages;
+  std::vector<vk::Semaphore>            signalSemaphores;
+  for(const auto& a : acquired)
+  {
+    auto& o = m_outputs[a.output];
+    images.push_back({ a.output, a.image });
+    waitSemaphores.push_back(a.semaphore);
+    waitStages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+    signalSemaphores.push_back(o.blitFinishedSemaphores[a.image].get());
+  }
+
+  // one submit for all outputs, signals the same semaphores the blit would
+  vk::CommandBuffer const buf = m_renderer.record(frameIndex, images, scene, draws);
+  vk::SubmitInfo          submitInfo{ waitSemaphores, waitStages, buf, signalSemaphores };
+  m_graphicsQueue.submit(submitInfo, m_fences[frameIndex].get());
+
+  if(needsOwnershipTransfer())
+  {
+    submitOwnershipTransfer(acquired);
+  }
+  queuePresent(acquired);
+  updatePresentStats();
+
+  m_frameIndex = (m_frameIndex + 1) % m_nativeFrames;
+}
+
+GLuint VKDirectDisplay::getLayerTexture(uint32_t layer)
+{
+  // frame <value> reuses the texture of frame <value - size>, free once the compositor shows a newer one
+  auto&          l     = m_layers[layer];
+  uint64_t const value = l.timeline.m_value + 1;
+  uint32_t const size  = uint32_t(l.frames.size());
+  if(value > size)
+  {
+    uint64_t release = value - size;
+    glSemaphoreParameterui64vEXT(l.timeline.m_vkDoneGL, GL_TIMELINE_SEMAPHORE_VALUE_NV, &release);
+    glWaitSemaphoreEXT(l.timeline.m_vkDoneGL, 0, nullptr, 0, nullptr, nullptr);
+  }
+  return l.frames[(value - 1) % size].m_textureGL;
+}
+
+void VKDirectDisplay::submitLayer(uint32_t layer)
+{
+  auto&    l     = m_layers[layer];
+  uint64_t value = ++l.timeline.m_value;
+  glSemaphoreParameterui64vEXT(l.timeline.m_glDoneGL, GL_TIMELINE_SEMAPHORE_VALUE_NV, &value);
+  glSignalSemaphoreEXT(l.timeline.m_glDoneGL, 0, nullptr, 0, nullptr, nullptr);
+
+  // the compositor polls the semaphore, make sure the signal reaches the GPU
+  glFlush();
+}
+
+void VKDirectDisplay::composeFrame()
+{
+  // same flow as renderNative(), with the blit of the newest finished frame of every layer
+  recover();
+  uint32_t const frameIndex = m_frameIndex;
+
+  // limit frames in flight, the slot is tried again next frame
+  if(!waitReleased(frameIndex))
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stallStats.droppedFrames++;
+    return;
+  }
+
+  // polled before acquiring, so the producers get their textures back even if this composition is dropped
+  std::vector<vk::Semaphore>          waitSemaphores;
+  std::vector<uint64_t>               waitValues;
+  std::vector<vk::PipelineStageFlags> waitStages;
+  std::vector<vk::Semaphore>          signalSemaphores;
+  std::vector<uint64_t>               signalValues;
+  for(auto& l : m_layers)
+  {
+    // polled, a producer that is late keeps its last frame on the display
+    l.shown = std::max(l.shown, m_device->getSemaphoreCounterValueKHR(l.timeline.m_glDone.get()));
+    if(l.shown)
+    {
+      // reached already, the wait only makes GL's rendering visible
+      waitSemaphores.push_back(l.timeline.m_glDone.get());
+      waitValues.push_back(l.shown);
+      waitStages.push_back(m_blitStage);
+    }
+
+    // all frames before the one shown now are free for the producer, the composition starts with a barrier
+    // behind all earlier work on the queue, so the signal also covers the earlier compositions reading them
+    if(l.shown > l.released + 1)
+    {
+      l.released = l.shown - 1;
+      signalSemaphores.push_back(l.timeline.m_vkDone.get());
+      signalValues.push_back(l.released);
+    }
+  }
+
+  // the fence stays signaled if nothing is submitted
+  auto const acquired = acquireImages();
+  if(acquired.empty())
+  {
+    if(!signalSemaphores.empty())
+    {
+      // a signal operation covers all work submitted before it, no commands needed
+      vk::TimelineSemaphoreSubmitInfo timelineInfo{ {}, signalValues };
+      vk::SubmitInfo                  submitInfo{ {}, {}, {}, signalSemaphores };
+      submitInfo.setPNext(&timelineInfo);
+      m_blitQueue.submit(submitInfo);
+    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stallStats.droppedFrames++;
+    return;
+  }
+  m_device->resetFences({ m_fences[frameIndex].get() });
+
+  for(const auto& a : acquired)
+  {
+    auto& o = m_outputs[a.output];
+    waitSemaphores.push_back(a.semaphore);
+    waitValues.push_back(0);
+    waitStages.push_back(m_blitStage);
+    signalSemaphores.push_back(o.blitFinishedSemaphores[a.image].get());
+    signalValues.push_back(0);
+  }
+
+  vk::CommandBuffer const buf = m_composeCommandBuffers[frameIndex];
+  recordComposeCommandBuffer(buf, acquired);
+
+  // binary semaphores ignore their values
+  vk::TimelineSemaphoreSubmitInfo timelineInfo{ waitValues, signalValues };
+  vk::SubmitInfo                  submitInfo{ waitSemaphores, waitStages, buf, signalSemaphores };
+  submitInfo.setPNext(&timelineInfo);
+  m_blitQueue.submit(submitInfo, m_fences[frameIndex].get());
+
+  if(needsOwnershipTransfer())
+  {
+    submitOwnershipTransfer(acquired);
+  }
+  queuePresent(acquired);
+  updatePresentStats();
+
+  m_frameIndex = (m_frameIndex + 1) % m_composeFrames;
+}
+
+void VKDirectDisplay::recordComposeCommandBuffer(vk::CommandBuffer buf, const std::vector<Acquired>& acquired)
+{
+  // its last submit is complete, waitReleased() waited for the fence
+  buf.reset();
+  buf.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+  // orders the earlier compositions, including their layout transitions, before the release signals of this one
+  buf.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, {});
+
+  auto image = [](const Layer& l) { return l.frames[(l.shown - 1) % l.frames.size()].m_image.get(); };
+  for(const auto& l : m_layers)
+  {
+    if(l.shown)
+    {
+      transitionImage(buf, image(l), m_interopAccess, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eColorAttachmentOptimal,
+                      vk::ImageLayout::eTransferSrcOptimal, m_blitStage, vk::PipelineStageFlagBits::eTransfer);
+    }
+  }
+
+  vk::ImageSubresourceLayers layers{ vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+  vk::ImageSubresourceRange  range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+  for(const auto& a : acquired)
+  {
+    auto const& o       = m_outputs[a.output];
+    vk::Image   swapImg = o.images[a.image];
+    transitionImage(buf, swapImg, vk::AccessFlagBits::eMemoryRead, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined,
+                    vk::ImageLayout::eTransferDstOptimal, m_blitStage, vk::PipelineStageFlagBits::eTransfer);
+
+    // black where no layer is, each layer is blitted after the one below
+    buf.clearColorImage(swapImg, vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }), range);
+    for(const auto& l : m_layers)
+    {
+      // GL rendered the layer bottom up
+      std::array<vk::Offset3D, 2> srcoffsets = { vk::Offset3D{ 0, int32_t(l.extent.height), 0 }, vk::Offset3D{ int32_t(l.extent.width), 0, 1 } };
+      std::array<vk::Offset3D, 2> dstoffsets = { vk::Offset3D{ l.rect.offset.x, l.rect.offset.y, 0 },
+                                                 vk::Offset3D{ l.rect.offset.x + int32_t(l.rect.extent.width),
+                                                               l.rect.offset.y + int32_t(l.rect.extent.height), 1 } };
+      if(!l.shown || !clipBlit(srcoffsets, dstoffsets, { -o.offset.x, -o.offset.y }, o.extent))
+      {
+        continue;
+      }
+      transitionImage(buf, swapImg, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eTransferDstOptimal,
+                      vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer);
+      vk::ImageBlit region{ layers, srcoffsets, layers, dstoffsets };
+      buf.blitImage(image(l), vk::ImageLayout::eTransferSrcOptimal, swapImg, vk::ImageLayout::eTransferDstOptimal,
+                    vk::ArrayProxy<const vk::ImageBlit>{ 1, &region }, l.rect.extent == l.extent ? vk::Filter::eNearest : m_scaleFilter);
+    }
+
+    // release to the present family, see submitOwnershipTransfer()
+    transitionImage(buf, swapImg, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eNone, vk::ImageLayout::eTransferDstOptimal,
+                    vk::ImageLayout::ePresentSrcKHR, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+                    needsOwnershipTransfer() ? m_blitFamily : VK_QUEUE_FAMILY_IGNORED,
+                    needsOwnershipTransfer() ? m_presentFamily : VK_QUEUE_FAMILY_IGNORED);
+  }
+
+  for(const auto& l : m_layers)
+  {
+    if(l.shown)
+    {
+      transitionImage(buf, image(l), vk::AccessFlagBits::eTransferRead, m_interopAccess, vk::ImageLayout::eTransferSrcOptimal,
+                      vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eTransfer, m_blitStage);
+    }
+  }
+  buf.end();
+}
+
+void VKDirectDisplay::startPresentThread()
+{
+  // all interop textures are free, the queues can hold all of them
+  m_submitQueue.reset(m_syncData.size());
+  m_freeQueue.reset(m_syncData.size());
+  for(uint32_t i = 0; i < m_syncData.size(); ++i)
+  {
+    m_freeQueue.push(i);
+  }
+  m_heldFrame    = -1;
+  m_synthPending = false;
+  m_lastPresent  = std::chrono::steady_clock::now();
+
+  m_presentThreadStop   = false;
+  m_presentThreadFailed = false;
+  m_presentThread       = std::thread(&VKDirectDisplay::presentThread, this);
+}
+
+void VKDirectDisplay::stopPresentThread()
+{
+  if(!m_presentThread.joinable())
+  {
+    return;
+  }
+
+  // remaining requests are still presented, GL has signaled their semaphores already
+  m_presentThreadStop = true;
+  m_submitQueue.wake();
+  m_presentThread.join();
+}
+
+void VKDirectDisplay::startVblankThread()
+{
+  // without vblank events the phase is unknown, slices are still spread over the refresh period
+  m_beamRacing.lastVblank = BeamRacing::Clock::now().time_since_epoch().count();
+  if(!m_hasDisplayControl)
+  {
+    PRINTW("VK_EXT_display_control not available, beam racing doesn't know the scanout position\n");
+    return;
+  }
+
+  m_beamRacing.vblankThreadStop = false;
+  m_beamRacing.vblankThread     = std::thread(&VKDirectDisplay::vblankThread, this);
+}
+
+void VKDirectDisplay::stopVblankThread()
+{
+  if(!m_beamRacing.vblankThread.joinable())
+  {
+    return;
+  }
+
+  m_beamRacing.vblankThreadStop = true;
+  m_beamRacing.vblankThread.join();
+}
+
+void VKDirectDisplay::vblankThread()
+{
+  // VK_EXT_display_control
+  // one event per vblank of the first display, its fence signals when the first pixel goes out
+  vk::DisplayEventInfoEXT const eventInfo{ vk::DisplayEventTypeEXT::eFirstPixelOut };
+  while(!m_beamRacing.vblankThreadStop)
+  {
+    try
+    {
+      vk::UniqueFence fence = m_device->registerDisplayEventEXTUnique(m_outputs[0].display.displayKHR, eventInfo);
+
+      // short timeouts, the display may be in standby
+      while(!m_beamRacing.vblankThreadStop)
+      {
+        if(m_device->waitForFences(fence.get(), VK_TRUE, 100'000'000) == vk::Result::eSuccess)
+        {
+          m_beamRacing.lastVblank = BeamRacing::Clock::now().time_since_epoch().count();
+          break;
+        }
+      }
+    }
+    catch(vk::SystemError const& e)
+    {
+      // display lost, the last vblank keeps being extrapolated until it's back
+      PRINTW("VKDirectDisplay vblank thread: {}\n", e.what());
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+  }
+}
+
+void VKDirectDisplay::waitForSlice(uint32_t slice)
+{
+  // the scanout reaches the slice at frameVblank + its share of the refresh period, blanking is ignored
+  using Clock = BeamRacing::Clock;
+  auto const period = fromMs(m_pacing.periodMs);
+  auto const lead   = fromMs(m_beamRacing.leadMs);
+  if(slice == 0)
+  {
+    // the next vblank that leaves time to render the first slice
+    Clock::time_point const last   = Clock::time_point(Clock::duration(m_beamRacing.lastVblank.load()));
+    auto const              behind = Clock::now() + lead - last;
+    m_beamRacing.frameVblank       = last + period * std::max<Clock::rep>(1, (behind + period - Clock::duration(1)) / period);
+  }
+
+  auto const scanout = m_beamRacing.frameVblank + fromMs(double(getSliceTop(slice)) / double(m_interopExtent.height) * m_pacing.periodMs);
+  sleepUntil(scanout - lead);
+}
+
+void VKDirectDisplay::submitSlice(uint32_t slice)
+{
+  // GL: signal the slice is done, every slice is a timeline value
+  // VK: acquire an image per output, blit the slice's rows and present right away, it tears in at the raster position
+  auto&      s    = m_syncData[m_frameIndex];
+  bool const last = slice + 1 == m_beamRacing.slices;
+  if(last)
+  {
+    glQueryCounter(s.m_timerQueries[1], GL_TIMESTAMP);
+    s.m_timerPending = true;
+  }
+  uint64_t const value = ++m_timeline.m_value;
+  glSemaphoreParameterui64vEXT(m_timeline.m_glDoneGL, GL_TIMELINE_SEMAPHORE_VALUE_NV, &value);
+  glSignalSemaphoreEXT(m_timeline.m_glDoneGL, 0, nullptr, 0, nullptr, nullptr);
+  // the blit waits for it right away, make sure it reaches the GPU
+  glFlush();
+
+  if(slice == 0)
+  {
+    // limit frames in flight, the slice semaphores of this texture are free afterwards
+    if(!waitReleased(m_frameIndex))
+    {
+      throw std::runtime_error("interop texture not released by Vulkan");
+    }
+    s.m_lastBlit = -1;
+  }
+
+  std::vector<Acquired> acquired;
+  for(uint32_t i = 0; i < m_outputs.size(); ++i)
+  {
+    uint32_t imageIndex = 0;
+    if(acquireImage(i, m_outputs[i].sliceAcquired[m_frameIndex * m_beamRacing.slices + slice].get(), imageIndex))
+    {
+      acquired.push_back({ i, imageIndex });
+    }
+  }
+
+  if(acquired.empty())
+  {
+    dropFrame(m_frameIndex, value);
+  }
+  else
+  {
+    std::vector<vk::SemaphoreSubmitInfoKHR> waitInfos{
+        vk::SemaphoreSubmitInfoKHR{ m_timeline.m_glDone.get(), value, toStage2(m_blitStage) } };
+    std::vector<vk::SemaphoreSubmitInfoKHR> signalInfos{
+        vk::SemaphoreSubmitInfoKHR{ m_timeline.m_vkDone.get(), value, vk::PipelineStageFlagBits2KHR::eAllCommands } };
+    std::vector<vk::CommandBufferSubmitInfoKHR> cmdInfos;
+    for(const auto& a : acquired)
+    {
+      auto& o = m_outputs[a.output];
+      waitInfos.push_back({ o.sliceAcquired[m_frameIndex * m_beamRacing.slices + slice].get(), 0, toStage2(m_blitStage) });
+      signalInfos.push_back({ o.blitFinishedSemaphores[a.image].get(), 0, vk::PipelineStageFlagBits2KHR::eAllCommands });
+      if(!o.sliceInitialized[a.image])
+      {
+        // the slices keep the rest of the image, it has to be in the present layout once
+        cmdInfos.push_back({ o.sliceInitCommandBuffers[a.image] });
+        o.sliceInitialized[a.image] = true;
+      }
+      cmdInfos.push_back({ o.sliceCommandBuffers[(m_frameIndex * o.images.size() + a.image) * m_beamRacing.slices + slice] });
+    }
+
+    vk::SubmitInfo2KHR submitInfo{ {}, waitInfos, cmdInfos, signalInfos };
+    m_blitQueue.submit2KHR(submitInfo);
+    s.m_releaseValue = value;
+
+    // VK_KHR_incremental_present: the rows the slice blitted
+    uint32_t const top    = getSliceTop(slice ? slice - 1 : 0);
+    uint32_t const bottom = getSliceTop(slice + 1);
+    queuePresent(acquired, { vk::Rect2D({ 0, int32_t(top) }, { m_interopExtent.width, bottom - top }) });
+
+    auto const scanout = m_beamRacing.frameVblank + fromMs(double(getSliceTop(slice)) / double(m_interopExtent.height) * m_pacing.periodMs);
+    if(BeamRacing::Clock::now() > scanout)
+    {
+      std::lock_guard<std::mutex> lock(m_statsMutex);
+      m_stallStats.lateSlices++;
+    }
+  }
+
+  if(last)
+  {
+    updatePresentStats();
+    m_frameIndex = (m_frameIndex + 1) % m_syncData.size();
+  }
+}
+
+void VKDirectDisplay::presentThread()
+{
+  // Config::frameSynthesis: GL has to keep one texture to render into while the last frame is held
+  // and a known refresh period to keep
+  bool const synthesis = m_frameSynthesis && m_syncData.size() >= 2 && m_pacing.periodMs > 0.0;
+  auto const period    = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(m_pacing.periodMs));
+
+  PresentRequest request;
+  while(true)
+  {
+    bool popped = false;
+    if(synthesis && m_heldFrame >= 0 && !m_idle)
+    {
+      popped = m_submitQueue.waitPopUntil(request, m_presentThreadStop, m_lastPresent + period);
+      if(!popped && m_idle)
+      {
+        // skipFrame(): the displays keep the last frame on their own
+        continue;
+      }
+      if(!popped && !m_presentThreadStop)
+      {
+        // GL missed the vblank, keep the cadence with the last frame
+        try
+        {
+          synthesizeFrame(uint32_t(m_heldFrame));
+        }
+        catch(std::exception const& e)
+        {
+          PRINTE("VKDirectDisplay present thread: {}\n", e.what());
+          failPresentThread();
+          break;
+        }
+        m_lastPresent = std::chrono::steady_clock::now();
+        continue;
+      }
+    }
+    else
+    {
+      popped = m_submitQueue.waitPop(request, m_presentThreadStop);
+    }
+
+    if(popped)
+    {
+      try
+      {
+        presentFrame(request.frameIndex, request.value);
+      }
+      catch(std::exception const& e)
+      {
+        PRINTE("VKDirectDisplay present thread: {}\n", e.what());
+        m_freeQueue.push(request.frameIndex);
+        failPresentThread();
+        break;
+      }
+      m_lastPresent = std::chrono::steady_clock::now();
+
+      if(synthesis)
+      {
+        // hold the new frame, hand back the previous one once no repeated frame reads from it anymore
+        waitSynthesized();
+        if(m_heldFrame >= 0)
+        {
+          m_freeQueue.push(uint32_t(m_heldFrame));
+        }
+        m_heldFrame = int32_t(request.frameIndex);
+        continue;
+      }
+
+      // GL waits for the texture to be available on the GPU, it can be handed back right away
+      m_freeQueue.push(request.frameIndex);
+    }
+    else if(m_presentThreadStop)
+    {
+      waitSynthesized();
+      break;
+    }
+  }
+}
+
+void VKDirectDisplay::failPresentThread()
+{
+  // hand everything back to GL and wake it up, getTexture() falls back to presenting on the GL thread
+  // requests still queued were signaled by GL but never consumed, drop them like a stalled frame
+  PresentRequest request;
+  while(m_submitQueue.pop(request))
+  {
+    try
+    {
+      dropFrame(request.frameIndex, request.value);
+    }
+    catch(std::exception const& e)
+    {
+      PRINTE("VKDirectDisplay present thread: {}\n", e.what());
+    }
+    m_freeQueue.push(request.frameIndex);
+  }
+  if(m_heldFrame >= 0)
+  {
+    waitSynthesized();
+    m_freeQueue.push(uint32_t(m_heldFrame));
+    m_heldFrame = -1;
+  }
+
+  // the stop flag cancels a waitPop() that started after the wake up
+  m_presentThreadFailed = true;
+  m_presentThreadStop   = true;
+  m_freeQueue.wake();
+}
+
+void VKDirectDisplay::createInstance()
+{
+#if VK_HEADER_VERSION >= 304
+  vk::detail::DynamicLoader dl;
+#else
+  vk::DynamicLoader dl;
+#endif
+  PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr =
+    dl.getProcAddress<PFN_vkGetInstanceProcAddr>("vkGetInstanceProcAddr");
+  VULKAN_HPP_DEFAULT_DISPATCHER.init(vkGetInstanceProcAddr);
+
+  // check for required instance extensions
+  std::vector<vk::ExtensionProperties> availableInstanceExtensions = vk::enumerateInstanceExtensionProperties();
+  {
+    uint32_t major = VK_API_VERSION_MAJOR(VK_HEADER_VERSION_COMPLETE);
+    uint32_t minor = VK_API_VERSION_MINOR(VK_HEADER_VERSION_COMPLETE);
+    uint32_t patch = VK_API_VERSION_PATCH(VK_HEADER_VERSION_COMPLETE);
+    PRINTI("\n\nVK Header version: {}.{}.{}\n", major, minor, patch);
+  }
+
+  std::cout << "\nChecking Instance Extensions\n";
+
+  std::vector<const char*> instanceExtensions = requiredInstanceExtensions;
+  auto const&              surfaceExtensions  = m_headless ? headlessInstanceExtensions : displayInstanceExtensions;
+  instanceExtensions.insert(instanceExtensions.end(), surfaceExtensions.begin(), surfaceExtensions.end());
+  for(const auto& required : instanceExtensions)
+  {
+    bool found = false;
+    for(const auto& available : availableInstanceExtensions)
+    {
+      if(std::string(required) == available.extensionName)
+      {
+        found = true;
+        PRINTOK("OK: {}\n", required);
+        break;
+      }
+    }
+    if(!found)
+    {
+      throw std::runtime_error("Required instance extension not found: " + std::string(required) + "\n");
+    }
+  }
+
+  // the platform's display acquisition is optional, displays that nothing else drives work without
+  for(const auto& optional : m_headless ? std::vector<const char*>() : VKDPlatform::getInstanceExtensions())
+  {
+    bool const found = std::any_of(availableInstanceExtensions.begin(), availableInstanceExtensions.end(),
+                                   [&](const vk::ExtensionProperties& e) { return std::string(optional) == e.extensionName; });
+    if(found)
+    {
+      PRINTOK("OK: {}\n", optional);
+      instanceExtensions.push_back(optional);
+    }
+    else
+    {
+      PRINTW("NOT FOUND: {}\n", optional);
+    }
+  }
+  // VK_EXT_display_control needs it, beam racing works without knowing the scanout position, just not well
+  m_hasSurfaceCounter = false;
+  for(const auto& optional : m_headless || !m_config.beamRacingSlices ? std::vector<const char*>() : displayControlInstanceExtensions)
+  {
+    m_hasSurfaceCounter = std::any_of(availableInstanceExtensions.begin(), availableInstanceExtensions.end(),
+                                      [&](const vk::ExtensionProperties& e) { return std::string(optional) == e.extensionName; });
+    if(m_hasSurfaceCounter)
+    {
+      PRINTOK("OK: {}\n", optional);
+      instanceExtensions.push_back(optional);
+    }
+    else
+    {
+      PRINTW("NOT FOUND: {}\n", optional);
+    }
+  }
+  vk::InstanceCreateInfo createInfo{
+      vk::InstanceCreateFlags(), nullptr, 0, nullptr,
+      uint32_t(instanceExtensions.size()), instanceExtensions.data()};
+  m_instance = vk::createInstanceUnique(createInfo);
+
+  VULKAN_HPP_DEFAULT_DISPATCHER.init(m_instance.get());
+
+  {
+    uint32_t apiVersion;
+    vkEnumerateInstanceVersion(&apiVersion);
+    uint32_t major = VK_API_VERSION_MAJOR(apiVersion);
+    uint32_t minor = VK_API_VERSION_MINOR(apiVersion);
+    uint32_t patch = VK_API_VERSION_PATCH(apiVersion);
+    PRINTI("Instance version: {}.{}.{}", major, minor, patch);
+  }
+}
+
+bool VKDirectDisplay::checkDeviceExtensionSupport(vk::PhysicalDevice device)
+{
+  std::vector<vk::ExtensionProperties> availableDeviceExtensions = device.enumerateDeviceExtensionProperties();
+
+  std::cout << "\nChecking Device Extensions\n";
+
+  std::vector<const char*> extensions = requiredDeviceExtensions;
+  extensions.insert(extensions.end(), VKDPlatform::getDeviceExtensions().begin(), VKDPlatform::getDeviceExtensions().end());
+  for(const auto& required : extensions)
+  {
+    bool found = false;
+    for(const auto& available : availableDeviceExtensions)
+    {
+      if(std::string(required) == available.extensionName)
+      {
+        found = true;
+        PRINTOK("OK: {}\n", required);
+        break;
+      }
+    }
+    if(!found)
+    {
+      std::cerr << "\x1B[31mNOT FOUND: " << required << "\033[0m\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+bool VKDirectDisplay::checkTimelineSupport()
+{
+  // GL side
+  if(!has_GL_NV_timeline_semaphore)
+  {
+    PRINTW("NOT FOUND: GL_NV_timeline_semaphore\n");
+    return false;
+  }
+
+  // VK side
+  for(const auto& required : timelineDeviceExtensions)
+  {
+    if(!VKDPlatform::hasDeviceExtension(m_gpu, required))
+    {
+      PRINTW("NOT FOUND: {}\n", required);
+      return false;
+    }
+  }
+
+  auto features = m_gpu.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures,
+                                        vk::PhysicalDeviceSynchronization2FeaturesKHR>();
+  return features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore
+         && features.get<vk::PhysicalDeviceSynchronization2FeaturesKHR>().synchronization2;
+}
+
+bool VKDirectDisplay::checkPresentWaitSupport()
+{
+  for(const auto& required : presentWaitDeviceExtensions)
+  {
+    if(!VKDPlatform::hasDeviceExtension(m_gpu, required))
+    {
+      PRINTW("NOT FOUND: {}\n", required);
+      return false;
+    }
+  }
+
+  auto features = m_gpu.getFeatures2KHR<vk::PhysicalDeviceFeatures2, vk::PhysicalDevicePresentIdFeaturesKHR,
+                                        vk::PhysicalDevicePresentWaitFeaturesKHR>();
+  return features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId
+         && features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+}
+
+void VKDirectDisplay::pickGPU()
+{
+  // pick a GPU that has the required device extensions and has a display device attached
+  std::vector<vk::PhysicalDevice> devices = m_instance->enumeratePhysicalDevices();
+  PRINTI("\n\nFinding GPU with suitable display...\n\n");
+  for(const auto& device : devices)
+  {
+    const auto props = device.getProperties();
+    PRINTI("\nName:        {}\n", props.deviceName.data());
+
+    uint32_t major = VK_API_VERSION_MAJOR(props.apiVersion);
+    uint32_t minor = VK_API_VERSION_MINOR(props.apiVersion);
+    uint32_t patch = VK_API_VERSION_PATCH(props.apiVersion);
+    PRINTI("API version: {}.{}.{}\n", major, minor, patch);
+
+    auto const ids = device.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+    auto const uuid = toHex(ids.get<vk::PhysicalDeviceIDProperties>().deviceUUID.data(), VK_UUID_SIZE);
+    PRINTI("UUID:        {}\n", uuid);
+
+    // Config::displayDevice
+    auto const& wanted = m_config.displayDevice;
+    if(!wanted.empty() && uuid != wanted && std::string(props.deviceName.data()).find(wanted) == std::string::npos)
+    {
+      PRINTI("Not the configured display device\n");
+      continue;
+    }
+
+    if((m_headless || !device.getDisplayPropertiesKHR().empty()) && checkDeviceExtensionSupport(device))
+    {
+      // VK_KHR_display
+      // GPU with ddisplay found
+      PRINTI("Suitable device found\n");
+      m_gpu = device;
+      break;
+    }
+    PRINTE("Device not suitable\n");
+  }
+  if(!m_gpu)
+  {
+    throw std::runtime_error("Could not find a GPU with suitable display device!");
+  }
+
+}
+
+void VKDirectDisplay::createDisplaySurfaces()
+{
+  // RFE: make resolution cmd line controllable?
+
+  if(m_headless)
+  {
+    m_outputs.resize(std::max(m_config.displayCount, 1u));
+    for(auto& o : m_outputs)
+    {
+      createHeadlessSurface(o);
+    }
+    return;
+  }
+
+  // VK_KHR_display
+  // pick the configured range of displays
+  auto const displays = m_gpu.getDisplayPropertiesKHR();
+  for(uint32_t i = 0; i < displays.size(); ++i)
+  {
+    const auto& d = displays[i];
+    PRINTI("Display {}: {}, {} x {}\n", i, d.displayName ? d.displayName : "unnamed", d.physicalResolution.width,
+           d.physicalResolution.height);
+  }
+  uint32_t first = m_config.firstDisplay;
+  if(!m_config.displayName.empty())
+  {
+    auto const it = std::find_if(displays.begin(), displays.end(), [&](const vk::DisplayPropertiesKHR& d) {
+      return d.displayName && std::string(d.displayName).find(m_config.displayName) != std::string::npos;
+    });
+    if(it == displays.end())
+    {
+      throw std::runtime_error("no display named " + m_config.displayName);
+    }
+    first = uint32_t(it - displays.begin());
+  }
+  if(first >= displays.size())
+  {
+    throw std::runtime_error("display index out of range");
+  }
+  uint32_t const count = m_config.displayCount ? std::min(m_config.displayCount, uint32_t(displays.size()) - first)
+                                               : uint32_t(displays.size()) - first;
+
+  m_outputs.resize(count);
+  for(uint32_t i = 0; i < count; ++i)
+  {
+    m_outputs[i].display.displayProperties = displays[first + i];
+    m_outputs[i].display.displayKHR        = displays[first + i].display;
+    createDisplaySurface(m_outputs[i]);
+  }
+}
+
+void VKDirectDisplay::createHeadlessSurface(Output& o)
+{
+  // VK_EXT_headless_surface
+  // no display, the mode is made up so swapchain creation and frame pacing work unchanged
+  auto& mode                           = o.display.modeProperties.parameters;
+  mode.visibleRegion                   = vk::Extent2D(m_config.headlessWidth, m_config.headlessHeight);
+  mode.refreshRate                     = uint32_t(m_config.headlessRefreshHz * 1000.0f);
+  o.display.displayProperties.displayName = "headless";
+
+  o.surface = m_instance->createHeadlessSurfaceEXTUnique(vk::HeadlessSurfaceCreateInfoEXT{});
+  PRINTOK("Headless surface: {} x {} @ {}Hz\n", mode.visibleRegion.width, mode.visibleRegion.height, mode.refreshRate / 1000.0f);
+}
+
+void VKDirectDisplay::createDisplaySurface(Output& o)
+{
+  if(m_headless)
+  {
+    createHeadlessSurface(o);
+    return;
+  }
+
+  // VK_KHR_display
+  // create a display surface for ddisplay
+  auto& display = o.display;
+
+  // acquire display
+  m_platform.acquireDisplay(m_gpu, display.displayKHR);
+  display.acquired = true;
+
+  // pick the mode by Config::modePolicy
+  auto modes             = m_gpu.getDisplayModePropertiesKHR(display.displayKHR);
+  if(modes.empty())
+  {
+    throw std::runtime_error("display has no modes");
+  }
+  uint32_t const mode    = chooseDisplayMode(modes);
+  display.modeProperties = modes[mode];
+  for(uint32_t i = 0; i < modes.size(); ++i)
+  {
+    const auto& p = modes[i].parameters;
+    PRINTI("  mode {}: {} x {} @ {}Hz{}\n", i, p.visibleRegion.width, p.visibleRegion.height, p.refreshRate / 1000.0f,
+           i == mode ? " (selected)" : "");
+  }
+
+  // pick first compatible plane
+  auto     planes = m_gpu.getDisplayPlanePropertiesKHR();
+  for(uint32_t i = 0; i < planes.size(); ++i)
+  {
+    auto const supported = m_gpu.getDisplayPlaneSupportedDisplaysKHR(i);
+    PRINTI("  plane {}: stack index {}, {}, {}\n", i, planes[i].currentStackIndex,
+           planes[i].currentDisplay ? (planes[i].currentDisplay == display.displayKHR ? "on this display" : "on another display") : "unused",
+           std::find(supported.begin(), supported.end(), display.displayKHR) != supported.end() ? "supported" : "not supported");
+  }
+  uint32_t planeIndex;
+  bool     foundPlane = false;
+  for(uint32_t i = 0; i < planes.size(); ++i)
+  {
+    auto p = planes[i];
+
+    // skip planes bound to different display
+    if(p.currentDisplay && (p.currentDisplay != display.displayKHR))
+    {
+      continue;
+    }
+
+    // skip planes taken by other outputs
+    if(std::any_of(m_outputs.begin(), m_outputs.end(),
+                   [&](const Output& other) { return &other != &o && other.surface && other.display.planeIndex == i; }))
+    {
+      continue;
+    }
+
+    auto supportedDisplays = m_gpu.getDisplayPlaneSupportedDisplaysKHR(i);
+
+    for(auto& d : supportedDisplays)
+    {
+      if(d == display.displayKHR)
+      {
+        foundPlane = true;
+        planeIndex = i;
+        break;
+      }
+    }
+
+    if(foundPlane)
+    {
+      break;
+    }
+  }
+
+  if(!foundPlane)
+  {
+    throw std::runtime_error("Could not find a compatible display plane!");
+  }
+
+  // find alpha mode bit
+  auto planeCapabilities = m_gpu.getDisplayPlaneCapabilitiesKHR(display.modeProperties.displayMode, planeIndex);
+  vk::DisplayPlaneAlphaFlagBitsKHR alphaMode     = vk::DisplayPlaneAlphaFlagBitsKHR::eOpaque;
+  vk::DisplayPlaneAlphaFlagBitsKHR alphaModes[4] = {vk::DisplayPlaneAlphaFlagBitsKHR::eOpaque,
                                                     vk::DisplayPlaneAlphaFlagBitsKHR::eGlobal,
                                                     vk::DisplayPlaneAlphaFlagBitsKHR::ePerPixel,
                                                     vk::DisplayPlaneAlphaFlagBitsKHR::ePerPixelPremultiplied};
   for(uint32_t i = 0; i < sizeof(alphaModes); i++)
   {
-    if(planeCapabilities.supportedAlpha & alphaModes[i])
+    if(planeCapabilities.supportedAlpha & alphaModes[i])
+    {
+      alphaMode = alphaModes[i];
+      break;
+    }
+  }
+
+  vk::DisplaySurfaceCreateInfoKHR surfaceCreateInfo{vk::DisplaySurfaceCreateFlagBitsKHR(),
+                                                    display.modeProperties.displayMode,
+                                                    planeIndex,
+                                                    planes[planeIndex].currentStackIndex,
+                                                    vk::SurfaceTransformFlagBitsKHR::eIdentity,
+                                                    1.0f,
+                                                    alphaMode,
+                                                    vk::Extent2D(display.modeProperties.parameters.visibleRegion.width,
+                                                                 display.modeProperties.parameters.visibleRegion.height)};
+
+  display.planeIndex = planeIndex;
+  o.surface          = m_instance->createDisplayPlaneSurfaceKHRUnique(surfaceCreateInfo);
+
+  const auto& d = display.displayProperties;
+  PRINTOK("Using display: {}\n  physical resolution: {} x {}\n", d.displayName, d.physicalResolution.width,
+        d.physicalResolution.height);
+
+  const auto& m = display.modeProperties;
+  PRINTOK("Display mode: {} x {} @ {}Hz\n", m.parameters.visibleRegion.width, m.parameters.visibleRegion.height,
+        m.parameters.refreshRate / 1000.0f);
+}
+
+uint32_t VKDirectDisplay::chooseDisplayMode(const std::vector<vk::DisplayModePropertiesKHR>& modes) const
+{
+  // compare pixels with pixels and refresh rates with refresh rates, never a sum of both
+  auto area = [](const vk::DisplayModePropertiesKHR& m) {
+    return uint64_t(m.parameters.visibleRegion.width) * m.parameters.visibleRegion.height;
+  };
+  auto refresh = [](const vk::DisplayModePropertiesKHR& m) { return m.parameters.refreshRate; };
+  auto atLeast = [&](const vk::DisplayModePropertiesKHR& m) {
+    return m.parameters.visibleRegion.width >= m_config.modeWidth && m.parameters.visibleRegion.height >= m_config.modeHeight;
+  };
+
+  // index of the best mode by the given ordering among the qualifying ones, ~0u if none qualifies
+  auto best = [&](auto qualifies, auto less) {
+    uint32_t found = ~0u;
+    for(uint32_t i = 0; i < modes.size(); ++i)
+    {
+      if(qualifies(modes[i]) && (found == ~0u || less(modes[found], modes[i])))
+      {
+        found = i;
+      }
+    }
+    return found;
+  };
+  auto byArea = [&](const vk::DisplayModePropertiesKHR& a, const vk::DisplayModePropertiesKHR& b) {
+    return std::make_pair(area(a), refresh(a)) < std::make_pair(area(b), refresh(b));
+  };
+  auto byRefresh = [&](const vk::DisplayModePropertiesKHR& a, const vk::DisplayModePropertiesKHR& b) {
+    return std::make_pair(refresh(a), area(a)) < std::make_pair(refresh(b), area(b));
+  };
+
+  uint32_t found = ~0u;
+  switch(m_config.modePolicy)
+  {
+    case ModePolicy::eLargest:
+      break;
+    case ModePolicy::eMaxRefresh:
+      found = best(atLeast, byRefresh);
+      break;
+    case ModePolicy::eExact:
+    {
+      // no refresh rate given: the highest one, mHz
+      int64_t const target = m_config.modeRefreshHz > 0.0f ? int64_t(m_config.modeRefreshHz * 1000.0f) : INT64_MAX / 2;
+      found                = best(
+          [&](const vk::DisplayModePropertiesKHR& m) {
+            return m.parameters.visibleRegion.width == m_config.modeWidth && m.parameters.visibleRegion.height == m_config.modeHeight;
+          },
+          [&](const vk::DisplayModePropertiesKHR& a, const vk::DisplayModePropertiesKHR& b) {
+            return std::abs(int64_t(refresh(a)) - target) > std::abs(int64_t(refresh(b)) - target);
+          });
+      break;
+    }
+    case ModePolicy::eFitRenderTime:
+    {
+      found = best(
+          [&](const vk::DisplayModePropertiesKHR& m) {
+            return atLeast(m) && 1.0e6 / refresh(m) >= m_config.modeFrameTimeMs;  // refreshRate is in mHz
+          },
+          byRefresh);
+      if(found == ~0u)
+      {
+        // nothing is slow enough, take the slowest refresh
+        found = best(atLeast, [&](const vk::DisplayModePropertiesKHR& a, const vk::DisplayModePropertiesKHR& b) {
+          return std::make_pair(refresh(a), area(b)) > std::make_pair(refresh(b), area(a));
+        });
+      }
+      break;
+    }
+  }
+  if(found == ~0u)
+  {
+    if(m_config.modePolicy != ModePolicy::eLargest)
+    {
+      PRINTW("No display mode matches the mode policy, using the largest\n");
+    }
+    found = best([](const vk::DisplayModePropertiesKHR&) { return true; }, byArea);
+  }
+  return found;
+}
+
+void VKDirectDisplay::createLogicalDevice()
+{
+  // find graphics and present queue(s), preferably one family that does both
+  m_queueFamilies      = m_gpu.getQueueFamilyProperties();
+  auto const& families = m_queueFamilies;
+  uint32_t const none  = VK_QUEUE_FAMILY_IGNORED;
+  m_graphicsFamily     = none;
+  m_presentFamily      = none;
+  m_transferFamily     = none;
+  for(uint32_t i = 0; i < families.size(); ++i)
+  {
+    bool const graphics = bool(families[i].queueFlags & vk::QueueFlagBits::eGraphics);
+    bool const present  = std::all_of(m_outputs.begin(), m_outputs.end(),
+                                      [&](const Output& o) { return m_gpu.getSurfaceSupportKHR(i, o.surface.get()); });
+    if(graphics && present && (m_graphicsFamily == none || m_graphicsFamily != m_presentFamily))
+    {
+      m_graphicsFamily = i;
+      m_presentFamily  = i;
+    }
+    else if(graphics && m_graphicsFamily == none)
+    {
+      m_graphicsFamily = i;
+    }
+    else if(present && m_presentFamily == none)
+    {
+      m_presentFamily = i;
+    }
+  }
+
+  if(m_graphicsFamily == none || m_presentFamily == none)
+  {
+    throw std::runtime_error("failed to find suitable queue family");
+  }
+
+  // a family without graphics for the copies, dedicated transfer (DMA) before async compute
+  if(m_requestedTransferQueue)
+  {
+    for(uint32_t i = 0; i < families.size(); ++i)
+    {
+      auto const flags = families[i].queueFlags;
+      if((flags & vk::QueueFlagBits::eGraphics) || !(flags & (vk::QueueFlagBits::eTransfer | vk::QueueFlagBits::eCompute)))
+      {
+        continue;
+      }
+      if(m_transferFamily == none
+         || (!(flags & vk::QueueFlagBits::eCompute) && (families[m_transferFamily].queueFlags & vk::QueueFlagBits::eCompute)))
+      {
+        m_transferFamily = i;
+      }
+    }
+  }
+
+  float priority = 1.0f;
+
+  std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos{ {vk::DeviceQueueCreateFlags(), m_graphicsFamily, 1, &priority} };
+  for(uint32_t family : { m_presentFamily, m_transferFamily })
+  {
+    bool const listed = std::any_of(queueCreateInfos.begin(), queueCreateInfos.end(),
+                                    [&](const vk::DeviceQueueCreateInfo& q) { return q.queueFamilyIndex == family; });
+    if(family != none && !listed)
+    {
+      queueCreateInfos.push_back({vk::DeviceQueueCreateFlags(), family, 1, &priority});
+    }
+  }
+
+  m_deviceExtensions = requiredDeviceExtensions;
+  m_deviceExtensions.insert(m_deviceExtensions.end(), VKDPlatform::getDeviceExtensions().begin(), VKDPlatform::getDeviceExtensions().end());
+  if(m_syncMode == SyncMode::eTimeline || m_compositor)
+  {
+    m_deviceExtensions.insert(m_deviceExtensions.end(), timelineDeviceExtensions.begin(), timelineDeviceExtensions.end());
+  }
+  if(m_pacing.presentWait)
+  {
+    m_deviceExtensions.insert(m_deviceExtensions.end(), presentWaitDeviceExtensions.begin(), presentWaitDeviceExtensions.end());
+  }
+  if(m_incrementalPresent)
+  {
+    m_deviceExtensions.push_back(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+  }
+  if(m_hasDisplayControl)
+  {
+    m_deviceExtensions.push_back(VK_EXT_DISPLAY_CONTROL_EXTENSION_NAME);
+  }
+  if(m_hasHostImport)
+  {
+    m_deviceExtensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+  }
+  if(m_native)
+  {
+    // the native renderer flips its viewport to GL orientation, a negative height needs maintenance1 on a 1.0 instance
+    if(!VKDPlatform::hasDeviceExtension(m_gpu, VK_KHR_MAINTENANCE1_EXTENSION_NAME))
+    {
+      throw std::runtime_error("the native renderer needs VK_KHR_maintenance1");
+    }
+    m_deviceExtensions.push_back(VK_KHR_MAINTENANCE1_EXTENSION_NAME);
+  }
+  m_hasDedicatedQuery = std::all_of(dedicatedDeviceExtensions.begin(), dedicatedDeviceExtensions.end(),
+                                    [&](const char* name) { return VKDPlatform::hasDeviceExtension(m_gpu, name); });
+  if(m_hasDedicatedQuery)
+  {
+    m_deviceExtensions.insert(m_deviceExtensions.end(), dedicatedDeviceExtensions.begin(), dedicatedDeviceExtensions.end());
+  }
+
+  vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures, vk::PhysicalDeviceSynchronization2FeaturesKHR,
+                     vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>
+      deviceFeatures;
+  deviceFeatures.get<vk::PhysicalDeviceFeatures2>().features = m_gpu.getFeatures();
+  if(m_syncMode == SyncMode::eTimeline || m_compositor)
+  {
+    deviceFeatures.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore = VK_TRUE;
+    deviceFeatures.get<vk::PhysicalDeviceSynchronization2FeaturesKHR>().synchronization2 = VK_TRUE;
+  }
+  else
+  {
+    deviceFeatures.unlink<vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+    deviceFeatures.unlink<vk::PhysicalDeviceSynchronization2FeaturesKHR>();
+  }
+  if(m_pacing.presentWait)
+  {
+    deviceFeatures.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId     = VK_TRUE;
+    deviceFeatures.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait = VK_TRUE;
+  }
+  else
+  {
+    deviceFeatures.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+    deviceFeatures.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+  }
+
+  // create the logical device and the queues
+  vk::DeviceCreateInfo deviceCreateInfo{vk::DeviceCreateFlags(),
+                                        uint32_t(queueCreateInfos.size()),
+                                        queueCreateInfos.data(),
+                                        0,
+                                        nullptr,
+                                        uint32_t(m_deviceExtensions.size()),
+                                        m_deviceExtensions.data(),
+                                        nullptr};
+  deviceCreateInfo.setPNext(&deviceFeatures.get<vk::PhysicalDeviceFeatures2>());
+
+  m_device       = m_gpu.createDeviceUnique(deviceCreateInfo);
+  m_graphicsQueue = m_device->getQueue(m_graphicsFamily, 0);
+  m_presentQueue  = m_device->getQueue(m_presentFamily, 0);
+  if(m_presentFamily != m_graphicsFamily)
+  {
+    PRINTI("VKDirectDisplay: present queue family {} separate from graphics family {}\n", m_presentFamily, m_graphicsFamily);
+  }
+  if(m_transferFamily != none)
+  {
+    m_transferQueue = m_device->getQueue(m_transferFamily, 0);
+  }
+
+  // device level entry points, e.g. for the KHR timeline & synchronization2 functions
+  VULKAN_HPP_DEFAULT_DISPATCHER.init(m_device.get());
+
+  load_VK_EXTENSIONS(m_instance.get(), vkGetInstanceProcAddr, m_device.get(), vkGetDeviceProcAddr);
+}
+
+void VKDirectDisplay::createCommandPool()
+{
+    // create command pools, one per family VK records for
+    // blit command buffers are re-recorded individually when the render extent changes
+    vk::CommandPoolCreateInfo commandPoolCreateInfo = { vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_graphicsFamily };
+    m_commandPool = m_device->createCommandPoolUnique(commandPoolCreateInfo);
+    if(m_transferFamily != VK_QUEUE_FAMILY_IGNORED)
+    {
+      commandPoolCreateInfo.setQueueFamilyIndex(m_transferFamily);
+      m_transferPool = m_device->createCommandPoolUnique(commandPoolCreateInfo);
+    }
+    if(m_presentFamily != m_graphicsFamily || m_transferPool)
+    {
+      commandPoolCreateInfo.setQueueFamilyIndex(m_presentFamily);
+      m_presentPool = m_device->createCommandPoolUnique(commandPoolCreateInfo);
+    }
+
+    // until the copy path is known
+    m_blitFamily = m_graphicsFamily;
+    m_blitQueue  = m_graphicsQueue;
+    m_blitPool   = m_commandPool.get();
+}
+
+void VKDirectDisplay::selectBlitQueue()
+{
+  // the copy can run on the transfer queue, the flipping or scaling blit needs graphics
+  // beam racing keeps the swapchain images' contents between slices, it stays on the graphics queue
+  bool transfer = m_copyFastPath && !m_resolution.enabled && !m_beamRacing.slices && m_transferFamily != VK_QUEUE_FAMILY_IGNORED;
+  if(transfer)
+  {
+    // the outputs' regions have to match the transfer granularity, 0 means whole images only
+    auto const g    = m_queueFamilies[m_transferFamily].minImageTransferGranularity;
+    auto       fits = [&](const Output& o) {
+      if(!g.width || !g.height)
+      {
+        return o.offset == vk::Offset2D() && o.extent == m_interopExtent;
+      }
+      return o.offset.x % g.width == 0 && o.offset.y % g.height == 0
+             && (o.extent.width % g.width == 0 || o.offset.x + o.extent.width == m_interopExtent.width)
+             && (o.extent.height % g.height == 0 || o.offset.y + o.extent.height == m_interopExtent.height);
+    };
+    transfer = std::all_of(m_outputs.begin(), m_outputs.end(), fits);
+  }
+
+  m_blitFamily    = transfer ? m_transferFamily : m_graphicsFamily;
+  m_blitQueue     = transfer ? m_transferQueue : m_graphicsQueue;
+  m_blitPool      = transfer ? m_transferPool.get() : m_commandPool.get();
+  m_blitStage     = transfer ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eColorAttachmentOutput;
+  m_interopAccess = transfer ? vk::AccessFlags() : vk::AccessFlags(vk::AccessFlagBits::eColorAttachmentWrite);
+
+  // blit timestamps need a queue that supports them and can reset queries in a command buffer
+  auto const& family = m_queueFamilies[m_blitFamily];
+  bool const  timestamps = family.timestampValidBits && (family.queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+  m_timestampPeriod = timestamps ? m_gpu.getProperties().limits.timestampPeriod : 0.0f;
+
+  PRINTI("VKDirectDisplay: blits on queue family {}{}\n", m_blitFamily, transfer ? " (transfer)" : "");
+}
+
+void VKDirectDisplay::createSwapchain()
+{
+  // pick a present mode according to the policy, from the ones all outputs support
+  m_supportedPresentModes = m_gpu.getSurfacePresentModesKHR(m_outputs[0].surface.get());
+  for(size_t i = 1; i < m_outputs.size(); ++i)
+  {
+    auto const modes = m_gpu.getSurfacePresentModesKHR(m_outputs[i].surface.get());
+    m_supportedPresentModes.erase(std::remove_if(m_supportedPresentModes.begin(), m_supportedPresentModes.end(),
+                                                 [&](vk::PresentModeKHR m) {
+                                                   return std::find(modes.begin(), modes.end(), m) == modes.end();
+                                                 }),
+                                  m_supportedPresentModes.end());
+  }
+  vk::PresentModeKHR const presentMode = choosePresentMode(m_supportedPresentModes);
+
+  // outputs side by side in the interop textures, top aligned
+  m_interopExtent = vk::Extent2D(0, 0);
+  for(auto& o : m_outputs)
+  {
+    createSwapchain(o, presentMode);
+    o.offset        = vk::Offset2D(int32_t(m_interopExtent.width), 0);
+    m_interopExtent = vk::Extent2D(m_interopExtent.width + o.extent.width, std::max(m_interopExtent.height, o.extent.height));
+  }
+
+  // the canvas is one image, several large displays side by side can exceed the device limit
+  uint32_t const maxDimension = m_gpu.getProperties().limits.maxImageDimension2D;
+  if(m_interopExtent.width > maxDimension || m_interopExtent.height > maxDimension)
+  {
+    throw std::runtime_error(std::to_string(m_outputs.size()) + " displays side by side need a " + std::to_string(m_interopExtent.width)
+                             + " x " + std::to_string(m_interopExtent.height) + " canvas, the device supports at most "
+                             + std::to_string(maxDimension) + ", use fewer displays");
+  }
+
+  // present ids of the old swapchain can't be waited for anymore
+  m_pacing.waitedId = m_pacing.presentId;
+
+  // nothing on the displays until the next present
+  m_frameRequired = true;
+
+  // the time spent in the previous mode counts towards its stats
+  {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    auto const                  now = std::chrono::steady_clock::now();
+    if(m_presentModeStats.count(m_presentMode))
     {
-      alphaMode = alphaModes[i];
+      m_presentModeStats[m_presentMode].seconds += toMs(now - m_presentModeStart) * 1.0e-3;
+    }
+    m_presentMode = presentMode;
+    m_presentModeStats[m_presentMode];
+    m_presentModeStart = now;
+  }
+}
+
+void VKDirectDisplay::createSwapchain(Output& o, vk::PresentModeKHR presentMode)
+{
+  // nothing on the display until its first present
+  o.stale = true;
+
+  auto formats      = m_gpu.getSurfaceFormatsKHR(o.surface.get());
+  auto capabilities = m_gpu.getSurfaceCapabilitiesKHR(o.surface.get());
+
+  // image count depending on request and capabilities, maxImageCount 0 means no limit
+  uint32_t imageCount = m_requestedSwapchainImages ? m_requestedSwapchainImages : capabilities.minImageCount + 1;
+  imageCount          = std::max(imageCount, capabilities.minImageCount);
+  if(capabilities.maxImageCount)
+  {
+    imageCount = std::min(imageCount, capabilities.maxImageCount);
+  }
+
+  // pick a preferred format or use the first available one
+  // the copy fast path prefers a format GL can render to directly
+  std::vector<vk::SurfaceFormatKHR> preferred;
+  if(m_requestedCopyFastPath)
+  {
+    preferred.push_back({vk::Format::eR8G8B8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear});
+  }
+  preferred.push_back({vk::Format::eB8G8R8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear});
+
+  vk::SurfaceFormatKHR format = preferred[0];
+  bool                 valid  = false;
+  if(formats.size() == 1 && formats[0].format == vk::Format::eUndefined)
+  {
+    valid = true;
+  }
+  for(auto& p : preferred)
+  {
+    if(std::find(formats.begin(), formats.end(), p) != formats.end())
+    {
+      format = p;
+      valid  = true;
       break;
     }
   }
+  if(!valid)
+  {
+    format = formats[0];
+  }
+  
+  // use valid extent if available, otherwise derive from display mode
+  vk::Extent2D extent;
+  if(capabilities.currentExtent.width == 0xFFFFFFFF)
+  {
+    extent        = o.display.modeProperties.parameters.visibleRegion;
 
-  vk::DisplaySurfaceCreateInfoKHR surfaceCreateInfo{vk::DisplaySurfaceCreateFlagBitsKHR(),
-                                                    m_display.modeProperties.displayMode,
-                                                    planeIndex,
-                                                    planes[planeIndex].currentStackIndex,
-                                                    vk::SurfaceTransformFlagBitsKHR::eIdentity,
-                                                    1.0f,
-                                                    alphaMode,
-                                                    vk::Extent2D(m_display.modeProperties.parameters.visibleRegion.width,
-                                                                 m_display.modeProperties.parameters.visibleRegion.height)};
+    auto clamp = [](int val, int min, int max) { return (val < min) ? min : (val > max) ? max : val; };
+    extent.width  = clamp(extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+    extent.height = clamp(extent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+  }
+  else
+  {
+    extent = capabilities.currentExtent;
+  }
 
-  m_surface = m_instance->createDisplayPlaneSurfaceKHRUnique(surfaceCreateInfo);
+  vk::SurfaceTransformFlagBitsKHR pretransform = vk::SurfaceTransformFlagBitsKHR::eIdentity;
+  if((pretransform & capabilities.supportedTransforms) != pretransform)
+  {
+    pretransform = capabilities.currentTransform;
+  }
 
-  const auto& d = m_display.displayProperties;
-  PRINTOK("Using display: {}\n  physical resolution: {} x {}\n", d.displayName, d.physicalResolution.width,
-        d.physicalResolution.height);
+  // VK_KHR_display
+  // create swapchain using the ddisplay surface created before
 
-  const auto& m = m_display.modeProperties;
-  PRINTOK("Display mode: {} x {} @ {}Hz\n", m.parameters.visibleRegion.width, m.parameters.visibleRegion.height,
-        m.parameters.refreshRate / 1000.0f);
+  vk::SwapchainCreateInfoKHR swapchainCreateInfo{vk::SwapchainCreateFlagsKHR(),
+                                                 o.surface.get(),
+                                                 imageCount,
+                                                 format.format,
+                                                 format.colorSpace,
+                                                 extent,
+                                                 1,
+                                                 vk::ImageUsageFlags(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst),
+                                                 vk::SharingMode::eExclusive,
+                                                 0,
+                                                 nullptr,
+                                                 pretransform,
+                                                 vk::CompositeAlphaFlagBitsKHR::eOpaque,
+                                                 presentMode,
+                                                 VK_TRUE,
+                                                 o.swapchain.get()};
+
+  o.swapchain = m_device->createSwapchainKHRUnique(swapchainCreateInfo);
+  o.images    = m_device->getSwapchainImagesKHR(o.swapchain.get());
+  o.extent    = extent;
+  o.format    = format.format;
+
+  // don't need to transition swapchain images from eUndefined here
 }
 
-void VKDirectDisplay::createLogicalDevice()
+vk::PresentModeKHR VKDirectDisplay::choosePresentMode(const std::vector<vk::PresentModeKHR>& presentModes) const
 {
-  // find graphics and present queue(s)
-  auto families = m_gpu.getQueueFamilyProperties();
-  bool found    = false;
-  for(uint32_t i = 0; i < families.size(); ++i)
+  std::vector<vk::PresentModeKHR> preferred;
+  switch(m_presentPolicy)
+  {
+    case PresentPolicy::eNoTearing:
+      preferred = {vk::PresentModeKHR::eMailbox};
+      break;
+    case PresentPolicy::eLowestLatency:
+      preferred = {vk::PresentModeKHR::eImmediate, vk::PresentModeKHR::eMailbox, vk::PresentModeKHR::eFifoRelaxed};
+      break;
+    case PresentPolicy::eLowestPower:
+      break;
+    case PresentPolicy::eExplicit:
+      preferred = {m_requestedPresentMode};
+      break;
+  }
+
+  // FIFO is always supported
+  for(auto p : preferred)
   {
-    if((families[i].queueFlags & vk::QueueFlagBits::eGraphics) && (m_gpu.getSurfaceSupportKHR(i, m_surface.get())))
+    if(std::find(presentModes.begin(), presentModes.end(), p) != presentModes.end())
     {
-      // RFE: implement support for different (graphics != present) families
-      m_presentFamily = i;
-      found           = true;
+      return p;
+    }
+  }
+  return vk::PresentModeKHR::eFifo;
+}
+
+void VKDirectDisplay::recreateSwapchain()
+{
+  // the interop textures stay, everything referencing swapchain images is rebuilt
+  m_device->waitIdle();
+
+  freeBlitCommandBuffers();
+  createSwapchain();
+  createSyncs();
+  createCommandBuffers();
+}
+
+void VKDirectDisplay::freeBlitCommandBuffers()
+{
+  for(auto& o : m_outputs)
+  {
+    if(!o.blitCommandBuffers.empty())
+    {
+      m_device->freeCommandBuffers(m_blitPool, o.blitCommandBuffers);
+      o.blitCommandBuffers.clear();
+      o.blitSources.clear();
+    }
+    if(o.synthCommandBuffer)
+    {
+      m_device->freeCommandBuffers(m_blitPool, o.synthCommandBuffer);
+      o.synthCommandBuffer = nullptr;
+    }
+    if(!o.sliceCommandBuffers.empty())
+    {
+      m_device->freeCommandBuffers(m_blitPool, o.sliceCommandBuffers);
+      m_device->freeCommandBuffers(m_blitPool, o.sliceInitCommandBuffers);
+      o.sliceCommandBuffers.clear();
+      o.sliceInitCommandBuffers.clear();
+      o.sliceInitialized.clear();
+    }
+    if(!o.ownershipCommandBuffers.empty())
+    {
+      m_device->freeCommandBuffers(m_presentPool.get(), o.ownershipCommandBuffers);
+      o.ownershipCommandBuffers.clear();
     }
   }
+  if(!m_uploadCommandBuffers.empty())
+  {
+    m_device->freeCommandBuffers(m_blitPool, m_uploadCommandBuffers);
+    m_uploadCommandBuffers.clear();
+  }
+  if(!m_exportCommandBuffers.empty())
+  {
+    m_device->freeCommandBuffers(m_blitPool, m_exportCommandBuffers);
+    m_exportCommandBuffers.clear();
+  }
+  if(!m_composeCommandBuffers.empty())
+  {
+    m_device->freeCommandBuffers(m_blitPool, m_composeCommandBuffers);
+    m_composeCommandBuffers.clear();
+  }
+  for(auto& s : m_syncData)
+  {
+    s.m_lastBlit = -1;
+  }
+}
+
+void VKDirectDisplay::requestRecreate(uint32_t flags)
+{
+  // called from whichever thread presents
+  m_recreateFlags.fetch_or(flags);
+}
 
-  if(!found)
+void VKDirectDisplay::recover()
+{
+  uint32_t const flags = m_recreateFlags.load();
+  if(!flags)
   {
-    throw std::exception("failed to find suitable queue family");
+    return;
   }
 
-  float priority = 1.0f;
+  // without a swapchain the display is likely in standby, don't hammer the driver
+  auto const now = std::chrono::steady_clock::now();
+  if(isSuspended() && now - m_lastRecoverAttempt < std::chrono::milliseconds(500))
+  {
+    return;
+  }
+  m_lastRecoverAttempt = now;
+  m_recreateFlags &= ~flags;
 
-  vk::DeviceQueueCreateInfo queueCreateInfo{vk::DeviceQueueCreateFlags(), m_presentFamily, 1, &priority};
+  // the vblank thread registers events on the first display, which may be released and acquired again
+  bool const presentThread = m_presentThread.joinable();
+  bool const vblankThread  = m_beamRacing.vblankThread.joinable();
+  stopPresentThread();
+  stopVblankThread();
+  try
+  {
+    releaseLayers();
+    glFinish();
+    m_device->waitIdle();
 
-  vk::PhysicalDeviceFeatures deviceFeatures = m_gpu.getFeatures();  
+    vk::Extent2D const extent = m_interopExtent;
+    vk::Format const   format = m_outputs[0].format;
 
-  // create the logical device and the present queue
-  vk::DeviceCreateInfo deviceCreateInfo{vk::DeviceCreateFlags(),
-                                        1,
-                                        &queueCreateInfo,
-                                        0,
-                                        nullptr,
-                                        uint32_t(requiredDeviceExtensions.size()),
-                                        requiredDeviceExtensions.data(),
-                                        &deviceFeatures};
+    if(flags & eRecreateSurface)
+    {
+      // a new surface can't inherit the old swapchain, reacquire the displays along with it
+      freeBlitCommandBuffers();
+      for(auto& o : m_outputs)
+      {
+        o.swapchain.reset();
+        o.images.clear();
+        o.surface.reset();
+        if(o.display.acquired)
+        {
+          m_gpu.releaseDisplayEXT(o.display.displayKHR);
+          o.display.acquired = false;
+        }
+      }
+      for(auto& o : m_outputs)
+      {
+        createDisplaySurface(o);
+      }
+    }
+    recreateSwapchain();
 
-  m_device       = m_gpu.createDeviceUnique(deviceCreateInfo);
-  m_presentQueue = m_device->getQueue(m_presentFamily, 0);
+    // the interop textures only need to follow if the swapchain images changed shape
+    if(m_interopExtent != extent || m_outputs[0].format != format)
+    {
+      destroySyncObjects();
+      createSyncObjects();
+      createSyncs();
+      createCommandBuffers();
+      m_frameIndex = 0;
+    }
 
-  load_VK_EXTENSIONS(m_instance.get(), vkGetInstanceProcAddr, m_device.get(), vkGetDeviceProcAddr);
+    {
+      std::lock_guard<std::mutex> lock(m_statsMutex);
+      m_stallStats.recoveries++;
+    }
+    PRINTI("VKDirectDisplay: swapchain rebuilt, {} x {}\n", m_interopExtent.width, m_interopExtent.height);
+  }
+  catch(std::exception const& e)
+  {
+    // e.g. display still in standby: drop frames until the next attempt succeeds
+    PRINTW("VKDirectDisplay: swapchain rebuild failed, retrying: {}\n", e.what());
+    freeBlitCommandBuffers();
+    for(auto& o : m_outputs)
+    {
+      o.swapchain.reset();
+      o.images.clear();
+    }
+    m_recreateFlags |= flags;
+  }
+
+  if(presentThread)
+  {
+    startPresentThread();
+  }
+  if(vblankThread)
+  {
+    startVblankThread();
+  }
 }
 
-void VKDirectDisplay::createCommandPool()
+void VKDirectDisplay::createInteropImage(VKGLSyncData& s, vk::Extent2D extent)
 {
-    // create command pool
-    vk::CommandPoolCreateInfo commandPoolCreateInfo = { vk::CommandPoolCreateFlags(), m_presentFamily };
-    m_commandPool = m_device->createCommandPoolUnique(commandPoolCreateInfo);
+  // vk image, hint we want to export this memory (eOpaqueWin32 / eOpaqueFd)
+  vk::ImageCreateInfo imageCreateInfo = {vk::ImageCreateFlags(),
+                                         vk::ImageType::e2D,
+                                         m_interopFormat,
+                                         vk::Extent3D(extent, 1),
+                                         1,
+                                         1,
+                                         vk::SampleCountFlagBits::e1,
+                                         vk::ImageTiling::eOptimal,
+                                         vk::ImageUsageFlags(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc),
+                                         vk::SharingMode::eExclusive,
+                                         0,
+                                         nullptr,
+                                         vk::ImageLayout::eUndefined};
+  vk::ExternalMemoryImageCreateInfo externalMemoryImageCreateInfo = { VKDPlatform::memoryHandleType };
+  imageCreateInfo.setPNext(&externalMemoryImageCreateInfo);
+  s.m_image = m_device->createImageUnique(imageCreateInfo);
 }
 
-void VKDirectDisplay::createSwapchain()
+bool VKDirectDisplay::requiresDedicatedMemory(vk::Image image)
+{
+  if(!m_hasDedicatedQuery)
+  {
+    return false;
+  }
+
+  vk::ImageMemoryRequirementsInfo2 info{ image };
+  auto requirements = m_device->getImageMemoryRequirements2KHR<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(info);
+  return requirements.get<vk::MemoryDedicatedRequirements>().requiresDedicatedAllocation;
+}
+
+void VKDirectDisplay::allocateInteropMemory(const vk::MemoryRequirements& requirements, vk::Image dedicatedImage, InteropMemory& m)
+{
+  vk::MemoryAllocateInfo memoryAllocateInfo{requirements.size,
+                                            VKDPlatform::findMemoryType(m_gpu, requirements.memoryTypeBits, vk::MemoryPropertyFlags())};
+
+  // vk memory, also hint we want to export it
+  vk::ExportMemoryAllocateInfo exportMemoryAllocateInfo(VKDPlatform::memoryHandleType);
+  memoryAllocateInfo.setPNext(&exportMemoryAllocateInfo);
+
+  vk::MemoryPriorityAllocateInfoEXT memoryPriorityAllocateInfo(1.0f);
+  exportMemoryAllocateInfo.setPNext(&memoryPriorityAllocateInfo);
+
+  vk::MemoryDedicatedAllocateInfo dedicatedAllocateInfo{ dedicatedImage };
+  if(dedicatedImage)
+  {
+    memoryPriorityAllocateInfo.setPNext(&dedicatedAllocateInfo);
+  }
+
+  m.m_deviceMemory = m_device->allocateMemoryUnique(memoryAllocateInfo);
+  m.m_size         = requirements.size;
+
+  // create OpenGL interop data
+  m.m_handle = VKDPlatform::exportMemory(m_device.get(), m.m_deviceMemory.get());
+
+  glCreateMemoryObjectsEXT(1, &m.m_memoryObject);
+  if(dedicatedImage)
+  {
+    GLint dedicated = GL_TRUE;
+    glMemoryObjectParameterivEXT(m.m_memoryObject, GL_DEDICATED_MEMORY_OBJECT_EXT, &dedicated);
+  }
+  VKDPlatform::importMemory(m.m_memoryObject, m.m_size, m.m_handle);
+}
+
+void VKDirectDisplay::destroyInteropMemory(InteropMemory& m)
+{
+  // textures and images using the memory have to be deleted already
+  if(m.m_memoryObject)
+  {
+    glDeleteMemoryObjectsEXT(1, &m.m_memoryObject);
+    m.m_memoryObject = 0;
+  }
+  VKDPlatform::closeHandle(m.m_handle);
+  m.m_deviceMemory.reset();
+  m.m_size = 0;
+}
+
+void VKDirectDisplay::createInteropTexture(vk::CommandBuffer buf, VKGLSyncData& s, const InteropMemory& m, vk::DeviceSize offset, vk::Extent2D extent)
+{
+  // bind the VK image to its memory and create the GL texture on the same memory
+  m_device->bindImageMemory(s.m_image.get(), m.m_deviceMemory.get(), offset);
+
+  // transition image from eUndefined to vColorAttachmentOptimal, recorded into the caller's command buffer
+  transitionImage(buf, s.m_image.get(),
+    vk::AccessFlagBits::eNone,
+    m_interopAccess,
+    vk::ImageLayout::eUndefined,
+    vk::ImageLayout::eColorAttachmentOptimal,
+    m_blitStage,
+    m_blitStage
+  );
+
+  glCreateTextures(GL_TEXTURE_2D, 1, &s.m_textureGL);
+  glTextureStorageMem2DEXT(s.m_textureGL, 1, VKDPlatform::getGLFormat(m_interopFormat), extent.width, extent.height, m.m_memoryObject, offset);
+
+  GLint internalFormat;
+  glGetTextureLevelParameteriv(s.m_textureGL, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+}
+
+void VKDirectDisplay::createInteropSemaphore(vk::SemaphoreType type, vk::UniqueSemaphore& s, VKDPlatform::Handle& h, GLuint& g)
+{
+  // create a VK semaphore and fill the GL interop data
+  vk::SemaphoreCreateInfo       createInfo{};
+  vk::ExportSemaphoreCreateInfo exportCreateInfo{VKDPlatform::semaphoreHandleType};
+  vk::SemaphoreTypeCreateInfo   typeCreateInfo{type, 0};
+  createInfo.setPNext(&exportCreateInfo);
+  if(type == vk::SemaphoreType::eTimeline)
+  {
+    exportCreateInfo.setPNext(&typeCreateInfo);
+  }
+
+  s = m_device->createSemaphoreUnique(createInfo);
+  h = VKDPlatform::exportSemaphore(m_device.get(), s.get());
+  if(type == vk::SemaphoreType::eTimeline)
+  {
+    // GL_NV_timeline_semaphore: the type has to be set before the import
+    GLint semaphoreType = GL_SEMAPHORE_TYPE_TIMELINE_NV;
+    glCreateSemaphoresNV(1, &g);
+    glSemaphoreParameterivNV(g, GL_SEMAPHORE_TYPE_NV, &semaphoreType);
+  }
+  else
+  {
+    glGenSemaphoresEXT(1, &g);
+  }
+  VKDPlatform::importSemaphore(g, h);
+}
+
+void VKDirectDisplay::createInteropSemaphores(VKGLSyncData& s)
+{
+  createInteropSemaphore(vk::SemaphoreType::eBinary, s.m_available, s.m_availableHandle, s.m_availableGL);
+  createInteropSemaphore(vk::SemaphoreType::eBinary, s.m_finished, s.m_finishedHandle, s.m_finishedGL);
+}
+
+void VKDirectDisplay::createTimelineSemaphores()
+{
+  // both start at 0, all interop textures are available
+  if(m_transfer.isActive())
+  {
+    // GL uses VKDTransfer's, these only order the uploads from the staging ring and the blits
+    vk::SemaphoreTypeCreateInfo typeCreateInfo{ vk::SemaphoreType::eTimeline, 0 };
+    vk::SemaphoreCreateInfo     createInfo{};
+    createInfo.setPNext(&typeCreateInfo);
+    m_timeline.m_glDone = m_device->createSemaphoreUnique(createInfo);
+    m_timeline.m_vkDone = m_device->createSemaphoreUnique(createInfo);
+    return;
+  }
+  createInteropSemaphore(vk::SemaphoreType::eTimeline, m_timeline.m_glDone, m_timeline.m_glDoneHandle, m_timeline.m_glDoneGL);
+  createInteropSemaphore(vk::SemaphoreType::eTimeline, m_timeline.m_vkDone, m_timeline.m_vkDoneHandle, m_timeline.m_vkDoneGL);
+}
+
+void VKDirectDisplay::createSyncObjects()
 {
-  auto formats      = m_gpu.getSurfaceFormatsKHR(m_surface.get());
-  auto capabilities = m_gpu.getSurfaceCapabilitiesKHR(m_surface.get());
-  auto presentModes = m_gpu.getSurfacePresentModesKHR(m_surface.get());
+  if(m_native)
+  {
+    createNativeFrames();
+    return;
+  }
+  if(m_compositor)
+  {
+    createComposeFrames();
+    return;
+  }
 
-  // image count depending on capabilities
-  uint32_t imageCount = std::min(capabilities.maxImageCount, capabilities.minImageCount + 1);
+  if(m_syncMode == SyncMode::eTimeline)
+  {
+    createTimelineSemaphores();
+  }
 
-  // pick a preferred format or use the first available one
-  vk::SurfaceFormatKHR format{vk::Format::eB8G8R8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear};
-  bool                 valid = false;
-  if(formats.size() == 1 && formats[0].format == vk::Format::eUndefined)
+  // copy fast path: same format as the swapchain, otherwise RGBA8 and a format converting blit
+  // all outputs need the same format for it
+  vk::Format const swapchainFormat = m_outputs[0].format;
+  m_copyFastPath = m_requestedCopyFastPath && VKDPlatform::getGLFormat(swapchainFormat) != 0
+                   && std::all_of(m_outputs.begin(), m_outputs.end(), [&](const Output& o) { return o.format == swapchainFormat; });
+  m_interopFormat = m_copyFastPath ? swapchainFormat : vk::Format::eR8G8B8A8Unorm;
+  selectBlitQueue();
+  if(m_beamRacing.slices && needsOwnershipTransfer())
   {
-    valid = true;
+    // images coming back from another family have undefined contents, a late slice would show garbage
+    PRINTW("Beam racing needs a graphics queue that can present, disabling it\n");
+    m_beamRacing.slices = 0;
   }
-  for(auto& f : formats)
+  PRINTI("VKDirectDisplay: interop format {}, {}\n", vk::to_string(m_interopFormat), m_copyFastPath ? "copy" : "blit");
+
+  // Config::dynamicResolution: bilinear upscaling if the interop format can be filtered
+  bool const linear = bool(m_gpu.getFormatProperties(m_interopFormat).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+  m_scaleFilter     = linear ? vk::Filter::eLinear : vk::Filter::eNearest;
+  m_renderExtent    = m_interopExtent;
+
+  // GL has its own limit for the canvas texture, checked here with the context current
+  GLint maxTextureSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  if(m_interopExtent.width > uint32_t(maxTextureSize) || m_interopExtent.height > uint32_t(maxTextureSize))
   {
-    if(f == format)
-    {
-      valid = true;
-      break;
-    }
+    throw std::runtime_error(std::to_string(m_outputs.size()) + " displays side by side need a " + std::to_string(m_interopExtent.width)
+                             + " x " + std::to_string(m_interopExtent.height) + " canvas, GL supports at most "
+                             + std::to_string(maxTextureSize) + ", use fewer displays");
   }
-  if(!valid)
+
+  // we have to create our own textures for interop, swapchain images can't be used
+  m_syncData.resize(m_requestedFramesInFlight ? m_requestedFramesInFlight : getSwapchainImageCount());
+  if(m_transfer.isActive())
   {
-    format = formats[0];
+    createStagedImages();
+    return;
   }
-  
-  // use valid extent if available, otherwise derive from display mode
-  vk::Extent2D extent;
-  if(capabilities.currentExtent.width == 0xFFFFFFFF)
+  for(auto& s : m_syncData)
   {
-    extent        = m_display.modeProperties.parameters.visibleRegion;
+    createInteropImage(s, m_interopExtent);
+    s.m_renderExtent = m_interopExtent;
+  }
 
-    auto clamp = [](int val, int min, int max) { return (val < min) ? min : (val > max) ? max : val; };
-    extent.width  = clamp(extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
-    extent.height = clamp(extent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+  // one exported allocation for all of them, unless the driver wants dedicated ones
+  bool                        pooled = m_requestedPooledMemory;
+  vk::MemoryRequirements      poolRequirements{ 0, 1, ~0u };
+  std::vector<vk::DeviceSize> offsets;
+  for(auto& s : m_syncData)
+  {
+    auto const requirements = m_device->getImageMemoryRequirements(s.m_image.get());
+    offsets.push_back(VKDPlatform::alignUp(poolRequirements.size, requirements.alignment));
+    poolRequirements.size      = offsets.back() + requirements.size;
+    poolRequirements.alignment = std::max(poolRequirements.alignment, requirements.alignment);
+    poolRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+    pooled = pooled && !requiresDedicatedMemory(s.m_image.get());
   }
-  else
+  pooled = pooled && poolRequirements.memoryTypeBits != 0;
+  if(pooled)
   {
-    extent = capabilities.currentExtent;
+    allocateInteropMemory(poolRequirements, {}, m_interopMemory);
+    PRINTI("VKDirectDisplay: {} interop textures in one {} MB allocation\n", m_syncData.size(),
+           poolRequirements.size / (1024 * 1024));
   }
 
-  vk::SurfaceTransformFlagBitsKHR pretransform = vk::SurfaceTransformFlagBitsKHR::eIdentity;
-  if((pretransform & capabilities.supportedTransforms) != pretransform)
+  // all initial layout transitions go into one command buffer with a single wait
+  auto buf = createTmpCmdBuffer();
+  for(size_t i = 0; i < m_syncData.size(); ++i)
   {
-    pretransform = capabilities.currentTransform;
+    auto& s = m_syncData[i];
+    if(pooled)
+    {
+      createInteropTexture(buf, s, m_interopMemory, offsets[i], m_interopExtent);
+    }
+    else
+    {
+      auto const dedicated = requiresDedicatedMemory(s.m_image.get()) ? s.m_image.get() : vk::Image();
+      allocateInteropMemory(m_device->getImageMemoryRequirements(s.m_image.get()), dedicated, s.m_memory);
+      createInteropTexture(buf, s, s.m_memory, 0, m_interopExtent);
+    }
+    glCreateQueries(GL_TIMESTAMP, 2, s.m_timerQueries);
   }
+  submitTmpCmdBuffer(buf);
 
-  // pick a preferred present mode or use fallback
-  vk::PresentModeKHR presentMode = vk::PresentModeKHR::eFifo;
-  for(auto& m : presentModes)
+  if(m_syncMode == SyncMode::eTimeline)
   {
-    if(m == vk::PresentModeKHR::eMailbox)
+    if(m_export.isActive())
     {
-      presentMode = m;
+      createExportRing();
     }
+    return;
   }
 
-  // VK_KHR_display
-  // create swapchain using the ddisplay surface created before
-
-  vk::SwapchainCreateInfoKHR swapchainCreateInfo{vk::SwapchainCreateFlagsKHR(),
-                                                 m_surface.get(),
-                                                 imageCount,
-                                                 format.format,
-                                                 format.colorSpace,
-                                                 extent,
-                                                 1,
-                                                 vk::ImageUsageFlags(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst),
-                                                 vk::SharingMode::eExclusive,
-                                                 0,
-                                                 nullptr,
-                                                 pretransform,
-                                                 vk::CompositeAlphaFlagBitsKHR::eOpaque,
-                                                 presentMode,
-                                                 VK_TRUE};
-
-  m_swapchain       = m_device->createSwapchainKHRUnique(swapchainCreateInfo);
-  m_swapchainImages = m_device->getSwapchainImagesKHR(m_swapchain.get());
-  m_swapchainExtent = extent;
-  m_swapchainFormat = format.format;
+  // add semaphores to signal texture ready and render ready
+  std::vector<vk::Semaphore> available;
+  for(auto& s : m_syncData)
+  {
+    createInteropSemaphores(s);
+    available.push_back(s.m_available.get());
+  }
 
-  // don't need to transition swapchain images from eUndefined here
+  // signal the 'available' semaphores in one submit, the interop textures aren't in use yet
+  vk::SubmitInfo submitInfo{ {},{},{}, available };
+  m_blitQueue.submit(submitInfo);
 }
 
-uint32_t VKDirectDisplay::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties)
+void VKDirectDisplay::createExportRing()
 {
-  vk::PhysicalDeviceMemoryProperties memProperties = m_gpu.getMemoryProperties();
+  // Config::exportName: consumers read copies in images of their own, never the interop textures GL renders into
+  // and the blits read, so nothing a consumer does can race with either. the copies stay in eGeneral
+  if(m_syncData.size() > VKDExport::maxSlots)
+  {
+    PRINTW("VKDExport: more than {} interop textures, not exporting them\n", VKDExport::maxSlots);
+    m_export.clearRing();
+    return;
+  }
 
-  for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+  vk::ImageUsageFlags const usage{ vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled };
+  std::vector<vk::DeviceMemory>             memories;
+  std::vector<vk::DeviceSize>               sizes;
+  std::vector<VKDExport::Description::Slot> slots;
+  m_exportFrames.resize(m_syncData.size());
+  auto buf = createTmpCmdBuffer();
+  for(auto& e : m_exportFrames)
   {
-    if((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+    vk::ImageCreateInfo imageCreateInfo{ {}, vk::ImageType::e2D, m_interopFormat, vk::Extent3D(m_interopExtent, 1), 1, 1, vk::SampleCountFlagBits::e1,
+                                         vk::ImageTiling::eOptimal, usage, vk::SharingMode::eExclusive };
+    vk::ExternalMemoryImageCreateInfo externalMemoryImageCreateInfo{ VKDPlatform::memoryHandleType };
+    imageCreateInfo.setPNext(&externalMemoryImageCreateInfo);
+    e.m_image = m_device->createImageUnique(imageCreateInfo);
+
+    // exported to the consumers only, GL doesn't import it
+    auto const             requirements = m_device->getImageMemoryRequirements(e.m_image.get());
+    bool const             dedicated    = requiresDedicatedMemory(e.m_image.get());
+    vk::MemoryAllocateInfo memoryAllocateInfo{ requirements.size,
+                                               VKDPlatform::findMemoryType(m_gpu, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal) };
+    vk::ExportMemoryAllocateInfo    exportMemoryAllocateInfo{ VKDPlatform::memoryHandleType };
+    vk::MemoryDedicatedAllocateInfo dedicatedAllocateInfo{ e.m_image.get() };
+    memoryAllocateInfo.setPNext(&exportMemoryAllocateInfo);
+    if(dedicated)
     {
-      return i;
+      exportMemoryAllocateInfo.setPNext(&dedicatedAllocateInfo);
     }
+    e.m_memory = m_device->allocateMemoryUnique(memoryAllocateInfo);
+    m_device->bindImageMemory(e.m_image.get(), e.m_memory.get(), 0);
+    transitionImage(buf, e.m_image.get(), vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined,
+                    vk::ImageLayout::eGeneral, m_blitStage, vk::PipelineStageFlagBits::eTransfer);
+
+    slots.push_back({ uint32_t(memories.size()), dedicated ? 1u : 0u, 0 });
+    memories.push_back(e.m_memory.get());
+    sizes.push_back(requirements.size);
   }
-  throw std::runtime_error("failed to find suitable memory type!");
+  submitTmpCmdBuffer(buf);
+
+  // consumers get new handles of the copies' memory and of the semaphore that signals frame <value> was copied
+  VKDExport::Description description{};
+  description.format          = uint32_t(m_interopFormat);
+  description.width           = m_interopExtent.width;
+  description.height          = m_interopExtent.height;
+  description.usage           = uint32_t(VkImageUsageFlags(usage));
+  description.layout          = uint32_t(vk::ImageLayout::eGeneral);
+  description.upperLeftOrigin = isUpperLeftOrigin() ? 1 : 0;
+  m_export.setRing(m_device.get(), description, memories, sizes, slots, m_timeline.m_vkDone.get());
 }
 
-void VKDirectDisplay::createInteropTexture(VKGLSyncData& s)
+void VKDirectDisplay::createStagedImages()
 {
-  // create a VK texture and fill the GL interop data
+  // Config::crossDeviceTransfer: GL renders into VKDTransfer's textures on the render GPU,
+  // the blits read plain images on this device the frames are uploaded into
+  m_transfer.createFrames(uint32_t(m_syncData.size()), m_interopExtent, m_interopFormat, getTexelSize(m_interopFormat));
 
-  // vk image, hint we want to export this memory (eOpaqueWin32)
-  vk::ImageCreateInfo imageCreateInfo = {vk::ImageCreateFlags(),
+  auto buf = createTmpCmdBuffer();
+  for(uint32_t i = 0; i < m_syncData.size(); ++i)
+  {
+    auto&               s = m_syncData[i];
+    vk::ImageCreateInfo imageCreateInfo{ {},
                                          vk::ImageType::e2D,
-                                         vk::Format::eR8G8B8A8Unorm,
-                                         vk::Extent3D(m_swapchainExtent, 1),
+                                         m_interopFormat,
+                                         vk::Extent3D(m_interopExtent, 1),
                                          1,
                                          1,
                                          vk::SampleCountFlagBits::e1,
                                          vk::ImageTiling::eOptimal,
-                                         vk::ImageUsageFlags(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc),
+                                         vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
                                          vk::SharingMode::eExclusive,
                                          0,
                                          nullptr,
-                                         vk::ImageLayout::eUndefined};
-  vk::ExternalMemoryImageCreateInfo externalMemoryImageCreateInfo = { vk::ExternalMemoryHandleTypeFlagBits::eOpaqueWin32 };
-  imageCreateInfo.setPNext(&externalMemoryImageCreateInfo);
-  s.m_image = m_device->createImageUnique(imageCreateInfo);
-
-  vk::MemoryRequirements memoryRequirements = m_device->getImageMemoryRequirements(s.m_image.get());
-  vk::MemoryAllocateInfo memoryAllocateInfo{memoryRequirements.size,
-                                            findMemoryType(memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlags())};
-
-  // vk memory, also hint we want to export it
-  vk::ExportMemoryAllocateInfo exportMemoryAllocateInfo(vk::ExternalMemoryHandleTypeFlagBits::eOpaqueWin32);
-  memoryAllocateInfo.setPNext(&exportMemoryAllocateInfo);
+                                         vk::ImageLayout::eUndefined };
+    s.m_image = m_device->createImageUnique(imageCreateInfo);
 
-  vk::MemoryPriorityAllocateInfoEXT memoryPriorityAllocateInfo(1.0f);
-  exportMemoryAllocateInfo.setPNext(&memoryPriorityAllocateInfo);
+    auto const requirements   = m_device->getImageMemoryRequirements(s.m_image.get());
+    s.m_memory.m_deviceMemory = m_device->allocateMemoryUnique(
+        { requirements.size, VKDPlatform::findMemoryType(m_gpu, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal) });
+    s.m_memory.m_size = requirements.size;
+    m_device->bindImageMemory(s.m_image.get(), s.m_memory.m_deviceMemory.get(), 0);
 
-  s.m_deviceMemory = m_device->allocateMemoryUnique(memoryAllocateInfo);
+    // same layout as an interop image GL is done with
+    transitionImage(buf, s.m_image.get(), vk::AccessFlagBits::eNone, m_interopAccess, vk::ImageLayout::eUndefined,
+                    vk::ImageLayout::eColorAttachmentOptimal, m_blitStage, m_blitStage);
 
-  m_device->bindImageMemory(s.m_image.get(), s.m_deviceMemory.get(), 0);
-
-  // transition image from eUndefined to vColorAttachmentOptimal
-  auto buf = createTmpCmdBuffer();
-  transitionImage(buf, s.m_image.get(),
-    vk::AccessFlagBits::eNone,
-    vk::AccessFlagBits::eColorAttachmentWrite,
-    vk::ImageLayout::eUndefined,
-    vk::ImageLayout::eColorAttachmentOptimal,
-    vk::PipelineStageFlagBits::eColorAttachmentOutput,
-    vk::PipelineStageFlagBits::eColorAttachmentOutput
-  );
+    s.m_textureGL    = m_transfer.getTexture(i);
+    s.m_renderExtent = m_interopExtent;
+    glCreateQueries(GL_TIMESTAMP, 2, s.m_timerQueries);
+  }
   submitTmpCmdBuffer(buf);
+  PRINTI("VKDirectDisplay: {} interop textures on the render GPU, {}\n", m_syncData.size(),
+         m_transfer.isZeroCopy() ? "staged in shared host memory" : "staged with a host copy");
+}
 
-  // create OpenGL interop data
-  vk::MemoryGetWin32HandleInfoKHR getHandleInfo{ s.m_deviceMemory.get(), vk::ExternalMemoryHandleTypeFlagBits::eOpaqueWin32 };
-  s.m_handle = m_device->getMemoryWin32HandleKHR(getHandleInfo);
-
-  glCreateMemoryObjectsEXT(1, &s.m_memoryObject);
-  glImportMemoryWin32HandleEXT(s.m_memoryObject, memoryRequirements.size, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, s.m_handle);
-
-  glCreateTextures(GL_TEXTURE_2D, 1, &s.m_textureGL);
-  glTextureStorageMem2DEXT(s.m_textureGL, 1, GL_RGBA8, m_swapchainExtent.width, m_swapchainExtent.height, s.m_memoryObject, 0);
+void VKDirectDisplay::createNativeFrames()
+{
+  // no interop textures, VK renders on the graphics queue straight into the swapchain images
+  m_copyFastPath = false;
+  selectBlitQueue();
+  m_nativeFrames = m_requestedFramesInFlight ? m_requestedFramesInFlight : getSwapchainImageCount();
+  m_renderer.setFramesInFlight(m_nativeFrames);
+  PRINTI("VKDirectDisplay: native renderer, {} frames in flight\n", m_nativeFrames);
+}
 
-  GLint internalFormat;
-  glGetTextureLevelParameteriv(s.m_textureGL, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+void VKDirectDisplay::createComposeFrames()
+{
+  // no canvas sized interop textures, the compositor blits the layers straight into the swapchain images
+  m_copyFastPath  = false;
+  m_interopFormat = vk::Format::eR8G8B8A8Unorm;
+  selectBlitQueue();
+  bool const linear = bool(m_gpu.getFormatProperties(m_interopFormat).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+  m_scaleFilter     = linear ? vk::Filter::eLinear : vk::Filter::eNearest;
+  m_renderExtent    = m_interopExtent;
+  m_composeFrames   = m_requestedFramesInFlight ? m_requestedFramesInFlight : getSwapchainImageCount();
+  PRINTI("VKDirectDisplay: compositor, {} frames in flight\n", m_composeFrames);
 }
 
-void VKDirectDisplay::createInteropSemaphores(VKGLSyncData& s)
+void VKDirectDisplay::createLayers()
 {
-  // create VK semaphores and fill the GL interop data
-  vk::SemaphoreCreateInfo       createInfo{};
-  vk::ExportSemaphoreCreateInfo exportCreateInfo{vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueWin32};
-  createInfo.setPNext(&exportCreateInfo);
+  // Config::layerCount: a ring of interop textures and a pair of timeline semaphores per producer
+  // independent of the swapchain, they survive recover() and setFrameCounts()
+  uint32_t const count  = m_config.layerCount;
+  uint32_t const frames = std::max(m_config.layerFrames, 2u);
+  m_layers.resize(count);
 
-  auto makeSemaphore = [&](vk::UniqueSemaphore& s, HANDLE& h, GLuint& g) {
-    s = m_device->createSemaphoreUnique(createInfo);
-    vk::SemaphoreGetWin32HandleInfoKHR getHandleInfo( s.get(), vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueWin32 );
+  auto buf = createTmpCmdBuffer();
+  for(uint32_t i = 0; i < count; ++i)
+  {
+    auto& l = m_layers[i];
+    if(i < m_config.layerRects.size())
+    {
+      l.rect = m_config.layerRects[i];
+    }
+    else
+    {
+      uint32_t const left  = i * m_interopExtent.width / count;
+      uint32_t const right = (i + 1) * m_interopExtent.width / count;
+      l.rect               = vk::Rect2D{ { int32_t(left), 0 }, { right - left, m_interopExtent.height } };
+    }
+    l.extent = l.rect.extent;
+    if(!l.extent.width || !l.extent.height)
+    {
+      throw std::runtime_error("compositor layer without pixels");
+    }
 
-    h = m_device->getSemaphoreWin32HandleKHR(getHandleInfo);
-    glGenSemaphoresEXT(1, &g);
-    glImportSemaphoreWin32HandleEXT(g, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, h);
-  };
+    l.frames.resize(frames);
+    for(auto& f : l.frames)
+    {
+      createInteropImage(f, l.extent);
+      auto const dedicated = requiresDedicatedMemory(f.m_image.get()) ? f.m_image.get() : vk::Image();
+      allocateInteropMemory(m_device->getImageMemoryRequirements(f.m_image.get()), dedicated, f.m_memory);
+      createInteropTexture(buf, f, f.m_memory, 0, l.extent);
+    }
+    createInteropSemaphore(vk::SemaphoreType::eTimeline, l.timeline.m_glDone, l.timeline.m_glDoneHandle, l.timeline.m_glDoneGL);
+    createInteropSemaphore(vk::SemaphoreType::eTimeline, l.timeline.m_vkDone, l.timeline.m_vkDoneHandle, l.timeline.m_vkDoneGL);
+    PRINTI("VKDirectDisplay: layer {}, {} x {} at {}, {}, {} interop textures\n", i, l.extent.width, l.extent.height, l.rect.offset.x,
+           l.rect.offset.y, frames);
+  }
+  submitTmpCmdBuffer(buf);
+}
 
-  makeSemaphore(s.m_available, s.m_availableHandle, s.m_availableGL);
-  makeSemaphore(s.m_finished, s.m_finishedHandle, s.m_finishedGL);
+void VKDirectDisplay::releaseLayers()
+{
+  // GL waits queued by getLayerTexture() are only satisfied by compositions, there won't be any before glFinish()
+  // the compositor's submits never wait on GL, so VK can go idle first and nothing signals behind the host
+  if(m_layers.empty())
+  {
+    return;
+  }
+  m_device->waitIdle();
+  for(auto& l : m_layers)
+  {
+    if(l.timeline.m_value > l.released)
+    {
+      m_device->signalSemaphoreKHR({ l.timeline.m_vkDone.get(), l.timeline.m_value });
+      l.released = l.timeline.m_value;
+    }
+  }
 }
 
-void VKDirectDisplay::createSyncObjects()
+void VKDirectDisplay::destroyLayers()
+{
+  // the producers have to be done with them
+  for(auto& l : m_layers)
+  {
+    for(auto& f : l.frames)
+    {
+      glDeleteTextures(1, &f.m_textureGL);
+      f.m_image.reset();
+      destroyInteropMemory(f.m_memory);
+    }
+    deleteInteropSemaphore(l.timeline.m_glDoneGL, l.timeline.m_glDoneHandle);
+    deleteInteropSemaphore(l.timeline.m_vkDoneGL, l.timeline.m_vkDoneHandle);
+  }
+  m_layers.clear();
+}
+
+void VKDirectDisplay::destroySyncObjects()
 {
-  m_syncData.resize(m_swapchainImages.size());
+  // VK objects are unique handles, GL objects and the exported handles need to be released explicitly
+  // Config::exportName: consumers let go of the interop textures first
+  if(m_export.isActive())
+  {
+    m_export.clearRing();
+  }
+  m_exportFrames.clear();
   for(auto& s : m_syncData)
   {
-    // we have to create our own textures for interop, swapchain images can't be used
-    createInteropTexture(s);
+    if(!m_transfer.isActive())
+    {
+      glDeleteTextures(1, &s.m_textureGL);
+    }
+    s.m_image.reset();
+    destroyInteropMemory(s.m_memory);
+    deleteInteropSemaphore(s.m_availableGL, s.m_availableHandle);
+    deleteInteropSemaphore(s.m_finishedGL, s.m_finishedHandle);
+    glDeleteQueries(2, s.m_timerQueries);
+  }
+  m_syncData.clear();
+  destroyInteropMemory(m_interopMemory);
+  m_transfer.destroyFrames();
 
-    // add semaphores to signal texture ready and render ready
-    createInteropSemaphores(s);
+  deleteInteropSemaphore(m_timeline.m_glDoneGL, m_timeline.m_glDoneHandle);
+  deleteInteropSemaphore(m_timeline.m_vkDoneGL, m_timeline.m_vkDoneHandle);
+  m_timeline = TimelineSync();
 
-    // signal the 'available' semaphore, the interop textures aren't in use yet
-    vk::SubmitInfo submitInfo{ {},{},{}, s.m_available.get() };
-    m_presentQueue.submit(submitInfo);
-  }
+  freeBlitCommandBuffers();
 }
 
 void VKDirectDisplay::createSyncs()
 {
+  // acquire semaphores are recycled per swapchain image, see acquireImages(), blit semaphores are per swapchain image they are presented with
+  // each output has its own set
   vk::SemaphoreCreateInfo semaphoreCreateInfo{};
-  m_imageAcquiredSemaphores.resize(m_swapchainImages.size());
-  for(auto& s : m_imageAcquiredSemaphores)
+  for(auto& o : m_outputs)
   {
-    s = m_device->createSemaphoreUnique(semaphoreCreateInfo);
-  }
+    o.acquireSemaphores.resize(o.images.size() + getFramesInFlight());
+    o.freeAcquireSemaphores.clear();
+    for(auto& s : o.acquireSemaphores)
+    {
+      s = m_device->createSemaphoreUnique(semaphoreCreateInfo);
+      o.freeAcquireSemaphores.push_back(s.get());
+    }
+    o.imageAcquireSemaphores.assign(o.images.size(), vk::Semaphore());
 
-  m_blitFinishedSemaphores.resize(m_swapchainImages.size());
-  for(auto& s : m_blitFinishedSemaphores)
-  {
-    s = m_device->createSemaphoreUnique(semaphoreCreateInfo);
+    o.blitFinishedSemaphores.resize(o.images.size());
+    for(auto& s : o.blitFinishedSemaphores)
+    {
+      s = m_device->createSemaphoreUnique(semaphoreCreateInfo);
+    }
+
+    o.ownedSemaphores.resize(needsOwnershipTransfer() ? o.images.size() : 0);
+    for(auto& s : o.ownedSemaphores)
+    {
+      s = m_device->createSemaphoreUnique(semaphoreCreateInfo);
+    }
+
+    o.synthAcquired.reset();
+    if(m_frameSynthesis)
+    {
+      o.synthAcquired = m_device->createSemaphoreUnique(semaphoreCreateInfo);
+    }
+
+    // a slice's acquire is waited on by its blit, the next frame with the same texture reuses it
+    o.sliceAcquired.resize(getFramesInFlight() * m_beamRacing.slices);
+    for(auto& s : o.sliceAcquired)
+    {
+      s = m_device->createSemaphoreUnique(semaphoreCreateInfo);
+    }
   }
 
   vk::FenceCreateInfo fenceCreateInfo{};
   fenceCreateInfo.setFlags(vk::FenceCreateFlagBits::eSignaled);
-  m_fences.resize(m_swapchainImages.size());
+  m_fences.resize(usesFences() ? getFramesInFlight() : 0);
   for (auto& f : m_fences)
   {
     f = m_device->createFenceUnique(fenceCreateInfo);
   }
+  m_synthFence.reset();
+  if(m_frameSynthesis)
+  {
+    m_synthFence = m_device->createFenceUnique(fenceCreateInfo);
+  }
 }
 
 void VKDirectDisplay::createCommandBuffers()
 {
-  vk::CommandBufferAllocateInfo commandBufferAllocateInfo = {m_commandPool.get(), vk::CommandBufferLevel::ePrimary,
-                                                             uint32_t(m_swapchainImages.size())};
-
-  m_blitCommandBuffers = m_device->allocateCommandBuffers(commandBufferAllocateInfo);
-
-  for (auto i = 0; i < m_swapchainImages.size(); ++i)
-  {
-    auto& swapImg = m_swapchainImages[i];
-    auto& syncImg = m_syncData[i].m_image.get();
-    auto& buf = m_blitCommandBuffers[i];
-
-    vk::CommandBufferBeginInfo commandBufferBeginInfo {};
-    buf.begin(commandBufferBeginInfo);
-
-    transitionImage(
-      buf, swapImg,
-      vk::AccessFlagBits::eMemoryRead,
-      vk::AccessFlagBits::eTransferWrite,
-      vk::ImageLayout::eUndefined,        // we'll blit to it, no interest in contents
-      vk::ImageLayout::eTransferDstOptimal,
-      vk::PipelineStageFlagBits::eColorAttachmentOutput,
-      vk::PipelineStageFlagBits::eTransfer
-    );
-
-    transitionImage(
-      buf, syncImg,
-      vk::AccessFlagBits::eColorAttachmentWrite,
-      vk::AccessFlagBits::eTransferRead,
-      vk::ImageLayout::eColorAttachmentOptimal,
-      vk::ImageLayout::eTransferSrcOptimal,
-      vk::PipelineStageFlagBits::eColorAttachmentOutput,
-      vk::PipelineStageFlagBits::eTransfer
-    );
-
-    // dstOffsets are flipped because GL is flipped vs VK
-    std::array<vk::Offset3D, 2> srcoffsets{ vk::Offset3D{ 0,0,0 }, vk::Offset3D{ int32_t(m_swapchainExtent.width), int32_t(m_swapchainExtent.height), 1 } };
-    std::array<vk::Offset3D, 2> dstoffsets{ vk::Offset3D{ 0,int32_t(m_swapchainExtent.height),0 }, vk::Offset3D{ int32_t(m_swapchainExtent.width), 0, 1 } };
-    vk::ImageSubresourceLayers layers{ vk::ImageAspectFlags{vk::ImageAspectFlagBits::eColor}, 0, 0, 1 };
+  // per output one blit command buffer per (interop texture, swapchain image) combination
+  // none for the native renderer, it records its command buffers per frame
+  uint32_t const numInterop = uint32_t(m_syncData.size());
+  uint32_t       numPairs   = 0;
+  for(auto& o : m_outputs)
+  {
+    uint32_t const numSwap = uint32_t(o.images.size());
+
+    if(numInterop)
+    {
+      vk::CommandBufferAllocateInfo commandBufferAllocateInfo = {m_blitPool, vk::CommandBufferLevel::ePrimary,
+                                                                 numInterop * numSwap};
+
+      o.blitCommandBuffers = m_device->allocateCommandBuffers(commandBufferAllocateInfo);
+      o.blitSources.resize(o.blitCommandBuffers.size());
+    }
+    if(numInterop && m_frameSynthesis)
+    {
+      o.synthCommandBuffer = m_device->allocateCommandBuffers({ m_blitPool, vk::CommandBufferLevel::ePrimary, 1 })[0];
+    }
+    if(numInterop && m_beamRacing.slices)
+    {
+      o.sliceCommandBuffers = m_device->allocateCommandBuffers({ m_blitPool, vk::CommandBufferLevel::ePrimary, numInterop * numSwap * m_beamRacing.slices });
+      o.sliceInitCommandBuffers = m_device->allocateCommandBuffers({ m_blitPool, vk::CommandBufferLevel::ePrimary, numSwap });
+      o.sliceInitialized.assign(numSwap, false);
+      for(uint32_t j = 0; j < numSwap; ++j)
+      {
+        auto buf = o.sliceInitCommandBuffers[j];
+        buf.begin(vk::CommandBufferBeginInfo{});
+        // same stages as the slice's own transition, so they chain after the acquire
+        transitionImage(buf, o.images[j], vk::AccessFlagBits::eNone, vk::AccessFlagBits::eNone, vk::ImageLayout::eUndefined,
+                        vk::ImageLayout::ePresentSrcKHR, m_blitStage, m_blitStage);
+        buf.end();
+      }
+    }
+    o.queryBase = numPairs;
+    numPairs += numInterop * numSwap;
+
+    if(needsOwnershipTransfer())
+    {
+      // acquire half of the release at the end of the blits or the native render pass, layouts have to match
+      vk::CommandBufferAllocateInfo ownershipAllocateInfo = {m_presentPool.get(), vk::CommandBufferLevel::ePrimary, numSwap};
+      o.ownershipCommandBuffers = m_device->allocateCommandBuffers(ownershipAllocateInfo);
+      for(uint32_t j = 0; j < numSwap; ++j)
+      {
+        auto buf = o.ownershipCommandBuffers[j];
+        buf.begin(vk::CommandBufferBeginInfo{});
+        transitionImage(buf, o.images[j], vk::AccessFlagBits::eNone, vk::AccessFlagBits::eNone,
+                        m_native ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::eTransferDstOptimal,
+                        vk::ImageLayout::ePresentSrcKHR,
+                        vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eBottomOfPipe, m_blitFamily, m_presentFamily);
+        buf.end();
+      }
+    }
+  }
+
+  // two timestamps per blit command buffer
+  m_timestampPool.reset();
+  if(m_timestampPeriod > 0.0f && numPairs)
+  {
+    vk::QueryPoolCreateInfo queryPoolCreateInfo{ {}, vk::QueryType::eTimestamp, numPairs * 2 };
+    m_timestampPool = m_device->createQueryPoolUnique(queryPoolCreateInfo);
+  }
+
+  for(uint32_t o = 0; o < m_outputs.size(); ++o)
+  {
+    auto const& output = m_outputs[o];
+    for(uint32_t i = 0; i < numInterop; ++i)
+    {
+      for(uint32_t j = 0; j < output.images.size(); ++j)
+      {
+        Acquired const a{ o, j };
+        vk::Extent2D const source = m_syncData[i].m_renderExtent;
+        recordBlitCommandBuffer(getBlitCommandBuffer(a, i), output, m_syncData[i].m_image.get(), output.images[j],
+                                getBlitQueryPair(a, i) * 2, source);
+        m_outputs[o].blitSources[i * output.images.size() + j] = source;
+
+        // Config::beamRacingSlices: the slice's rows and the previous slice's, the tear lands somewhere in those
+        for(uint32_t k = 0; k < m_beamRacing.slices; ++k)
+        {
+          recordSliceCommandBuffer(output.sliceCommandBuffers[(i * output.images.size() + j) * m_beamRacing.slices + k], output,
+                                   m_syncData[i].m_image.get(), output.images[j], getSliceTop(k ? k - 1 : 0), getSliceTop(k + 1));
+        }
+      }
+    }
+  }
+
+  // Config::crossDeviceTransfer: staging slot to image, ending in the layout the blits expect
+  if(m_transfer.isActive())
+  {
+    m_uploadCommandBuffers = m_device->allocateCommandBuffers({ m_blitPool, vk::CommandBufferLevel::ePrimary, numInterop });
+    for(uint32_t i = 0; i < numInterop; ++i)
+    {
+      auto                      buf = m_uploadCommandBuffers[i];
+      auto                      img = m_syncData[i].m_image.get();
+      vk::BufferImageCopy const region{ 0, 0, 0, { vk::ImageAspectFlagBits::eColor, 0, 0, 1 }, {}, vk::Extent3D(m_interopExtent, 1) };
+      buf.begin(vk::CommandBufferBeginInfo{});
+      transitionImage(buf, img, vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eColorAttachmentOptimal,
+                      vk::ImageLayout::eTransferDstOptimal, m_blitStage, vk::PipelineStageFlagBits::eTransfer);
+      buf.copyBufferToImage(m_transfer.getStagingBuffer(i), img, vk::ImageLayout::eTransferDstOptimal, region);
+      transitionImage(buf, img, vk::AccessFlagBits::eTransferWrite, m_interopAccess, vk::ImageLayout::eTransferDstOptimal,
+                      vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eTransfer, m_blitStage);
+      buf.end();
+    }
+  }
+
+  // Config::exportName: interop texture to its export frame, submitted along with the frame's blits
+  if(!m_exportFrames.empty())
+  {
+    m_exportCommandBuffers = m_device->allocateCommandBuffers({ m_blitPool, vk::CommandBufferLevel::ePrimary, numInterop });
+    for(uint32_t i = 0; i < numInterop; ++i)
+    {
+      auto                      buf    = m_exportCommandBuffers[i];
+      auto                      img    = m_syncData[i].m_image.get();
+      auto                      copy   = m_exportFrames[i].m_image.get();
+      vk::ImageSubresourceLayers layers{ vk::ImageAspectFlagBits::eColor, 0, 0, 1 };
+      vk::ImageCopy const       region{ layers, {}, layers, {}, vk::Extent3D(m_interopExtent, 1) };
+      buf.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eSimultaneousUse });
+      transitionImage(buf, img, m_interopAccess, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eColorAttachmentOptimal,
+                      vk::ImageLayout::eTransferSrcOptimal, m_blitStage, vk::PipelineStageFlagBits::eTransfer);
+      // behind the previous copy into it, consumers are never waited for
+      transitionImage(buf, copy, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eGeneral,
+                      vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer);
+      buf.copyImage(img, vk::ImageLayout::eTransferSrcOptimal, copy, vk::ImageLayout::eGeneral, region);
+      transitionImage(buf, img, vk::AccessFlagBits::eTransferRead, m_interopAccess, vk::ImageLayout::eTransferSrcOptimal,
+                      vk::ImageLayout::eColorAttachmentOptimal, vk::PipelineStageFlagBits::eTransfer, m_blitStage);
+      buf.end();
+    }
+  }
+
+  // Config::layerCount: recorded per frame, the layers' newest frames change
+  if(m_compositor)
+  {
+    m_composeCommandBuffers = m_device->allocateCommandBuffers({ m_blitPool, vk::CommandBufferLevel::ePrimary, m_composeFrames });
+  }
+
+  if(m_native)
+  {
+    // the renderer's framebuffers reference the swapchain images, the outputs share the canvas like the interop textures
+    std::vector<VKDRenderer::Target> targets;
+    for(const auto& o : m_outputs)
+    {
+      targets.push_back({ o.images, o.format, o.extent, o.offset });
+    }
+    m_renderer.setTargets(targets, m_interopExtent, needsOwnershipTransfer() ? m_presentFamily : VK_QUEUE_FAMILY_IGNORED);
+  }
+}
+
+vk::CommandBuffer VKDirectDisplay::getBlitCommandBuffer(const Acquired& a, uint32_t interopIndex)
+{
+  auto const& o = m_outputs[a.output];
+  return o.blitCommandBuffers[interopIndex * o.images.size() + a.image];
+}
+
+vk::CommandBuffer VKDirectDisplay::prepareBlitCommandBuffer(const Acquired& a, uint32_t interopIndex)
+{
+  // Config::dynamicResolution: re-record if the texture was rendered at another extent than the blit was recorded for
+  // its previous submit has to be complete, the fence paths' waitReleased() waited for the last use of the interop texture,
+  // SyncMode::eTimeline waits here, only when the extent changed
+  auto&              o      = m_outputs[a.output];
+  size_t const       index  = interopIndex * o.images.size() + a.image;
+  vk::Extent2D const source = m_syncData[interopIndex].m_renderExtent;
+  if(o.blitSources[index] != source)
+  {
+    if(!usesFences() && !waitReleased(interopIndex))
+    {
+      throw std::runtime_error("interop texture not released by Vulkan");
+    }
+    o.blitCommandBuffers[index].reset();
+    recordBlitCommandBuffer(o.blitCommandBuffers[index], o, m_syncData[interopIndex].m_image.get(), o.images[a.image],
+                            getBlitQueryPair(a, interopIndex) * 2, source);
+    o.blitSources[index] = source;
+  }
+  return o.blitCommandBuffers[index];
+}
+
+uint32_t VKDirectDisplay::getBlitQueryPair(const Acquired& a, uint32_t interopIndex) const
+{
+  auto const& o = m_outputs[a.output];
+  return o.queryBase + interopIndex * uint32_t(o.images.size()) + a.image;
+}
+
+void VKDirectDisplay::recordBlitCommandBuffer(vk::CommandBuffer buf, const Output& o, vk::Image syncImg, vk::Image swapImg, uint32_t queryIndex, vk::Extent2D source,
+                                              vk::Offset2D shift)
+{
+  // SyncMode::eTimeline submits it again without waiting for the previous submit on the host, the GL wait orders them on the GPU
+  vk::CommandBufferBeginInfo commandBufferBeginInfo { vk::CommandBufferUsageFlagBits::eSimultaneousUse };
+  buf.begin(commandBufferBeginInfo);
+
+  bool const timestamps = m_timestampPool && queryIndex != ~0u;
+  if(timestamps)
+  {
+    buf.resetQueryPool(m_timestampPool.get(), queryIndex, 2);
+    buf.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_timestampPool.get(), queryIndex);
+  }
+
+  transitionImage(
+    buf, swapImg,
+    vk::AccessFlagBits::eMemoryRead,
+    vk::AccessFlagBits::eTransferWrite,
+    vk::ImageLayout::eUndefined,        // we'll blit to it, no interest in contents
+    vk::ImageLayout::eTransferDstOptimal,
+    m_blitStage,
+    vk::PipelineStageFlagBits::eTransfer
+  );
+
+  transitionImage(
+    buf, syncImg,
+    m_interopAccess,
+    vk::AccessFlagBits::eTransferRead,
+    vk::ImageLayout::eColorAttachmentOptimal,
+    vk::ImageLayout::eTransferSrcOptimal,
+    m_blitStage,
+    vk::PipelineStageFlagBits::eTransfer
+  );
+
+  vk::ImageSubresourceLayers layers{ vk::ImageAspectFlags{vk::ImageAspectFlagBits::eColor}, 0, 0, 1 };
+  bool const                 scaled  = source != m_interopExtent;
+  bool const                 shifted = shift != vk::Offset2D();
+  if(shifted)
+  {
+    // Config::reprojection: the part the shifted image doesn't cover stays black
+    vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+    buf.clearColorImage(swapImg, vk::ImageLayout::eTransferDstOptimal, vk::ClearColorValue(std::array<float, 4>{ 0.0f, 0.0f, 0.0f, 1.0f }), range);
+    transitionImage(buf, swapImg, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eTransferDstOptimal,
+                    vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer);
+  }
+  if(m_copyFastPath && m_interopFormat == o.format && !scaled && !shifted)
+  {
+    // same format and GL rendered upside down, plain copy of the output's region
+    vk::ImageCopy region{ layers, vk::Offset3D{ o.offset.x, o.offset.y, 0 }, layers, vk::Offset3D{ 0,0,0 }, vk::Extent3D(o.extent, 1) };
+    buf.copyImage(syncImg, vk::ImageLayout::eTransferSrcOptimal, swapImg, vk::ImageLayout::eTransferDstOptimal, region);
+  }
+  else
+  {
+    // the output's region, scaled to the part GL rendered into (Config::dynamicResolution)
+    float const   sx     = float(source.width) / float(m_interopExtent.width);
+    float const   sy     = float(source.height) / float(m_interopExtent.height);
+    int32_t const x0     = int32_t(float(o.offset.x) * sx + 0.5f);
+    int32_t const x1     = int32_t(float(o.offset.x + int32_t(o.extent.width)) * sx + 0.5f);
+    int32_t const top    = int32_t(float(o.offset.y) * sy + 0.5f);
+    int32_t const bottom = int32_t(float(o.offset.y + int32_t(o.extent.height)) * sy + 0.5f);
+
+    std::array<vk::Offset3D, 2> srcoffsets;
+    std::array<vk::Offset3D, 2> dstoffsets;
+    if(m_copyFastPath)
+    {
+      // GL rendered upside down, only scale
+      srcoffsets = { vk::Offset3D{ x0, top, 0 }, vk::Offset3D{ x1, bottom, 1 } };
+      dstoffsets = { vk::Offset3D{ 0, 0, 0 }, vk::Offset3D{ int32_t(o.extent.width), int32_t(o.extent.height), 1 } };
+    }
+    else
+    {
+      // dstOffsets are flipped because GL is flipped vs VK
+      // the output's region is at the top of the rendered part, which is its end in GL
+      int32_t const height = int32_t(source.height);
+      srcoffsets = { vk::Offset3D{ x0, height - bottom, 0 }, vk::Offset3D{ x1, height - top, 1 } };
+      dstoffsets = { vk::Offset3D{ 0, int32_t(o.extent.height), 0 }, vk::Offset3D{ int32_t(o.extent.width), 0, 1 } };
+    }
+    if(shifted && !clipBlit(srcoffsets, dstoffsets, shift, o.extent))
+    {
+      // moved out of view entirely
+      srcoffsets = {};
+      dstoffsets = {};
+    }
     vk::ImageBlit region {
       layers, srcoffsets,
       layers, dstoffsets
     };
-    std::vector<vk::ImageBlit> regions = { region };
-    buf.blitImage(syncImg, vk::ImageLayout::eTransferSrcOptimal, swapImg, vk::ImageLayout::eTransferDstOptimal, vk::ArrayProxy<const vk::ImageBlit>{ 1, &region }, vk::Filter::eNearest);
-    
-    transitionImage(
-      buf, swapImg,
-      vk::AccessFlagBits::eTransferWrite,
-      vk::AccessFlagBits::eNone,
-      vk::ImageLayout::eTransferDstOptimal, 
-      vk::ImageLayout::ePresentSrcKHR,
-      vk::PipelineStageFlagBits::eTransfer,
-      vk::PipelineStageFlagBits::eBottomOfPipe
-    );
-
-    transitionImage(
-      buf, syncImg,
-      vk::AccessFlagBits::eTransferRead,
-      vk::AccessFlagBits::eColorAttachmentWrite,
-      vk::ImageLayout::eTransferSrcOptimal,
-      vk::ImageLayout::eColorAttachmentOptimal,
-      vk::PipelineStageFlagBits::eTransfer,
-      vk::PipelineStageFlagBits::eColorAttachmentOutput
-    );
-    
-    buf.end();
+    if(dstoffsets[0] != dstoffsets[1])
+    {
+      buf.blitImage(syncImg, vk::ImageLayout::eTransferSrcOptimal, swapImg, vk::ImageLayout::eTransferDstOptimal, vk::ArrayProxy<const vk::ImageBlit>{ 1, &region },
+                    scaled || shifted ? m_scaleFilter : vk::Filter::eNearest);
+    }
+  }
+  
+  transitionImage(
+    buf, swapImg,
+    vk::AccessFlagBits::eTransferWrite,
+    vk::AccessFlagBits::eNone,
+    vk::ImageLayout::eTransferDstOptimal, 
+    vk::ImageLayout::ePresentSrcKHR,
+    vk::PipelineStageFlagBits::eTransfer,
+    vk::PipelineStageFlagBits::eBottomOfPipe,
+    // release to the present family, see submitOwnershipTransfer()
+    needsOwnershipTransfer() ? m_blitFamily : VK_QUEUE_FAMILY_IGNORED,
+    needsOwnershipTransfer() ? m_presentFamily : VK_QUEUE_FAMILY_IGNORED
+  );
+
+  transitionImage(
+    buf, syncImg,
+    vk::AccessFlagBits::eTransferRead,
+    m_interopAccess,
+    vk::ImageLayout::eTransferSrcOptimal,
+    vk::ImageLayout::eColorAttachmentOptimal,
+    vk::PipelineStageFlagBits::eTransfer,
+    m_blitStage
+  );
+
+  if(timestamps)
+  {
+    buf.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_timestampPool.get(), queryIndex + 1);
   }
+  
+  buf.end();
 }
 
 vk::CommandBuffer VKDirectDisplay::createTmpCmdBuffer()
 {
-  vk::CommandBufferAllocateInfo allocInfo{ m_commandPool.get(), vk::CommandBufferLevel::ePrimary, 1};
+  vk::CommandBufferAllocateInfo allocInfo{ m_blitPool, vk::CommandBufferLevel::ePrimary, 1};
   vk::CommandBuffer buf;
   buf = m_device->allocateCommandBuffers(allocInfo)[0];
 
@@ -722,14 +4120,17 @@ void VKDirectDisplay::submitTmpCmdBuffer(vk::CommandBuffer buf)
 
   vk::SubmitInfo submitInfo{ {},{},buf };
   
-  m_presentQueue.submit(submitInfo);
-  m_presentQueue.waitIdle();
-  m_device->freeCommandBuffers(m_commandPool.get(), buf);
+  m_blitQueue.submit(submitInfo);
+  m_blitQueue.waitIdle();
+  m_device->freeCommandBuffers(m_blitPool, buf);
 }
 
-void VKDirectDisplay::transitionImage(vk::CommandBuffer buf, vk::Image img, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlagBits srcStage, vk::PipelineStageFlags dstStage)
+void VKDirectDisplay::transitionImage(vk::CommandBuffer buf, vk::Image img, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlagBits srcStage, vk::PipelineStageFlags dstStage,
+                                      uint32_t srcFamily, uint32_t dstFamily)
 {
   vk::ImageMemoryBarrier barrier{};
+  barrier.setSrcQueueFamilyIndex(srcFamily);
+  barrier.setDstQueueFamilyIndex(dstFamily);
   barrier.setSrcAccessMask(srcAccess);
   barrier.setDstAccessMask(dstAccess);
   barrier.setOldLayout(oldLayout);
@@ -27,29 +27,367 @@
 
 #include <include_gl.h>
 #include <vulkan/vulkan.hpp>
-#include <vulkan/vulkan_win32.h>
 #include <nvvk/extensions_vk.hpp>
 
 #include <nvh/nvprint.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "SPSCQueue.h"
+#include "VKDExport.h"
+#include "VKDPlatform.h"
+#include "VKDRenderer.h"
+#include "VKDTransfer.h"
+
 class VKDirectDisplay
 {
 public:
+  // GL/VK synchronization scheme used by getTexture() / submitTexture()
+  enum class SyncMode : uint32_t
+  {
+    eBinary,    // binary semaphore pair per interop texture, fence per frame
+    eTimeline,  // one timeline semaphore per direction, one submit per frame, no fence
+  };
+
+  // how the swapchain present mode is picked from the modes the surface supports
+  enum class PresentPolicy : uint32_t
+  {
+    eNoTearing,      // mailbox, FIFO
+    eLowestLatency,  // immediate, mailbox, FIFO relaxed, FIFO
+    eLowestPower,    // FIFO
+    eExplicit,       // Config::presentMode, FIFO if not supported
+  };
+
+  // how the display mode of each direct display is picked
+  enum class ModePolicy : uint32_t
+  {
+    eLargest,        // largest visible region, the highest refresh rate of those
+    eMaxRefresh,     // highest refresh rate at or above Config::modeWidth x modeHeight, the largest of those
+    eExact,          // Config::modeWidth x modeHeight with the refresh rate closest to Config::modeRefreshHz, 0: highest
+    eFitRenderTime,  // highest refresh rate whose period fits Config::modeFrameTimeMs, at or above modeWidth x modeHeight
+  };
+
+  // pipeline stages watched by the stall detector
+  enum class StallStage : uint32_t
+  {
+    eGLFinish,  // waiting for the previous use of an interop texture: GL rendering and blit
+    eAcquire,   // acquireNextImageKHR
+    eBlit,      // GPU time of the blit
+    ePresent,   // CPU time in vkQueuePresentKHR
+    eCount
+  };
+
+  struct Config
+  {
+    // falls back to eBinary if GL_NV_timeline_semaphore, VK_KHR_timeline_semaphore
+    // or VK_KHR_synchronization2 are not available
+    SyncMode syncMode = SyncMode::eTimeline;
+
+    // direct displays to drive, in the order they are laid out left to right in the interop textures
+    // 0 displays: all available from firstDisplay on
+    uint32_t firstDisplay = 0;
+    uint32_t displayCount = 1;
+
+    // first display by name instead of index: the first display whose name contains this, firstDisplay is ignored
+    std::string displayName;
+
+    // display GPU by UUID (hex, as printed at startup) or a part of its name, empty: the first suitable one
+    std::string displayDevice;
+
+    // GL renders on the GPU of its context, matched by GL_DEVICE_UUID_EXT (LUID on Windows), which may not be the display GPU
+    // the frames then cross over through host memory: the render GPU copies each one into a staging ring,
+    // the display GPU uploads it from there. needs SyncMode::eTimeline, not available with beam racing
+    // false: fail if GL doesn't render on the display GPU
+    bool crossDeviceTransfer = true;
+
+    // display mode selection, falls back to eLargest if no mode qualifies
+    ModePolicy modePolicy      = ModePolicy::eLargest;
+    uint32_t   modeWidth       = 0;
+    uint32_t   modeHeight      = 0;
+    float      modeRefreshHz   = 0.0f;
+    float      modeFrameTimeMs = 0.0f;
+
+    // VK_EXT_headless_surface instead of display plane surfaces, for measuring the pipeline without a display
+    // displayCount outputs (at least one), each pretending a headlessWidth x headlessHeight @ headlessRefreshHz mode
+    bool     headless          = false;
+    uint32_t headlessWidth     = 1920;
+    uint32_t headlessHeight    = 1080;
+    float    headlessRefreshHz = 60.0f;
+
+    // number of interop textures GL can render into before waiting for the display
+    // 0: same as the swapchain image count
+    uint32_t framesInFlight = 0;
+
+    // requested swapchain image count, clamped to the surface capabilities
+    // 0: minImageCount + 1
+    uint32_t swapchainImageCount = 0;
+
+    // acquire, blit and present on a VKDirectDisplay owned thread
+    // submitTexture() then only signals GL and hands the frame over,
+    // getTexture() blocks until the present thread hands back an interop texture
+    bool presentThread = false;
+
+    // Config::presentThread: if GL hasn't handed over a new frame one refresh period after the last present,
+    // present the last frame again so the display keeps its cadence, needs at least two frames in flight
+    // the present thread holds on to the last frame's interop texture until the next one arrives
+    bool frameSynthesis = false;
+
+    // Config::frameSynthesis: shift repeated frames by the image space motion of the scene origin
+    // between the frame's view projection and the newest one, see setViewProjection()
+    // needs the blits on the graphics queue, repeated frames are presented unshifted otherwise
+    bool reprojection = true;
+
+    // just-in-time frame pacing through waitForRenderStart(), needs VK_KHR_present_id and VK_KHR_present_wait
+    // not available together with presentThread
+    bool framePacing = false;
+
+    // safety margin added to the learned GL render and VK blit times when scheduling the render start
+    float pacingMarginMs = 1.0f;
+
+    // frame rate governor: without frame pacing, waitForRenderStart() caps the frame rate at the first display's
+    // refresh rate divided by this, for present modes that don't block on their own (mailbox, immediate). 0: off
+    uint32_t refreshDivisor = 0;
+
+    // the displays run with variable refresh, enabled outside of VK (VK_KHR_display can't query or switch it)
+    // the governor then only enforces the minimum frame time instead of keeping frames on the refresh grid
+    bool variableRefresh = false;
+
+    PresentPolicy      presentPolicy = PresentPolicy::eNoTearing;
+    vk::PresentModeKHR presentMode   = vk::PresentModeKHR::eFifo;  // PresentPolicy::eExplicit
+
+    // create the interop textures in the swapchain format and copy instead of blit,
+    // GL has to render with an upper left origin then, see isUpperLeftOrigin()
+    // falls back to the flipping blit if the swapchain format has no GL equivalent
+    bool copyFastPath = true;
+
+    // sub-allocate all interop textures from one exported allocation, imported once into GL
+    // falls back to one allocation per texture if the driver requires dedicated allocations
+    bool pooledInteropMemory = true;
+
+    // run the copy fast path on a dedicated transfer queue, or an async compute queue, if the GPU has one
+    // so it doesn't contend with GL on the graphics queue, the flipping blit needs a graphics queue
+    bool transferQueue = true;
+
+    // budget per StallStage in milliseconds, exceeding it is recorded as a stall
+    // the GL finish and acquire waits time out after their budget
+    float stallBudgetMs[uint32_t(StallStage::eCount)] = {100.0f, 100.0f, 8.0f, 8.0f};
+
+    // degraded mode: drop the frame if the acquire times out instead of waiting on
+    bool dropFramesOnStall = false;
+
+    // dynamic render resolution: GL renders into a scaled down part of the interop textures,
+    // the blit scales it up to the swapchain images (bilinear if the format supports it)
+    // the blits need the graphics queue then, the copy fast path blits on scaled frames
+    bool dynamicResolution = false;
+
+    // Config::dynamicResolution: adjust the render scale every frame so GL render time and blit time
+    // stay within renderBudget of the refresh period, setRenderScale() otherwise
+    bool  autoRenderScale = true;
+    float renderBudget    = 0.9f;
+    float minRenderScale  = 0.5f;
+
+    // draw the scene with VKDRenderer straight into the swapchain images instead of copying GL's interop textures
+    // for comparing against the interop path: no interop textures, always binary sync, no present thread
+    // getTexture() / submitTexture() must not be used, see renderNative()
+    bool nativeRenderer = false;
+
+    // VK_KHR_incremental_present: pass the damage from setDamage() along with the present, if the device supports it
+    bool incrementalPresent = true;
+
+    // beam racing: GL hands over each frame in this many horizontal slices, VK blits and presents each one
+    // with immediate present just before the scanout reaches it, see waitForSlice() / submitSlice(). 0: off
+    // needs SyncMode::eTimeline, not available with the present thread, frame pacing, dynamic resolution or the native renderer
+    // the scanout position is extrapolated from VK_EXT_display_control vblank events of the first display
+    uint32_t beamRacingSlices = 0;
+
+    // beam racing: GL render and VK blit time of one slice, rendering starts this long before the scanout reaches it
+    float beamRacingLeadMs = 2.0f;
+
+    // compositor: layerCount producers, e.g. threads with GL contexts of their own, each render into their own ring of
+    // interop textures through getLayerTexture() / submitLayer(). composeFrame() replaces getTexture() / submitTexture()
+    // and blits the newest finished frame of every layer into the swapchain images. 0: off
+    // needs timeline semaphores and GL on the display GPU, not available with the present thread, dynamic resolution,
+    // beam racing or the native renderer
+    uint32_t layerCount = 0;
+
+    // compositor: where each layer goes, canvas pixels, upper left origin, later layers on top
+    // the layer's textures have the rect's extent. missing ones: the canvas split into vertical strips
+    std::vector<vk::Rect2D> layerRects;
+
+    // compositor: interop textures per layer, at least 2
+    uint32_t layerFrames = 3;
+
+    // hands the interop textures to consumer processes on the same GPU, e.g. a recorder or a streaming encoder, see VKDExport.h
+    // Linux: path of the unix domain socket, Windows: name of the pipe. empty: off
+    // needs timeline semaphores, not available with dynamic resolution, beam racing, the compositor, the cross device
+    // transfer or the native renderer
+    std::string exportName;
+  };
+
+  struct StallStats
+  {
+    uint64_t   stalls[uint32_t(StallStage::eCount)];  // budget exceeded, per stage
+    uint64_t   timeouts;                               // waits that ran into their budget
+    uint64_t   droppedFrames;
+    uint64_t   suboptimal;                             // VK_SUBOPTIMAL_KHR from acquire or present
+    uint64_t   outOfDate;                              // VK_ERROR_OUT_OF_DATE_KHR from acquire or present
+    uint64_t   surfaceLost;                            // VK_ERROR_SURFACE_LOST_KHR from acquire or present
+    uint64_t   recoveries;                             // successful in place swapchain rebuilds
+    uint64_t   synthesizedFrames;                      // Config::frameSynthesis, frames presented again
+    uint64_t   skippedFrames;                          // skipFrame(), nothing rendered or presented
+    uint64_t   lateSlices;                             // Config::beamRacingSlices, presented after the scanout reached them
+    StallStage lastStage;                              // most recent stall
+    double     lastMs;
+    double     totalMs[uint32_t(StallStage::eCount)];  // time spent per stage, GPU time for eBlit, CPU time otherwise
+    uint64_t   samples[uint32_t(StallStage::eCount)];
+  };
+
+  // measured per present mode, accumulated over all the time the mode was in use
+  struct PresentModeStats
+  {
+    vk::PresentModeKHR mode;
+    uint64_t           frames;
+    double             seconds;
+    double             framesPerSecond;
+    double             avgQueueDepth;  // frames submitted to VK whose blit wasn't finished, sampled at each present
+  };
+
+  // a display mode of a driven display, see getDisplayModes()
+  struct DisplayModeInfo
+  {
+    vk::Extent2D extent;
+    float        refreshHz;
+    bool         active;
+  };
+
+  // frame pacing and timing, times in milliseconds, present times relative to init()
+  struct PacingStats
+  {
+    double renderTimeMs;        // learned GL render time, between getTexture() and submitTexture()
+    double blitTimeMs;          // learned VK blit time
+    double refreshPeriodMs;     // refresh interval of the display mode
+    double predictedPresentMs;  // predicted present time of the last completed frame
+    double actualPresentMs;     // observed present time of the last completed frame
+  };
+
   VKDirectDisplay();
 
   // initialize direct display and GL textures
   // call this with the GL context current that's used for interop 
-  bool init();
+  // same as initDevice() followed by initInterop()
+  bool init(const Config& config = Config());
+
+  // VK only part of init(): instance, GPU, display, device and swapchain
+  // doesn't need a GL context, can run on a background thread while GL is set up
+  bool initDevice(const Config& config = Config());
 
-  // shut down VKDirectDisplay
+  // GL/VK interop part of init(), call this after initDevice() succeeded
+  // with the GL context current that's used for interop
+  bool initInterop();
+
+  // shut down VKDirectDisplay, releases all VK and GL objects and the display
+  // call this with the GL context current that's used for interop, init() can be called again afterwards
   void shutdown();
 
+  // shutdown() followed by init() with the last config
+  bool reinit();
+
+  // true while the swapchain is lost and couldn't be rebuilt yet, e.g. display in standby
+  // getTexture() / submitTexture() keep working, frames are dropped
+  bool isSuspended() const;
+
   // width and height of swapchain interop textures
   // by default the highest resolution available for the direct display
-  uint32_t getWidth()  { return m_swapchainExtent.width; }
-  uint32_t getHeight() { return m_swapchainExtent.height; }
+  // with several displays they are placed side by side, top aligned
+  uint32_t getWidth()  { return m_interopExtent.width; }
+  uint32_t getHeight() { return m_interopExtent.height; }
+
+  // number of direct displays driven
+  uint32_t getDisplayCount() const { return uint32_t(m_outputs.size()); }
+
+  // Config::crossDeviceTransfer: true if GL renders on another GPU and the frames go through host memory
+  bool isCrossDevice() const { return m_transfer.isActive(); }
+
+  // Config::exportName: true if consumer processes can connect
+  bool isExporting() const { return m_export.isActive(); }
+
+  // name and all modes of the display driven by an output, the active one is flagged
+  const char*                  getDisplayName(uint32_t output) const;
+  std::vector<DisplayModeInfo> getDisplayModes(uint32_t output) const;
+
+  // mode selection for the next reinit(), see Config::modePolicy
+  void setModePolicy(ModePolicy policy, uint32_t width, uint32_t height, float refreshHz);
+  // ModePolicy::eFitRenderTime with the learned GL render and VK blit times, for the next reinit()
+  // returns the frame time the mode has to fit, 0 if nothing was measured yet
+  float fitModeToRenderTime();
+
+  // sync mode in use, may differ from the requested one
+  SyncMode getSyncMode() const { return m_syncMode; }
+
+  // pipeline depth in use
+  uint32_t getFramesInFlight() const { return m_native ? m_nativeFrames : m_compositor ? m_composeFrames : uint32_t(m_syncData.size()); }
+  uint32_t getSwapchainImageCount() const { return m_outputs.empty() ? 0 : uint32_t(m_outputs[0].images.size()); }
+
+  // change pipeline depth at runtime, see Config for the meaning of the values
+  // the display stays acquired, the swapchain is only recreated if its image count changes
+  // previously returned textures are invalid afterwards
+  // call this with the GL context current that's used for interop, outside of getTexture() / submitTexture()
+  bool setFrameCounts(uint32_t framesInFlight, uint32_t swapchainImageCount);
+
+  // Config::framePacing: blocks until the next frame should start rendering,
+  // so it finishes just before the next vblank. returns immediately if pacing is disabled
+  void waitForRenderStart();
+
+  // learned timings and predicted vs. actual present time
+  PacingStats getPacingStats() const;
+  bool isFramePacingEnabled() const { return m_pacing.enabled; }
+
+  // Config::refreshDivisor, the governor caps the frame rate at getRefreshRate() / divisor
+  double   getRefreshRate() const { return m_pacing.periodMs > 0.0 ? 1000.0 / m_pacing.periodMs : 0.0; }
+  uint32_t getRefreshDivisor() const { return m_governor.divisor; }
+  void     setRefreshDivisor(uint32_t divisor)
+  {
+    m_governor.divisor      = divisor;
+    m_config.refreshDivisor = divisor;  // kept by reinit()
+  }
+  // false if frame pacing, beam racing or a blocking present mode set the frame rate instead
+  bool     isFrameRateGoverned() const;
+
+  // pick a new present mode, recreates the swapchain if the resulting mode differs
+  // call this outside of getTexture() / submitTexture()
+  bool setPresentPolicy(PresentPolicy policy, vk::PresentModeKHR mode = vk::PresentModeKHR::eFifo);
+  vk::PresentModeKHR getPresentMode() const { return m_presentMode; }
+  const std::vector<vk::PresentModeKHR>& getSupportedPresentModes() const { return m_supportedPresentModes; }
+  std::vector<PresentModeStats> getPresentModeStats();
+
+  // Config::dynamicResolution: GL renders into the lower left getRenderWidth() x getRenderHeight() part
+  // of the texture returned by getTexture() (upper left with isUpperLeftOrigin()), the extent is updated by getTexture()
+  // without dynamic resolution it's the whole texture
+  uint32_t getRenderWidth() const { return m_renderExtent.width; }
+  uint32_t getRenderHeight() const { return m_renderExtent.height; }
+  bool     isDynamicResolutionEnabled() const { return m_resolution.enabled; }
+
+  // render scale per axis, in [Config::minRenderScale, 1]
+  // setRenderScale() takes effect while the automatic scale is off
+  float getRenderScale() const { return m_resolution.scale; }
+  void  setRenderScale(float scale);
+  bool  isAutoRenderScale() const { return m_resolution.automatic; }
+  void  setAutoRenderScale(bool enable) { m_resolution.automatic = enable; }
+
+  // true if GL has to render upside down into the interop textures (glClipControl(GL_UPPER_LEFT, ...)),
+  // so VK can copy them to the swapchain images without flipping
+  bool isUpperLeftOrigin() const { return m_copyFastPath; }
+
+  // stall detector and present result counters
+  StallStats getStallStats();
+  static const char* getStallStageName(StallStage stage);
 
   // get the texture to render the next frame into
   // synchronization: GL waits for the VK texture to be available
@@ -59,8 +397,72 @@ public:
   // synchronization:
   // * GL signals to VK that rendering is done
   // * VK signals to VK that texture can be used for next frame
+  // with Config::presentThread the VK part runs on the present thread
   void submitTexture();
 
+  // Config::reprojection: view projection of the frame GL renders, call before submitTexture()
+  void setViewProjection(const glm::mat4& viewProj);
+
+  // parts of the frame GL renders that differ from the last submitted one, call before submitTexture()
+  // canvas pixels, upper left origin, independent of the render scale. applies to the next frame only
+  // no call or no rects: the whole frame changed. only a hint, GL still has to render the whole frame
+  void setDamage(const std::vector<vk::Rect2D>& rects);
+
+  // nothing changed since the last frame: instead of getTexture() / submitTexture() or renderNative(),
+  // the displays keep showing the last presented image. throttles to the refresh rate,
+  // and Config::frameSynthesis doesn't repeat frames until the next submitTexture()
+  void skipFrame();
+
+  // false if the displays may not show the last frame anymore, e.g. after a swapchain rebuild,
+  // skipFrame() must not be used then
+  bool canSkipFrame() const { return !m_frameRequired && !m_compositor; }
+  bool isIncrementalPresentEnabled() const { return m_incrementalPresent; }
+
+  // Config::beamRacingSlices: slices in use, 0 if beam racing is off
+  // a frame is getTexture(), then per slice waitForSlice(), rendering canvas rows [getSliceTop(slice), getSliceTop(slice + 1))
+  // and submitSlice(). the last submitSlice() replaces submitTexture()
+  uint32_t getSliceCount() const { return m_beamRacing.slices; }
+  uint32_t getSliceTop(uint32_t slice) const { return slice * m_interopExtent.height / std::max(m_beamRacing.slices, 1u); }
+
+  // blocks until the slice should start rendering, Config::beamRacingLeadMs before the scanout reaches it
+  void waitForSlice(uint32_t slice);
+
+  // GL signals the slice is done, VK blits its rows (and the previous slice's, the tear lands in them) and presents
+  void submitSlice(uint32_t slice);
+
+  // Config::nativeRenderer: true if the scene is rendered by VK, the GL context isn't needed for it then
+  bool isNative() const { return m_native; }
+
+  // Config::nativeRenderer: torus geometry, positions and normals per vertex, triangle list indices
+  void setNativeGeometry(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<uint32_t>& indices);
+
+  // Config::nativeRenderer: replaces getTexture() / submitTexture()
+  // renders the frame into the acquired swapchain images and presents it, same pacing and stats as the interop path
+  void renderNative(const SceneData& scene, const std::vector<VKDRenderer::Draw>& draws);
+
+  // Config::layerCount: true if composeFrame() replaces getTexture() / submitTexture()
+  bool     isCompositor() const { return m_compositor; }
+  uint32_t getLayerCount() const { return uint32_t(m_layers.size()); }
+  uint32_t getLayerWidth(uint32_t layer) const { return m_layers[layer].extent.width; }
+  uint32_t getLayerHeight(uint32_t layer) const { return m_layers[layer].extent.height; }
+
+  // where the layer is composed, canvas pixels, upper left origin, its textures are scaled to fit
+  // call on the thread calling composeFrame()
+  vk::Rect2D getLayerRect(uint32_t layer) const { return m_layers[layer].rect; }
+  void       setLayerRect(uint32_t layer, const vk::Rect2D& rect) { m_layers[layer].rect = rect; }
+
+  // producer side, one thread per layer, with a GL context sharing objects with the one init() was called with
+  // texture to render the layer's next frame into, getLayerWidth() x getLayerHeight(), lower left origin
+  // GL waits until the compositor is done with the frame that used it before, the calling thread doesn't block
+  GLuint getLayerTexture(uint32_t layer);
+
+  // GL signals the frame is done, the first composeFrame() after GL finished it shows it
+  void submitLayer(uint32_t layer);
+
+  // compositor side: blits the newest finished frame of every layer into the acquired swapchain images and presents
+  // never waits for a producer, a layer without a new frame is shown with its last one. same pacing and stats as the interop path
+  void composeFrame();
+
 private:
 
   struct Display
@@ -68,66 +470,395 @@ private:
     vk::DisplayKHR               displayKHR;
     vk::DisplayPropertiesKHR     displayProperties;
     vk::DisplayModePropertiesKHR modeProperties;
+    uint32_t                     planeIndex{ 0 };
+    bool                         acquired{ false };  // displayKHR has to be released, it stays set to acquire it again
   };
 
-  struct VKGLSyncData
+  // a direct display with its own surface and swapchain
+  // all outputs share the device, the queues and the interop textures, each shows its region of them
+  struct Output
+  {
+    Display                          display;
+    vk::UniqueSurfaceKHR             surface;
+    vk::UniqueSwapchainKHR           swapchain;
+    std::vector<vk::Image>           images;
+    vk::Extent2D                     extent;
+    vk::Format                       format{ vk::Format::eUndefined };
+    vk::Offset2D                     offset;                  // region in the interop textures, upper left corner
+    std::vector<vk::UniqueSemaphore> acquireSemaphores;       // swapchain image count + frames in flight, recycled per image
+    std::vector<vk::Semaphore>       freeAcquireSemaphores;   // not waited for by a pending blit
+    std::vector<vk::Semaphore>       imageAcquireSemaphores;  // per swapchain image, signaled by its last acquire
+    std::vector<vk::UniqueSemaphore> blitFinishedSemaphores;  // per swapchain image
+    std::vector<vk::CommandBuffer>   blitCommandBuffers;      // interop index * swapchain image count + swapchain image index
+    std::vector<vk::Extent2D>        blitSources;             // per blit command buffer, render extent it was recorded for
+    std::vector<vk::UniqueSemaphore> ownedSemaphores;         // per swapchain image, if the present family differs from the blit family
+    std::vector<vk::CommandBuffer>   ownershipCommandBuffers; // per swapchain image, acquire by the present family
+    vk::UniqueSemaphore              synthAcquired;           // Config::frameSynthesis, acquire for a repeated frame
+    vk::CommandBuffer                synthCommandBuffer;      // Config::frameSynthesis, recorded per repeated frame
+    std::vector<vk::UniqueSemaphore> sliceAcquired;           // Config::beamRacingSlices, per interop texture and slice
+    std::vector<vk::CommandBuffer>   sliceCommandBuffers;     // per blit command buffer and slice
+    std::vector<vk::CommandBuffer>   sliceInitCommandBuffers; // per swapchain image, undefined to present layout on first use
+    std::vector<bool>                sliceInitialized;        // per swapchain image
+    uint32_t                         queryBase{ 0 };          // first timestamp pair of blitCommandBuffers
+    uint32_t                         acquireTimeouts{ 0 };    // consecutive, rebuilt at maxStallTimeouts
+    bool                             stale{ true };           // missed a frame, presented again even if the damage doesn't touch it
+  };
+
+  // swapchain image acquired for a frame
+  struct Acquired
+  {
+    uint32_t      output;
+    uint32_t      image;
+    vk::Semaphore semaphore; // signaled by the acquire, the blit waits for it
+  };
+
+  // exported VK memory and the GL memory object it's imported into
+  struct InteropMemory
   {
-    // VK texture
     vk::UniqueDeviceMemory  m_deviceMemory;
+    vk::DeviceSize          m_size{ 0 };
+    VKDPlatform::Handle     m_handle{ VKDPlatform::invalidHandle };
+    GLuint                  m_memoryObject{ 0 };
+  };
+
+  // Config::exportName: copy of an interop texture for the consumers, in its own exported memory, kept in eGeneral
+  struct ExportFrame
+  {
+    vk::UniqueImage        m_image;
+    vk::UniqueDeviceMemory m_memory;
+  };
+
+  struct VKGLSyncData
+  {
+    // VK texture, m_memory is only used if it's not in the pool
+    // Config::crossDeviceTransfer: not shared with GL, the frames are uploaded into it from the staging ring
     vk::UniqueImage         m_image;
-    HANDLE                  m_handle;
-    GLuint                  m_memoryObject;
+    InteropMemory           m_memory;
 
-    // GL texture handle of VK texture
-    GLuint                  m_textureGL;
+    // GL texture handle of VK texture, owned by VKDTransfer with Config::crossDeviceTransfer
+    GLuint                  m_textureGL{ 0 };
 
     // VK semaphores
     vk::UniqueSemaphore m_available; // VK signals to GL: available
     vk::UniqueSemaphore m_finished;  // GL signals to VK: done rendering
-    HANDLE              m_availableHandle;
-    HANDLE              m_finishedHandle;
+    VKDPlatform::Handle m_availableHandle{ VKDPlatform::invalidHandle };
+    VKDPlatform::Handle m_finishedHandle{ VKDPlatform::invalidHandle };
 
     // GL semaphore hanldes of VK semaphores
-    GLuint              m_availableGL;
-    GLuint              m_finishedGL;
+    GLuint              m_availableGL{ 0 };
+    GLuint              m_finishedGL{ 0 };
+
+    // SyncMode::eTimeline: value of m_vkDone after which the texture is available
+    uint64_t            m_releaseValue{ 0 };
+
+    // part of the texture GL rendered the last frame into, Config::dynamicResolution
+    vk::Extent2D        m_renderExtent;
+
+    // view projection the last frame was rendered with, Config::reprojection
+    glm::mat4           m_viewProj{ 1.0f };
 
+    // setDamage() of the last frame, empty if all of it changed
+    std::vector<vk::Rect2D> m_damage;
 
+    // GL timestamps around rendering, timestamp pair of the last blit from it (first output presented)
+    GLuint              m_timerQueries[2]{ 0, 0 };
+    bool                m_timerPending{ false };
+    int32_t             m_lastBlit{ -1 };
   };
 
+  // SyncMode::eTimeline: shared by all interop textures, values increase by one per frame
+  struct TimelineSync
+  {
+    vk::UniqueSemaphore m_glDone;  // GL signals to VK: done rendering frame <value>
+    vk::UniqueSemaphore m_vkDone;  // VK signals to GL: blit of frame <value> done
+    VKDPlatform::Handle m_glDoneHandle{ VKDPlatform::invalidHandle };
+    VKDPlatform::Handle m_vkDoneHandle{ VKDPlatform::invalidHandle };
+    GLuint              m_glDoneGL{ 0 };
+    GLuint              m_vkDoneGL{ 0 };
+    uint64_t            m_value{ 0 };  // last value signaled by GL
+  };
+
+  // Config::layerCount: a producer's ring of interop textures, its frame <value> is in frames[(value - 1) % size]
+  struct Layer
+  {
+    vk::Rect2D                rect;           // where it's composed, canvas pixels, upper left origin
+    vk::Extent2D              extent;         // of the textures
+    std::vector<VKGLSyncData> frames;         // only image, memory and texture are used
+    TimelineSync              timeline;       // m_glDone: producer finished frame <value>, m_vkDone: compositor done with frames up to <value>
+    uint64_t                  shown{ 0 };     // newest frame composed, 0: none yet
+    uint64_t                  released{ 0 };  // last value the compositor signaled
+  };
+
+  // what has to be rebuilt in place, set by acquire / present results, handled in getTexture()
+  enum RecreateFlags : uint32_t
+  {
+    eRecreateSwapchain = 1,  // out of date or suboptimal
+    eRecreateSurface   = 2,  // surface lost, reacquire the display
+  };
+
+  // handed from the GL thread to the present thread
+  struct PresentRequest
+  {
+    uint32_t frameIndex;  // interop texture
+    uint64_t value;       // SyncMode::eTimeline: value GL signaled
+  };
+
+  // Config::framePacing
+  struct Pacing
+  {
+    using Clock = std::chrono::steady_clock;
+
+    bool              enabled{ false };
+    bool              presentWait{ false };  // presents are tagged with ids, for frame pacing or the governor's grid
+    double            periodMs{ 0.0 };
+    double            marginMs{ 1.0 };
+    double            renderMs{ 0.0 };  // moving averages
+    double            blitMs{ 0.0 };
+    uint64_t          presentId{ 0 };   // last id passed to presentKHR
+    uint64_t          waitedId{ 0 };    // last id waited for
+    Clock::time_point epoch;
+    Clock::time_point lastVblank;
+    double            nextPredictedMs{ 0.0 };       // for the frame rendered after waitForRenderStart()
+    double            predictedMs[16]{};             // by present id % 16
+    double            lastPredictedMs{ 0.0 };
+    double            lastActualMs{ 0.0 };
+  };
+
+  // Config::dynamicResolution
+  struct DynamicResolution
+  {
+    bool  enabled{ false };
+    bool  automatic{ true };
+    float budget{ 0.9f };
+    float minScale{ 0.5f };
+    float scale{ 1.0f };
+  };
+
+  struct ModeStats
+  {
+    uint64_t frames{ 0 };
+    uint64_t queueDepthSum{ 0 };
+    double   seconds{ 0.0 };  // excluding the time since m_presentModeStart if the mode is current
+  };
+
+  Config                            m_config;  // as passed to init(), for reinit()
+  SyncMode                          m_syncMode{ SyncMode::eBinary };
+  uint32_t                          m_requestedFramesInFlight{ 0 };
+  uint32_t                          m_requestedSwapchainImages{ 0 };
   vk::UniqueInstance                m_instance;
   vk::PhysicalDevice                m_gpu;
-  Display                           m_display;
-  vk::UniqueSurfaceKHR              m_surface;
+  VKDPlatform                       m_platform;
+  std::vector<Output>               m_outputs;
+  std::vector<vk::QueueFamilyProperties> m_queueFamilies;
   uint32_t                          m_presentFamily{ 0 };
   vk::Queue                         m_presentQueue;
+  uint32_t                          m_graphicsFamily{ 0 };
+  vk::Queue                         m_graphicsQueue;
+  uint32_t                          m_transferFamily{ VK_QUEUE_FAMILY_IGNORED };  // Config::transferQueue, none if ignored
+  vk::Queue                         m_transferQueue;
+  bool                              m_requestedTransferQueue{ true };
+  // queue the blits and copies run on, either graphics or transfer, picked along with the copy fast path
+  uint32_t                          m_blitFamily{ 0 };
+  vk::Queue                         m_blitQueue;
+  vk::CommandPool                   m_blitPool;
+  vk::PipelineStageFlagBits         m_blitStage{ vk::PipelineStageFlagBits::eColorAttachmentOutput };  // transfer queues don't have it
+  vk::AccessFlags                   m_interopAccess{ vk::AccessFlagBits::eColorAttachmentWrite };
   vk::UniqueDevice                  m_device;
-  vk::UniqueSwapchainKHR            m_swapchain;
-  std::vector<vk::Image>            m_swapchainImages;
-  vk::Extent2D                      m_swapchainExtent;
-  vk::Format                        m_swapchainFormat{ vk::Format::eUndefined };
+  vk::Extent2D                      m_interopExtent;
+  vk::Format                        m_interopFormat{ vk::Format::eR8G8B8A8Unorm };
+  bool                              m_requestedCopyFastPath{ true };
+  bool                              m_copyFastPath{ false };  // interop textures match the swapchain images
+  bool                              m_requestedPooledMemory{ true };
+  bool                              m_requestedPresentThread{ false };
+  bool                              m_headless{ false };  // Config::headless
+  bool                              m_native{ false };    // Config::nativeRenderer
+  uint32_t                          m_nativeFrames{ 0 };
+  VKDRenderer                       m_renderer;
+  VKDTransfer                       m_transfer;                    // Config::crossDeviceTransfer
+  VKDExport                         m_export;                      // Config::exportName
+  bool                              m_compositor{ false };         // Config::layerCount
+  uint32_t                          m_composeFrames{ 0 };
+  std::vector<Layer>                m_layers;
+  std::vector<vk::CommandBuffer>    m_composeCommandBuffers;       // per composed frame in flight, recorded per frame
+  bool                              m_hasHostImport{ false };      // VK_EXT_external_memory_host, for m_transfer
+  std::vector<vk::CommandBuffer>    m_uploadCommandBuffers;        // per interop texture, staging slot to m_image
+  std::vector<ExportFrame>          m_exportFrames;                // Config::exportName, one per interop texture
+  std::vector<vk::CommandBuffer>    m_exportCommandBuffers;        // per interop texture, copy into its export frame
+  bool                              m_hasDedicatedQuery{ false };  // VK_KHR_dedicated_allocation
+  InteropMemory                     m_interopMemory;               // Config::pooledInteropMemory
   uint32_t                          m_frameIndex{ 0 };
   std::vector<VKGLSyncData>         m_syncData;
+  TimelineSync                      m_timeline;
+  std::vector<const char*>          m_deviceExtensions;
   std::vector<vk::UniqueFence>      m_fences;
-  std::vector<vk::UniqueSemaphore>  m_imageAcquiredSemaphores;
-  std::vector<vk::UniqueSemaphore>  m_blitFinishedSemaphores;
-  vk::UniqueCommandPool             m_commandPool;
-  std::vector<vk::CommandBuffer>    m_blitCommandBuffers;
+  vk::UniqueCommandPool             m_commandPool;   // graphics family
+  vk::UniqueCommandPool             m_transferPool;
+  vk::UniqueCommandPool             m_presentPool;   // ownership acquires, if the present family differs
+  vk::UniqueQueryPool               m_timestampPool;       // two per blit command buffer of all outputs
+  float                             m_timestampPeriod{ 0.0f };
+  Pacing                            m_pacing;
+  DynamicResolution                 m_resolution;
+  vk::Extent2D                      m_renderExtent;           // of the texture returned by the last getTexture()
+  vk::Filter                        m_scaleFilter{ vk::Filter::eLinear };  // for blits from a scaled down render extent
+
+  PresentPolicy                          m_presentPolicy{ PresentPolicy::eNoTearing };
+  vk::PresentModeKHR                     m_requestedPresentMode{ vk::PresentModeKHR::eFifo };
+  vk::PresentModeKHR                     m_presentMode{ vk::PresentModeKHR::eFifo };
+  std::vector<vk::PresentModeKHR>        m_supportedPresentModes;
+  std::map<vk::PresentModeKHR, ModeStats> m_presentModeStats;
+  std::chrono::steady_clock::time_point  m_presentModeStart;
+  std::mutex                             m_statsMutex;  // present thread updates, GL thread reads
+
+  float                                  m_stallBudgetMs[uint32_t(StallStage::eCount)]{};
+  bool                                   m_dropFramesOnStall{ false };
+  StallStats                             m_stallStats{};
+
+  // Config::presentThread
+  std::thread                       m_presentThread;
+  std::atomic<bool>                 m_presentThreadStop{ false };
+  std::atomic<bool>                 m_presentThreadFailed{ false };  // set by the present thread before it exits on an error
+  SPSCQueue<PresentRequest>         m_submitQueue;  // GL thread -> present thread: frames to present
+  SPSCQueue<uint32_t>               m_freeQueue;    // present thread -> GL thread: interop textures to render into
+
+  // Config::frameSynthesis, used by the present thread
+  bool                                  m_frameSynthesis{ false };
+  bool                                  m_reprojection{ false };
+  int32_t                               m_heldFrame{ -1 };       // interop texture of the last frame, not handed back to GL yet
+  vk::UniqueFence                       m_synthFence;            // last repeated frame
+  bool                                  m_synthPending{ false };
+  std::chrono::steady_clock::time_point m_lastPresent;
+  std::mutex                            m_viewMutex;
+  glm::mat4                             m_viewProj{ 1.0f };      // newest, from setViewProjection()
+
+  // Config::refreshDivisor
+  struct Governor
+  {
+    using Clock = std::chrono::steady_clock;
+
+    uint32_t          divisor{ 0 };
+    bool              variableRefresh{ false };
+    Clock::time_point last;  // start of the last governed frame
+  };
+
+  // Config::beamRacingSlices
+  struct BeamRacing
+  {
+    using Clock = std::chrono::steady_clock;
+
+    uint32_t             slices{ 0 };
+    double               leadMs{ 2.0 };
+    Clock::time_point    frameVblank;                 // start of the scanout the current frame races
+    std::thread          vblankThread;                // VK_EXT_display_control, timestamps the first display's vblanks
+    std::atomic<bool>    vblankThreadStop{ false };
+    std::atomic<int64_t> lastVblank{ 0 };             // Clock ticks since its epoch
+  };
+
+  // VK_KHR_incremental_present and skipFrame()
+  bool                                  m_incrementalPresent{ false };
+  std::vector<vk::Rect2D>               m_damage;                // for the next submitTexture()
+  std::atomic<bool>                     m_frameRequired{ true }; // nothing presented since the swapchains were created
+  std::atomic<bool>                     m_idle{ false };         // skipFrame() since the last submitTexture()
+  std::chrono::steady_clock::time_point m_lastSkip;
+
+  Governor                              m_governor;
+  BeamRacing                            m_beamRacing;
+  bool                                  m_hasSurfaceCounter{ false };  // VK_EXT_display_surface_counter, for VK_EXT_display_control
+  bool                                  m_hasDisplayControl{ false };
+
+  // in place recovery
+  std::atomic<uint32_t>                 m_recreateFlags{ 0 };
+  std::chrono::steady_clock::time_point m_lastRecoverAttempt;
 
   void createInstance();
   bool checkDeviceExtensionSupport(vk::PhysicalDevice device);
+  bool checkTimelineSupport();
+  bool checkPresentWaitSupport();
   void pickGPU();
-  void createDisplaySurface();
+  void createDisplaySurfaces();
+  void createDisplaySurface(Output& o);
+  uint32_t chooseDisplayMode(const std::vector<vk::DisplayModePropertiesKHR>& modes) const;
+  void createHeadlessSurface(Output& o);
   void createLogicalDevice();
   void createCommandPool();
+  void selectBlitQueue();
+  bool needsOwnershipTransfer() const { return m_blitFamily != m_presentFamily; }
+  // frames in flight are limited by m_fences instead of m_timeline: binary sync, the native renderer and the compositor
+  bool usesFences() const { return m_syncMode == SyncMode::eBinary || m_compositor; }
+  void submitOwnershipTransfer(const std::vector<Acquired>& acquired);
   void createSwapchain();
-  uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
-  void createInteropTexture(VKGLSyncData& s);
+  void createSwapchain(Output& o, vk::PresentModeKHR presentMode);
+  vk::PresentModeKHR choosePresentMode(const std::vector<vk::PresentModeKHR>& presentModes) const;
+  void recreateSwapchain();
+  void freeBlitCommandBuffers();
+  void requestRecreate(uint32_t flags);
+  void recover();
+  uint32_t getQueueDepth();
+  void updatePresentStats();
+  void recordStall(StallStage stage, double ms, bool timeout);
+  void recordStageTime(StallStage stage, double ms);
+  void countResult(vk::Result result);
+  uint64_t getBudgetNs(StallStage stage) const;
+  bool waitReleased(uint32_t frameIndex);
+  bool acquireImage(uint32_t output, vk::Semaphore semaphore, uint32_t& imageIndex);
+  // damage: canvas pixels, outputs it doesn't touch are skipped unless they missed a frame, empty if everything changed
+  std::vector<Acquired> acquireImages(const std::vector<vk::Rect2D>& damage = {});
+  void dropFrame(uint32_t frameIndex, uint64_t value);
+  void createInteropImage(VKGLSyncData& s, vk::Extent2D extent);
+  bool requiresDedicatedMemory(vk::Image image);
+  void allocateInteropMemory(const vk::MemoryRequirements& requirements, vk::Image dedicatedImage, InteropMemory& m);
+  void destroyInteropMemory(InteropMemory& m);
+  void createInteropTexture(vk::CommandBuffer buf, VKGLSyncData& s, const InteropMemory& m, vk::DeviceSize offset, vk::Extent2D extent);
+  void createInteropSemaphore(vk::SemaphoreType type, vk::UniqueSemaphore& s, VKDPlatform::Handle& h, GLuint& g);
   void createInteropSemaphores(VKGLSyncData& s);
+  void createStagedImages();
+  void createExportRing();
+  void createTimelineSemaphores();
   void createSyncObjects();
+  void createNativeFrames();
+  void createComposeFrames();
+  void createLayers();
+  void destroyLayers();
+  void releaseLayers();
+  void recordComposeCommandBuffer(vk::CommandBuffer buf, const std::vector<Acquired>& acquired);
+  void destroySyncObjects();
   void createSyncs();
   void createCommandBuffers();
+  vk::CommandBuffer getBlitCommandBuffer(const Acquired& a, uint32_t interopIndex);
+  vk::CommandBuffer prepareBlitCommandBuffer(const Acquired& a, uint32_t interopIndex);
+  vk::Extent2D getScaledExtent(float scale) const;
+  void updateRenderScale();
+  uint32_t getBlitQueryPair(const Acquired& a, uint32_t interopIndex) const;
+  // queryIndex ~0u: no timestamps, shift: moves the image, the uncovered part is cleared (Config::reprojection)
+  void recordBlitCommandBuffer(vk::CommandBuffer buf, const Output& o, vk::Image syncImg, vk::Image swapImg, uint32_t queryIndex, vk::Extent2D source,
+                               vk::Offset2D shift = {});
+  // canvas rows [top, bottom), keeps the rest of the swapchain image unless its ownership is transferred
+  void recordSliceCommandBuffer(vk::CommandBuffer buf, const Output& o, vk::Image syncImg, vk::Image swapImg, uint32_t top, uint32_t bottom);
+  void readBlitTimestamps(uint32_t frameIndex);
+  void readRenderTimestamps(uint32_t frameIndex);
+  // damage: canvas pixels, upper left origin, empty if everything changed
+  void queuePresent(const std::vector<Acquired>& acquired, const std::vector<vk::Rect2D>& damage = {});
+  // Config::skipUnchanged: false if the output shows the last frame and the damage doesn't touch its region
+  bool needsPresent(const Output& o, const std::vector<vk::Rect2D>& damage) const;
+  std::vector<vk::RectLayerKHR> clipDamage(const Output& o, const std::vector<vk::Rect2D>& damage) const;
   vk::CommandBuffer createTmpCmdBuffer();
   void submitTmpCmdBuffer(vk::CommandBuffer c);
-  void transitionImage(vk::CommandBuffer buf, vk::Image img, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlagBits srcStage, vk::PipelineStageFlags dstStage);
+  void presentFrame(uint32_t frameIndex, uint64_t value);
+  void stageFrame(uint32_t frameIndex, uint64_t value);
+  void presentFrameBinary(uint32_t frameIndex);
+  void presentFrameTimeline(uint32_t frameIndex, uint64_t value);
+  void synthesizeFrame(uint32_t frameIndex);
+  void waitSynthesized();
+  vk::Offset2D getReprojectionShift(uint32_t frameIndex);
+  void governFrameRate();
+  void measureVblank(Governor::Clock::duration interval);
+  void startVblankThread();
+  void stopVblankThread();
+  void vblankThread();
+  void startPresentThread();
+  void stopPresentThread();
+  void presentThread();
+  void failPresentThread();
+  void transitionImage(vk::CommandBuffer buf, vk::Image img, vk::AccessFlags srcAccess, vk::AccessFlags dstAccess, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, vk::PipelineStageFlagBits srcStage, vk::PipelineStageFlags dstStage,
+                       uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstFamily = VK_QUEUE_FAMILY_IGNORED);
 };
 
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+
+#include "VKDExport.h"
+
+#include <nvh/nvprint.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// a consumer that doesn't keep up with the handshake is dropped, the listener must not block deinit()
+constexpr auto ioTimeout = std::chrono::seconds(1);
+
+#ifndef _WIN32
+// only removes sockets, whatever else is at path isn't ours
+void unlinkSocket(const std::string& path)
+{
+  struct stat info{};
+  if(lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+  {
+    unlink(path.c_str());
+  }
+}
+#endif
+}  // namespace
+
+void VKDExport::init(const std::string& name, vk::PhysicalDevice gpu)
+{
+  // consumers have to open the same GPU with the same driver to import the memory
+  auto const  props = gpu.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+  auto const& id    = props.get<vk::PhysicalDeviceIDProperties>();
+  m_name            = name;
+  m_description     = {};
+  m_description.magic       = magic;
+  m_description.version     = version;
+  m_description.controlSize = sizeof(Control);
+  std::memcpy(m_description.deviceUUID, id.deviceUUID.data(), VK_UUID_SIZE);
+  std::memcpy(m_description.driverUUID, id.driverUUID.data(), VK_UUID_SIZE);
+
+  // control block, anonymous shared memory handed out like the other handles
+  void* memory = nullptr;
+#ifdef _WIN32
+  m_controlHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(Control), nullptr);
+  if(m_controlHandle)
+  {
+    memory = MapViewOfFile(m_controlHandle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Control));
+  }
+#else
+  m_controlHandle = memfd_create("vkdd-export", MFD_CLOEXEC);
+  if(m_controlHandle >= 0 && ftruncate(m_controlHandle, sizeof(Control)) == 0)
+  {
+    memory = mmap(nullptr, sizeof(Control), PROT_READ | PROT_WRITE, MAP_SHARED, m_controlHandle, 0);
+    memory = memory == MAP_FAILED ? nullptr : memory;
+  }
+#endif
+  if(!memory)
+  {
+    deinit();
+    throw std::runtime_error("could not create the export control block");
+  }
+  m_control          = new(memory) Control();
+  m_control->magic   = magic;
+  m_control->version = version;
+
+#ifdef _WIN32
+  // one instance, consumers are served one after the other
+  std::string const pipe = "\\\\.\\pipe\\" + name;
+  m_pipe = CreateNamedPipeA(pipe.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT, 1, sizeof(Description),
+                            sizeof(DWORD), 0, nullptr);
+  if(m_pipe == INVALID_HANDLE_VALUE)
+  {
+    deinit();
+    throw std::runtime_error("could not create the pipe " + pipe);
+  }
+#else
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if(name.size() >= sizeof(address.sun_path))
+  {
+    deinit();
+    throw std::runtime_error("export socket path too long: " + name);
+  }
+  std::strncpy(address.sun_path, name.c_str(), sizeof(address.sun_path) - 1);
+
+  // a socket file left over from an earlier run would fail the bind
+  unlinkSocket(name);
+  m_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(m_socket < 0 || bind(m_socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(m_socket, 4) != 0)
+  {
+    deinit();
+    throw std::runtime_error("could not listen on " + name);
+  }
+#endif
+
+  m_stop   = false;
+  m_thread = std::thread(&VKDExport::listen, this);
+  PRINTI("VKDExport: listening on {}\n", name);
+}
+
+void VKDExport::deinit()
+{
+  if(m_control)
+  {
+    // connected consumers see the generation change and let go
+    clearRing();
+  }
+
+  if(m_thread.joinable())
+  {
+    m_stop = true;
+#ifdef _WIN32
+    // wake the listener from ConnectNamedPipe(), if it's serving a consumer the connect fails and it stops afterwards
+    HANDLE const wake = CreateFileA(("\\\\.\\pipe\\" + m_name).c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+    m_thread.join();
+    if(wake != INVALID_HANDLE_VALUE)
+    {
+      CloseHandle(wake);
+    }
+#else
+    m_thread.join();
+#endif
+  }
+
+#ifdef _WIN32
+  if(m_pipe != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(m_pipe);
+    m_pipe = INVALID_HANDLE_VALUE;
+  }
+#else
+  if(m_socket >= 0)
+  {
+    close(m_socket);
+    m_socket = -1;
+    unlinkSocket(m_name);
+  }
+#endif
+
+  if(m_control)
+  {
+#ifdef _WIN32
+    UnmapViewOfFile(m_control);
+#else
+    munmap(m_control, sizeof(Control));
+#endif
+    m_control = nullptr;
+  }
+  VKDPlatform::closeHandle(m_controlHandle);
+}
+
+void VKDExport::setRing(vk::Device device, const Description& description, const std::vector<vk::DeviceMemory>& memories,
+                        const std::vector<vk::DeviceSize>& sizes, const std::vector<Description::Slot>& slots, vk::Semaphore done)
+{
+  if(slots.size() > maxSlots || memories.size() > maxSlots)
+  {
+    PRINTW("VKDExport: more than {} interop textures, not exporting them\n", maxSlots);
+    clearRing();
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  closeHandles();
+
+  auto& d           = m_description;
+  d.format          = description.format;
+  d.width           = description.width;
+  d.height          = description.height;
+  d.usage           = description.usage;
+  d.layout          = description.layout;
+  d.upperLeftOrigin = description.upperLeftOrigin;
+  d.slotCount       = uint32_t(slots.size());
+  d.memoryCount     = uint32_t(memories.size());
+  std::copy(slots.begin(), slots.end(), d.slots);
+  std::copy(sizes.begin(), sizes.end(), d.memorySizes);
+
+  // handles of their own, per consumer duplicates are made from these
+  for(auto m : memories)
+  {
+    m_handles.push_back(VKDPlatform::exportMemory(device, m));
+  }
+  m_handles.push_back(VKDPlatform::exportSemaphore(device, done));
+
+  for(auto& s : m_control->slots)
+  {
+    s = 0;
+  }
+  m_control->latest = 0;
+  m_control->generation++;
+  PRINTI("VKDExport: {} slots in {} allocations\n", d.slotCount, d.memoryCount);
+}
+
+void VKDExport::clearRing()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  closeHandles();
+  m_description.slotCount   = 0;
+  m_description.memoryCount = 0;
+
+  for(auto& s : m_control->slots)
+  {
+    s = 0;
+  }
+  m_control->latest = 0;
+  m_control->generation++;
+}
+
+void VKDExport::beginFrame(uint32_t slot)
+{
+  // the copy writes only after this, a consumer that still reads the slot sees the change afterwards
+  if(slot < maxSlots)
+  {
+    m_control->slots[slot] = 0;
+  }
+}
+
+void VKDExport::endFrame(uint32_t slot, uint64_t value)
+{
+  if(slot < maxSlots)
+  {
+    m_control->slots[slot] = value;
+    m_control->latestSlot  = slot;
+    m_control->latest      = value;
+  }
+}
+
+bool VKDExport::hasConsumers()
+{
+  auto const     now  = std::chrono::steady_clock::now().time_since_epoch().count();
+  uint64_t const beat = m_control->heartbeat;
+  if(beat != m_heartbeat)
+  {
+    m_heartbeat   = beat;
+    m_lastContact = now;
+  }
+  auto const timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::milliseconds(2 * heartbeatMs));
+  return now - m_lastContact.load() < timeout.count();
+}
+
+void VKDExport::closeHandles()
+{
+  for(auto& h : m_handles)
+  {
+    VKDPlatform::closeHandle(h);
+  }
+  m_handles.clear();
+}
+
+void VKDExport::listen()
+{
+  // runs until deinit(), serves one consumer at a time, never touches the frames
+  while(!m_stop)
+  {
+#ifdef _WIN32
+    bool const connected = ConnectNamedPipe(m_pipe, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED;
+    if(connected && !m_stop)
+    {
+      serve(m_pipe);
+    }
+    DisconnectNamedPipe(m_pipe);
+#else
+    pollfd p{ m_socket, POLLIN, 0 };
+    if(poll(&p, 1, 100) <= 0)
+    {
+      continue;
+    }
+    int connection = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+    if(connection >= 0)
+    {
+      serve(connection);
+      close(connection);
+    }
+#endif
+  }
+}
+
+void VKDExport::serve(VKDPlatform::Handle connection)
+{
+  // m_mutex is only held to copy the description and the handles, the I/O runs without it
+  // so setRing() and clearRing() never wait for a consumer
+  Description d{};
+
+#ifdef _WIN32
+  // handles are per process, duplicate them into the consumer's
+  // ReadFile() on the pipe can't time out, wait until the process id is there
+  DWORD      processId = 0;
+  DWORD      bytes     = 0;
+  DWORD      available = 0;
+  auto const deadline  = std::chrono::steady_clock::now() + ioTimeout;
+  while(!m_stop && PeekNamedPipe(connection, nullptr, 0, nullptr, &available, nullptr) && available < sizeof(processId)
+        && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  if(available < sizeof(processId) || !ReadFile(connection, &processId, sizeof(processId), &bytes, nullptr) || bytes != sizeof(processId))
+  {
+    return;
+  }
+  HANDLE const process = OpenProcess(PROCESS_DUP_HANDLE, FALSE, processId);
+  if(!process)
+  {
+    PRINTW("VKDExport: could not open consumer process {}\n", processId);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex>      lock(m_mutex);
+    std::vector<VKDPlatform::Handle> handles = m_handles;
+    handles.push_back(m_controlHandle);
+    d = m_description;
+    for(size_t i = 0; i < handles.size(); ++i)
+    {
+      HANDLE target = nullptr;
+      DuplicateHandle(GetCurrentProcess(), handles[i], process, &target, 0, FALSE, DUPLICATE_SAME_ACCESS);
+      d.handles[i] = uint64_t(uintptr_t(target));
+    }
+  }
+  CloseHandle(process);
+  // the pipe's buffer holds a description, the write doesn't wait for the consumer
+  if(!WriteFile(connection, &d, sizeof(d), &bytes, nullptr) || bytes != sizeof(d))
+  {
+    PRINTW("VKDExport: could not send the description to consumer process {}\n", processId);
+    return;
+  }
+  FlushFileBuffers(connection);
+  m_lastContact = std::chrono::steady_clock::now().time_since_epoch().count();
+#else
+  // duplicates of the file descriptors, clearRing() may close the originals while they are sent
+  // the control block's lives until deinit() joined this thread
+  std::vector<int> handles;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    d = m_description;
+    for(auto h : m_handles)
+    {
+      int const duplicate = fcntl(h, F_DUPFD_CLOEXEC, 0);
+      if(duplicate < 0)
+      {
+        break;
+      }
+      handles.push_back(duplicate);
+    }
+  }
+  auto closeDuplicates = [&]() {
+    for(auto h : handles)
+    {
+      close(h);
+    }
+  };
+  if(handles.size() != d.memoryCount + (d.slotCount ? 1 : 0))
+  {
+    PRINTW("VKDExport: could not duplicate the handles for a consumer\n");
+    closeDuplicates();
+    return;
+  }
+  handles.push_back(m_controlHandle);
+
+  // SCM_RIGHTS duplicates the file descriptors into the consumer
+  timeval timeout{};
+  timeout.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(ioTimeout).count();
+  setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  iovec iov{ &d, sizeof(d) };
+  char  buffer[CMSG_SPACE(sizeof(int) * (maxSlots + 2))] = {};
+  msghdr message{};
+  message.msg_iov        = &iov;
+  message.msg_iovlen     = 1;
+  message.msg_control    = buffer;
+  message.msg_controllen = CMSG_SPACE(sizeof(int) * handles.size());
+
+  cmsghdr* header    = CMSG_FIRSTHDR(&message);
+  header->cmsg_level = SOL_SOCKET;
+  header->cmsg_type  = SCM_RIGHTS;
+  header->cmsg_len   = CMSG_LEN(sizeof(int) * handles.size());
+  std::memcpy(CMSG_DATA(header), handles.data(), sizeof(int) * handles.size());
+  if(sendmsg(connection, &message, MSG_NOSIGNAL) != ssize_t(sizeof(d)))
+  {
+    PRINTW("VKDExport: could not send the description to a consumer\n");
+  }
+  else
+  {
+    // copies start right away, the consumer's heartbeat keeps them going
+    m_lastContact = std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+  handles.pop_back();
+  closeDuplicates();
+#endif
+}
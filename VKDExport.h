@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+#pragma once
+
+// export of copies of the frames to consumer processes on the same GPU, used by VKDirectDisplay with Config::exportName
+// Linux:   unix domain socket at exportName, the file descriptors are passed with SCM_RIGHTS
+// Windows: named pipe \\.\pipe\<exportName>, the consumer writes its process id first and gets duplicated handles
+//
+// a consumer connects and receives a Description, followed on Linux by the file descriptors
+// (memories, the producer's timeline semaphore, control block, in that order), then the connection is closed
+// it imports the memories and the semaphore into a VK device on the GPU with Description::deviceUUID,
+// creates images with the parameters in the description, binds them at Description::slots
+// and maps the control block. the slots are copies only consumers read, the producer copies each frame
+// into one and keeps them in Description::layout. to sample the newest frame:
+// * s = Control::latestSlot, v = Control::slots[s], nothing to sample if v is 0
+// * on the GPU: wait for the semaphore to reach v, read the image of slot s in Description::layout,
+//   never transition it (a barrier with equal old and new layout is fine)
+// * once that's done, the frame is valid if Control::slots[s] is still v, otherwise the producer copied a newer frame into it meanwhile
+// * increment Control::heartbeat at least every heartbeatMs, the producer only copies frames while it changes
+// the producer never waits for consumers. consumers connect again when Control::generation changes
+
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+
+#include <include_gl.h>
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "VKDPlatform.h"
+
+class VKDExport
+{
+public:
+  static constexpr uint32_t magic    = 0x564b4445;  // 'VKDE'
+  static constexpr uint32_t version  = 1;
+  static constexpr uint32_t maxSlots = 8;
+  static constexpr uint32_t heartbeatMs = 1000;
+
+  // sent to each consumer, plain data
+  struct Description
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t  deviceUUID[VK_UUID_SIZE];
+    uint8_t  driverUUID[VK_UUID_SIZE];
+
+    // image parameters of the slots: 2D, one mip level and layer, optimal tiling, exclusive,
+    // VKDPlatform::memoryHandleType in vk::ExternalMemoryImageCreateInfo
+    uint32_t format;           // VkFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t usage;            // VkImageUsageFlags
+    uint32_t layout;           // VkImageLayout the slots are always in
+    uint32_t upperLeftOrigin;  // 1: GL rendered upside down, see VKDirectDisplay::isUpperLeftOrigin()
+
+    // 0 while there's no ring, e.g. during a rebuild, connect again later
+    uint32_t slotCount;
+    uint32_t memoryCount;
+    struct Slot
+    {
+      uint32_t memory;     // index into the memories
+      uint32_t dedicated;  // 1: imported with vk::MemoryDedicatedAllocateInfo for the slot's image
+      uint64_t offset;
+    } slots[maxSlots];
+    uint64_t memorySizes[maxSlots];
+    uint64_t controlSize;
+
+    // Windows: handles valid in the consumer process, memories, semaphore, control block
+    uint64_t handles[maxSlots + 2];
+  };
+
+  // shared memory, written by the producer except for heartbeat
+  struct Control
+  {
+    uint32_t              magic;
+    uint32_t              version;
+    std::atomic<uint32_t> generation;      // changes whenever the ring is rebuilt
+    std::atomic<uint32_t> latestSlot;
+    std::atomic<uint64_t> latest;          // newest frame copied, 0: none
+    std::atomic<uint64_t> slots[maxSlots]; // frame in the slot, 0 while the producer copies into it
+    std::atomic<uint64_t> heartbeat;       // incremented by the consumers while they read
+  };
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "the control block needs lock free 64 bit atomics");
+
+  // creates the control block and starts listening on name, throws on failure
+  void init(const std::string& name, vk::PhysicalDevice gpu);
+  void deinit();
+  bool isActive() const { return m_control != nullptr; }
+
+  // the images consumers get from now on, exports new handles for them and for done, which reaches
+  // a frame's value once it's copied into its slot
+  // format, extent, usage, layout and origin are taken from description, the rest is filled in
+  // at most maxSlots slots and memories, nothing is exported otherwise
+  void setRing(vk::Device device, const Description& description, const std::vector<vk::DeviceMemory>& memories,
+               const std::vector<vk::DeviceSize>& sizes, const std::vector<Description::Slot>& slots, vk::Semaphore done);
+  // consumers have to let go of the ring, call before destroying it
+  void clearRing();
+
+  // presenting thread: the copy into slot is about to be submitted, and frame value is submitted into slot
+  void beginFrame(uint32_t slot);
+  void endFrame(uint32_t slot, uint64_t value);
+  // presenting thread: true if a consumer connected or sent a heartbeat within the last two heartbeatMs,
+  // copying frames nobody reads is a waste of bandwidth
+  bool hasConsumers();
+
+private:
+  Description                      m_description{};
+  std::vector<VKDPlatform::Handle> m_handles;  // memories, semaphore
+  std::mutex                       m_mutex;    // m_description and m_handles, the listener thread reads them
+  Control*                         m_control{ nullptr };
+  VKDPlatform::Handle              m_controlHandle{ VKDPlatform::invalidHandle };
+  std::string                      m_name;
+  std::thread                      m_thread;
+  std::atomic<bool>                m_stop{ false };
+  std::atomic<int64_t>             m_lastContact{ 0 };  // steady clock ticks of the last handshake or heartbeat change
+  uint64_t                         m_heartbeat{ 0 };    // last Control::heartbeat seen, presenting thread only
+#ifdef _WIN32
+  HANDLE m_pipe{ INVALID_HANDLE_VALUE };
+#else
+  int m_socket{ -1 };
+#endif
+
+  void closeHandles();
+  void listen();
+  void serve(VKDPlatform::Handle connection);
+};
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+#include "VKDPlatform.h"
+
+#include <nvh/nvprint.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+const std::vector<const char*>& VKDPlatform::getInstanceExtensions()
+{
+#ifdef _WIN32
+  static const std::vector<const char*> extensions;
+#else
+  static const std::vector<const char*> extensions = {
+#ifdef VK_USE_PLATFORM_XLIB_XRANDR_EXT
+    VK_EXT_ACQUIRE_XLIB_DISPLAY_EXTENSION_NAME,
+#endif
+    VK_EXT_ACQUIRE_DRM_DISPLAY_EXTENSION_NAME
+  };
+#endif
+  return extensions;
+}
+
+vk::DeviceSize VKDPlatform::alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+bool VKDPlatform::hasDeviceExtension(vk::PhysicalDevice gpu, const char* name, const vk::DispatchLoaderDynamic& d)
+{
+  auto const extensions = gpu.enumerateDeviceExtensionProperties(nullptr, d);
+  return std::any_of(extensions.begin(), extensions.end(),
+                     [&](const vk::ExtensionProperties& e) { return std::strcmp(e.extensionName, name) == 0; });
+}
+
+uint32_t VKDPlatform::findMemoryType(vk::PhysicalDevice gpu, uint32_t typeFilter, vk::MemoryPropertyFlags properties, const vk::DispatchLoaderDynamic& d)
+{
+  vk::PhysicalDeviceMemoryProperties memProperties = gpu.getMemoryProperties(d);
+
+  for(uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+  {
+    if((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+    {
+      return i;
+    }
+  }
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+GLenum VKDPlatform::getGLFormat(vk::Format format)
+{
+  switch(format)
+  {
+    case vk::Format::eR8G8B8A8Unorm:
+      return GL_RGBA8;
+    case vk::Format::eR8G8B8A8Srgb:
+      return GL_SRGB8_ALPHA8;
+    case vk::Format::eA2B10G10R10UnormPack32:
+      return GL_RGB10_A2;
+    case vk::Format::eR16G16B16A16Sfloat:
+      return GL_RGBA16F;
+    default:
+      // there's no GL internal format for BGRA channel order
+      return 0;
+  }
+}
+
+const std::vector<const char*>& VKDPlatform::getDeviceExtensions()
+{
+#ifdef _WIN32
+  static const std::vector<const char*> extensions = {
+    VK_KHR_EXTERNAL_MEMORY_WIN32_EXTENSION_NAME,
+    VK_KHR_EXTERNAL_SEMAPHORE_WIN32_EXTENSION_NAME,
+    VK_NV_ACQUIRE_WINRT_DISPLAY_EXTENSION_NAME
+  };
+#else
+  static const std::vector<const char*> extensions = {
+    VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME,
+    VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME
+  };
+#endif
+  return extensions;
+}
+
+VKDPlatform::Handle VKDPlatform::exportMemory(vk::Device device, vk::DeviceMemory memory, const vk::DispatchLoaderDynamic& d)
+{
+#ifdef _WIN32
+  vk::MemoryGetWin32HandleInfoKHR getHandleInfo{ memory, memoryHandleType };
+  return device.getMemoryWin32HandleKHR(getHandleInfo, d);
+#else
+  vk::MemoryGetFdInfoKHR getFdInfo{ memory, memoryHandleType };
+  return device.getMemoryFdKHR(getFdInfo, d);
+#endif
+}
+
+VKDPlatform::Handle VKDPlatform::exportSemaphore(vk::Device device, vk::Semaphore semaphore, const vk::DispatchLoaderDynamic& d)
+{
+#ifdef _WIN32
+  vk::SemaphoreGetWin32HandleInfoKHR getHandleInfo{ semaphore, semaphoreHandleType };
+  return device.getSemaphoreWin32HandleKHR(getHandleInfo, d);
+#else
+  vk::SemaphoreGetFdInfoKHR getFdInfo{ semaphore, semaphoreHandleType };
+  return device.getSemaphoreFdKHR(getFdInfo, d);
+#endif
+}
+
+void VKDPlatform::importMemory(GLuint memoryObject, GLuint64 size, Handle& h)
+{
+#ifdef _WIN32
+  glImportMemoryWin32HandleEXT(memoryObject, size, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, h);
+#else
+  // GL_EXT_memory_object_fd
+  glImportMemoryFdEXT(memoryObject, size, GL_HANDLE_TYPE_OPAQUE_FD_EXT, h);
+  h = invalidHandle;
+#endif
+}
+
+void VKDPlatform::importSemaphore(GLuint semaphore, Handle& h)
+{
+#ifdef _WIN32
+  glImportSemaphoreWin32HandleEXT(semaphore, GL_HANDLE_TYPE_OPAQUE_WIN32_EXT, h);
+#else
+  // GL_EXT_semaphore_fd
+  glImportSemaphoreFdEXT(semaphore, GL_HANDLE_TYPE_OPAQUE_FD_EXT, h);
+  h = invalidHandle;
+#endif
+}
+
+void VKDPlatform::closeHandle(Handle& h)
+{
+  if(h == invalidHandle)
+  {
+    return;
+  }
+#ifdef _WIN32
+  CloseHandle(h);
+#else
+  close(h);
+#endif
+  h = invalidHandle;
+}
+
+void VKDPlatform::acquireDisplay(vk::PhysicalDevice gpu, vk::DisplayKHR display)
+{
+#ifdef _WIN32
+  // VK_NV_acquire_winrt_display
+  // the display has to be removed from the desktop first
+  gpu.acquireWinrtDisplayNV(display);
+#else
+#ifdef VK_USE_PLATFORM_XLIB_XRANDR_EXT
+  // a running X server holds DRM master, it has to hand out the display
+  if(std::getenv("DISPLAY") && VULKAN_HPP_DEFAULT_DISPATCHER.vkAcquireXlibDisplayEXT)
+  {
+    if(!m_xDisplay)
+    {
+      m_xDisplay = XOpenDisplay(nullptr);
+    }
+    if(m_xDisplay
+       && VULKAN_HPP_DEFAULT_DISPATCHER.vkAcquireXlibDisplayEXT(gpu, static_cast<::Display*>(m_xDisplay), display) == VK_SUCCESS)
+    {
+      return;
+    }
+    PRINTW("VKDPlatform: X server didn't release the display, trying DRM\n");
+  }
+#endif
+
+  // VK_EXT_acquire_drm_display
+  // needs DRM master on the primary node of the GPU, i.e. no display server running on it
+  if(!VULKAN_HPP_DEFAULT_DISPATCHER.vkAcquireDrmDisplayEXT)
+  {
+    PRINTW("VKDPlatform: VK_EXT_acquire_drm_display not available, using the display unacquired\n");
+    return;
+  }
+  if(m_drmFd < 0)
+  {
+    // VK_EXT_physical_device_drm names the node, card0 otherwise
+    std::string node = "/dev/dri/card0";
+    auto const  extensions = gpu.enumerateDeviceExtensionProperties();
+    bool const  hasDrm     = std::any_of(extensions.begin(), extensions.end(), [](const vk::ExtensionProperties& e) {
+      return std::string(VK_EXT_PHYSICAL_DEVICE_DRM_EXTENSION_NAME) == e.extensionName;
+    });
+    if(hasDrm)
+    {
+      auto const properties = gpu.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDrmPropertiesEXT>();
+      auto const& drm       = properties.get<vk::PhysicalDeviceDrmPropertiesEXT>();
+      if(drm.hasPrimary)
+      {
+        node = "/dev/dri/card" + std::to_string(drm.primaryMinor);
+      }
+    }
+    m_drmFd = open(node.c_str(), O_RDWR | O_CLOEXEC);
+    if(m_drmFd < 0)
+    {
+      PRINTW("VKDPlatform: could not open {}, using the display unacquired\n", node);
+      return;
+    }
+  }
+  if(VULKAN_HPP_DEFAULT_DISPATCHER.vkAcquireDrmDisplayEXT(gpu, m_drmFd, display) != VK_SUCCESS)
+  {
+    // VK_KHR_display still works if nothing else drives the display
+    PRINTW("VKDPlatform: vkAcquireDrmDisplayEXT failed, using the display unacquired\n");
+  }
+#endif
+}
+
+void VKDPlatform::shutdown()
+{
+#ifndef _WIN32
+  if(m_drmFd >= 0)
+  {
+    close(m_drmFd);
+    m_drmFd = -1;
+  }
+#ifdef VK_USE_PLATFORM_XLIB_XRANDR_EXT
+  if(m_xDisplay)
+  {
+    XCloseDisplay(static_cast<::Display*>(m_xDisplay));
+    m_xDisplay = nullptr;
+  }
+#endif
+#endif
+}
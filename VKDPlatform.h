@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+#pragma once
+
+// platform specific parts of VKDirectDisplay
+// Windows: Win32 handles for the GL/VK interop, displays acquired through VK_NV_acquire_winrt_display
+// Linux:   opaque file descriptors for the GL/VK interop, displays acquired through
+//          VK_EXT_acquire_xlib_display (if built with VK_USE_PLATFORM_XLIB_XRANDR_EXT) or VK_EXT_acquire_drm_display
+
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+
+#include <include_gl.h>
+#include <vulkan/vulkan.hpp>
+#ifdef _WIN32
+#include <vulkan/vulkan_win32.h>
+#endif
+
+#include <vector>
+
+class VKDPlatform
+{
+public:
+  // exported memory and semaphores
+#ifdef _WIN32
+  using Handle = HANDLE;
+  static constexpr Handle invalidHandle = nullptr;
+  static constexpr vk::ExternalMemoryHandleTypeFlagBits    memoryHandleType    = vk::ExternalMemoryHandleTypeFlagBits::eOpaqueWin32;
+  static constexpr vk::ExternalSemaphoreHandleTypeFlagBits semaphoreHandleType = vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueWin32;
+#else
+  using Handle = int;
+  static constexpr Handle invalidHandle = -1;
+  static constexpr vk::ExternalMemoryHandleTypeFlagBits    memoryHandleType    = vk::ExternalMemoryHandleTypeFlagBits::eOpaqueFd;
+  static constexpr vk::ExternalSemaphoreHandleTypeFlagBits semaphoreHandleType = vk::ExternalSemaphoreHandleTypeFlagBits::eOpaqueFd;
+#endif
+
+  // enabled if available, needed to acquire displays
+  static const std::vector<const char*>& getInstanceExtensions();
+  // required
+  static const std::vector<const char*>& getDeviceExtensions();
+
+  // d: entry points of the device, for devices other than the one the default dispatcher was initialized with
+  static Handle exportMemory(vk::Device device, vk::DeviceMemory memory, const vk::DispatchLoaderDynamic& d = VULKAN_HPP_DEFAULT_DISPATCHER);
+  static Handle exportSemaphore(vk::Device device, vk::Semaphore semaphore, const vk::DispatchLoaderDynamic& d = VULKAN_HPP_DEFAULT_DISPATCHER);
+
+  // a file descriptor is owned by GL after the import, h is invalid then
+  // a Win32 handle stays with the caller and has to be closed with closeHandle()
+  static void importMemory(GLuint memoryObject, GLuint64 size, Handle& h);
+  static void importSemaphore(GLuint semaphore, Handle& h);
+  static void closeHandle(Handle& h);
+
+  // helpers shared by VKDirectDisplay, VKDTransfer and VKDRenderer
+  static vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment);
+  static bool           hasDeviceExtension(vk::PhysicalDevice gpu, const char* name, const vk::DispatchLoaderDynamic& d = VULKAN_HPP_DEFAULT_DISPATCHER);
+  static uint32_t       findMemoryType(vk::PhysicalDevice gpu, uint32_t typeFilter, vk::MemoryPropertyFlags properties,
+                                       const vk::DispatchLoaderDynamic& d = VULKAN_HPP_DEFAULT_DISPATCHER);
+  // GL internal format that can share memory with a VK image of this format, 0 if there's none
+  static GLenum getGLFormat(vk::Format format);
+
+  // exclusive access to a display, released with vk::PhysicalDevice::releaseDisplayEXT()
+  void acquireDisplay(vk::PhysicalDevice gpu, vk::DisplayKHR display);
+  // call after all displays are released
+  void shutdown();
+
+private:
+  int   m_drmFd{ -1 };          // VK_EXT_acquire_drm_display, primary node of the GPU
+  void* m_xDisplay{ nullptr };  // VK_EXT_acquire_xlib_display
+};
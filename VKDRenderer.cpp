@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+
+#include "VKDRenderer.h"
+#include "VKDPlatform.h"
+
+#include <nvh/nvprint.hpp>
+#include <nvpsystem.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+// the C++ structs in common.h are padded to the std140 layout of the GLSL blocks, memcpy'd as is
+static_assert(offsetof(SceneData, lightPos_world) == 192 && offsetof(SceneData, eyepos_world) == 208
+                  && offsetof(SceneData, eyePos_view) == 224 && offsetof(SceneData, backgroundColor) == 240
+                  && offsetof(SceneData, fragmentLoad) == 252 && offsetof(SceneData, projNear) == 256 && offsetof(SceneData, projFar) == 260,
+              "SceneData doesn't match the std140 layout");
+static_assert(offsetof(ObjectData, color) == 256, "ObjectData doesn't match the std140 layout");
+static_assert(sizeof(SceneData) % 16 == 0 && sizeof(ObjectData) % 16 == 0, "std140 struct sizes are multiples of 16 bytes");
+
+template <typename T>
+vk::DeviceSize uniformStride(vk::DeviceSize alignment)
+{
+  return VKDPlatform::alignUp(sizeof(T), alignment);
+}
+}  // namespace
+
+void VKDRenderer::init(vk::PhysicalDevice gpu, vk::Device device, uint32_t queueFamily, vk::Queue queue)
+{
+  m_gpu         = gpu;
+  m_device      = device;
+  m_queueFamily = queueFamily;
+  m_queue       = queue;
+
+  // the GL shaders, VULKAN is defined by the compiler and selects the few differences
+  m_shaderManager.init(m_device, 1, 2);
+  m_shaderManager.addDirectory(std::string(PROJECT_NAME));
+  m_shaderManager.addDirectory(NVPSystem::exePath() + std::string(PROJECT_RELDIRECTORY));
+  m_shaderManager.registerInclude("common.h", "common.h");
+  m_shaderManager.registerInclude("noise.glsl", "noise.glsl");
+  m_vertexShader   = m_shaderManager.createShaderModule(VK_SHADER_STAGE_VERTEX_BIT, "scene.vert.glsl", "#define USE_SCENE_DATA\n");
+  m_fragmentShader = m_shaderManager.createShaderModule(VK_SHADER_STAGE_FRAGMENT_BIT, "scene.frag.glsl", "#define USE_SCENE_DATA\n");
+  if(!m_shaderManager.areShaderModulesValid())
+  {
+    throw std::runtime_error("failed to compile the scene shaders!");
+  }
+
+  vk::CommandPoolCreateInfo commandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eResetCommandBuffer, m_queueFamily };
+  m_commandPool = m_device.createCommandPoolUnique(commandPoolCreateInfo);
+
+  // scene and object UBO as in GL, the object UBO moves through the per frame uniform buffer with dynamic offsets
+  std::array<vk::DescriptorSetLayoutBinding, 2> bindings{
+      vk::DescriptorSetLayoutBinding{ UBO_SCENE, vk::DescriptorType::eUniformBuffer, 1,
+                                      vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment },
+      vk::DescriptorSetLayoutBinding{ UBO_OBJECT, vk::DescriptorType::eUniformBufferDynamic, 1,
+                                      vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment } };
+  m_descriptorSetLayout = m_device.createDescriptorSetLayoutUnique({ {}, bindings });
+  vk::DescriptorSetLayout setLayout = m_descriptorSetLayout.get();
+  m_pipelineLayout      = m_device.createPipelineLayoutUnique({ {}, setLayout });
+
+  auto const alignment = m_gpu.getProperties().limits.minUniformBufferOffsetAlignment;
+  m_sceneStride        = uniformStride<SceneData>(alignment);
+  m_objectStride       = uniformStride<ObjectData>(alignment);
+
+  // a depth format every implementation supports as attachment
+  for(auto format : { vk::Format::eD32Sfloat, vk::Format::eX8D24UnormPack32, vk::Format::eD24UnormS8Uint })
+  {
+    if(m_gpu.getFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment)
+    {
+      m_depthFormat = format;
+      break;
+    }
+  }
+}
+
+void VKDRenderer::deinit()
+{
+  if(!m_device)
+  {
+    return;
+  }
+
+  m_passes.clear();
+  m_targets.clear();
+  m_frames.clear();
+  m_vertices = Buffer();
+  m_indices  = Buffer();
+  m_descriptorPool.reset();
+  m_pipelineLayout.reset();
+  m_descriptorSetLayout.reset();
+  m_commandPool.reset();
+  m_shaderManager.deinit();
+  m_device = nullptr;
+  m_gpu    = nullptr;
+}
+
+void VKDRenderer::createBuffer(Buffer& b, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
+{
+  b          = Buffer();
+  b.size     = size;
+  b.buffer   = m_device.createBufferUnique({ {}, size, usage, vk::SharingMode::eExclusive });
+  auto const requirements = m_device.getBufferMemoryRequirements(b.buffer.get());
+  b.memory   = m_device.allocateMemoryUnique({ requirements.size, VKDPlatform::findMemoryType(m_gpu, requirements.memoryTypeBits, properties) });
+  m_device.bindBufferMemory(b.buffer.get(), b.memory.get(), 0);
+  if(properties & vk::MemoryPropertyFlagBits::eHostVisible)
+  {
+    b.mapped = m_device.mapMemory(b.memory.get(), 0, VK_WHOLE_SIZE);
+  }
+}
+
+void VKDRenderer::upload(Buffer& b, const void* data, vk::DeviceSize size, vk::BufferUsageFlags usage)
+{
+  // device local, filled through a staging buffer
+  Buffer staging;
+  createBuffer(staging, size, vk::BufferUsageFlagBits::eTransferSrc,
+               vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+  memcpy(staging.mapped, data, size_t(size));
+  createBuffer(b, size, usage | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+  auto buf = m_device.allocateCommandBuffers({ m_commandPool.get(), vk::CommandBufferLevel::ePrimary, 1 })[0];
+  buf.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+  buf.copyBuffer(staging.buffer.get(), b.buffer.get(), vk::BufferCopy{ 0, 0, size });
+  buf.end();
+  m_queue.submit(vk::SubmitInfo{ {}, {}, buf });
+  m_queue.waitIdle();
+  m_device.freeCommandBuffers(m_commandPool.get(), buf);
+}
+
+void VKDRenderer::setGeometry(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<uint32_t>& indices)
+{
+  m_device.waitIdle();
+
+  std::vector<glm::vec3> vertices(positions);
+  vertices.insert(vertices.end(), normals.begin(), normals.end());
+  m_normalOffset = positions.size() * sizeof(glm::vec3);
+  upload(m_vertices, vertices.data(), vertices.size() * sizeof(glm::vec3), vk::BufferUsageFlagBits::eVertexBuffer);
+  upload(m_indices, indices.data(), indices.size() * sizeof(uint32_t), vk::BufferUsageFlagBits::eIndexBuffer);
+}
+
+void VKDRenderer::createUniforms(Frame& f, uint32_t capacity)
+{
+  // persistently mapped, written by the CPU each frame
+  f.capacity = capacity;
+  createBuffer(f.uniforms, m_sceneStride + capacity * m_objectStride, vk::BufferUsageFlagBits::eUniformBuffer,
+               vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+  std::array<vk::DescriptorBufferInfo, 2> bufferInfos{ vk::DescriptorBufferInfo{ f.uniforms.buffer.get(), 0, m_sceneStride },
+                                                       vk::DescriptorBufferInfo{ f.uniforms.buffer.get(), m_sceneStride, m_objectStride } };
+  std::array<vk::WriteDescriptorSet, 2> writes{
+      vk::WriteDescriptorSet{ f.descriptorSet, UBO_SCENE, 0, vk::DescriptorType::eUniformBuffer, {}, bufferInfos[0] },
+      vk::WriteDescriptorSet{ f.descriptorSet, UBO_OBJECT, 0, vk::DescriptorType::eUniformBufferDynamic, {}, bufferInfos[1] } };
+  m_device.updateDescriptorSets(writes, {});
+}
+
+void VKDRenderer::setFramesInFlight(uint32_t count)
+{
+  if(!m_frames.empty())
+  {
+    std::vector<vk::CommandBuffer> buffers;
+    for(auto& f : m_frames)
+    {
+      buffers.push_back(f.commandBuffer);
+    }
+    m_device.freeCommandBuffers(m_commandPool.get(), buffers);
+  }
+  m_frames.clear();
+  m_frames.resize(count);
+
+  std::array<vk::DescriptorPoolSize, 2> poolSizes{ vk::DescriptorPoolSize{ vk::DescriptorType::eUniformBuffer, count },
+                                                   vk::DescriptorPoolSize{ vk::DescriptorType::eUniformBufferDynamic, count } };
+  m_descriptorPool = m_device.createDescriptorPoolUnique({ {}, count, poolSizes });
+
+  std::vector<vk::DescriptorSetLayout> layouts(count, m_descriptorSetLayout.get());
+  auto const sets     = m_device.allocateDescriptorSets({ m_descriptorPool.get(), layouts });
+  auto const commands = m_device.allocateCommandBuffers({ m_commandPool.get(), vk::CommandBufferLevel::ePrimary, count });
+  for(uint32_t i = 0; i < count; ++i)
+  {
+    m_frames[i].commandBuffer = commands[i];
+    m_frames[i].descriptorSet = sets[i];
+    createUniforms(m_frames[i], 64);
+  }
+}
+
+vk::UniquePipeline VKDRenderer::createPipeline(vk::RenderPass renderPass)
+{
+  std::array<vk::PipelineShaderStageCreateInfo, 2> stages{
+      vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eVertex, m_shaderManager.get(m_vertexShader), "main" },
+      vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eFragment, m_shaderManager.get(m_fragmentShader), "main" } };
+
+  // positions and normals in two ranges of the same buffer, as in GL
+  std::array<vk::VertexInputBindingDescription, 2> vertexBindings{
+      vk::VertexInputBindingDescription{ VERTEX_POS, sizeof(glm::vec3), vk::VertexInputRate::eVertex },
+      vk::VertexInputBindingDescription{ VERTEX_NORMAL, sizeof(glm::vec3), vk::VertexInputRate::eVertex } };
+  std::array<vk::VertexInputAttributeDescription, 2> vertexAttributes{
+      vk::VertexInputAttributeDescription{ VERTEX_POS, VERTEX_POS, vk::Format::eR32G32B32Sfloat, 0 },
+      vk::VertexInputAttributeDescription{ VERTEX_NORMAL, VERTEX_NORMAL, vk::Format::eR32G32B32Sfloat, 0 } };
+  vk::PipelineVertexInputStateCreateInfo   vertexInput{ {}, vertexBindings, vertexAttributes };
+  vk::PipelineInputAssemblyStateCreateInfo inputAssembly{ {}, vk::PrimitiveTopology::eTriangleList };
+  vk::PipelineViewportStateCreateInfo      viewport{ {}, 1, nullptr, 1, nullptr };
+
+  // the viewport is flipped to GL orientation, so the GL winding applies
+  vk::PipelineRasterizationStateCreateInfo rasterization{ {}, VK_FALSE, VK_FALSE, vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack,
+                                                          vk::FrontFace::eCounterClockwise };
+  rasterization.setLineWidth(1.0f);
+  vk::PipelineMultisampleStateCreateInfo  multisample{ {}, vk::SampleCountFlagBits::e1 };
+  vk::PipelineDepthStencilStateCreateInfo depthStencil{ {}, VK_TRUE, VK_TRUE, vk::CompareOp::eLess };
+
+  vk::PipelineColorBlendAttachmentState blendAttachment{};
+  blendAttachment.setColorWriteMask(vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB
+                                    | vk::ColorComponentFlagBits::eA);
+  vk::PipelineColorBlendStateCreateInfo colorBlend{ {}, VK_FALSE, vk::LogicOp::eCopy, blendAttachment };
+
+  std::array<vk::DynamicState, 2>    dynamicStates{ vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+  vk::PipelineDynamicStateCreateInfo dynamic{ {}, dynamicStates };
+
+  vk::GraphicsPipelineCreateInfo pipelineCreateInfo{ {}, stages, &vertexInput, &inputAssembly, nullptr, &viewport, &rasterization,
+                                                     &multisample, &depthStencil, &colorBlend, &dynamic, m_pipelineLayout.get(), renderPass };
+  auto r = m_device.createGraphicsPipelineUnique(nullptr, pipelineCreateInfo);
+  if(r.result != vk::Result::eSuccess)
+  {
+    throw std::runtime_error("failed to create the scene pipeline!");
+  }
+  return std::move(r.value);
+}
+
+void VKDRenderer::createPass(Pass& p, const Target& t)
+{
+  // the color contents are cleared, the images go to the present layout,
+  // or stay attachments until the explicit release in record()
+  bool const release = m_releaseFamily != VK_QUEUE_FAMILY_IGNORED;
+  std::array<vk::AttachmentDescription, 2> attachments{
+      vk::AttachmentDescription{ {}, t.format, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
+                                 vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined,
+                                 release ? vk::ImageLayout::eColorAttachmentOptimal : vk::ImageLayout::ePresentSrcKHR },
+      vk::AttachmentDescription{ {}, m_depthFormat, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eDontCare,
+                                 vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined,
+                                 vk::ImageLayout::eDepthStencilAttachmentOptimal } };
+  vk::AttachmentReference colorReference{ 0, vk::ImageLayout::eColorAttachmentOptimal };
+  vk::AttachmentReference depthReference{ 1, vk::ImageLayout::eDepthStencilAttachmentOptimal };
+  vk::SubpassDescription  subpass{ {}, vk::PipelineBindPoint::eGraphics, {}, colorReference, {}, &depthReference };
+
+  // the acquire semaphore is waited for at color attachment output, the depth image is reused every frame
+  vk::SubpassDependency dependency{ VK_SUBPASS_EXTERNAL, 0,
+                                    vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests,
+                                    vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests,
+                                    vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                                    vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite };
+  p.renderPass = m_device.createRenderPassUnique({ {}, attachments, subpass, dependency });
+  p.pipeline   = createPipeline(p.renderPass.get());
+
+  vk::ImageCreateInfo depthCreateInfo{ {}, vk::ImageType::e2D, m_depthFormat, vk::Extent3D(t.extent, 1), 1, 1,
+                                       vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal,
+                                       vk::ImageUsageFlagBits::eDepthStencilAttachment };
+  p.depthImage            = m_device.createImageUnique(depthCreateInfo);
+  auto const requirements = m_device.getImageMemoryRequirements(p.depthImage.get());
+  p.depthMemory = m_device.allocateMemoryUnique({ requirements.size, VKDPlatform::findMemoryType(m_gpu, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal) });
+  m_device.bindImageMemory(p.depthImage.get(), p.depthMemory.get(), 0);
+  p.depthView = m_device.createImageViewUnique(
+      { {}, p.depthImage.get(), vk::ImageViewType::e2D, m_depthFormat, {}, { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 } });
+
+  for(auto image : t.images)
+  {
+    p.views.push_back(m_device.createImageViewUnique(
+        { {}, image, vk::ImageViewType::e2D, t.format, {}, { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } }));
+    std::array<vk::ImageView, 2> views{ p.views.back().get(), p.depthView.get() };
+    p.framebuffers.push_back(m_device.createFramebufferUnique({ {}, p.renderPass.get(), views, t.extent.width, t.extent.height, 1 }));
+  }
+}
+
+void VKDRenderer::setTargets(const std::vector<Target>& targets, vk::Extent2D canvas, uint32_t releaseFamily)
+{
+  m_passes.clear();
+  m_targets       = targets;
+  m_canvas        = canvas;
+  m_releaseFamily = releaseFamily;
+  m_passes.resize(m_targets.size());
+  for(size_t i = 0; i < m_targets.size(); ++i)
+  {
+    // outputs without a swapchain are skipped until it's rebuilt
+    if(!m_targets[i].images.empty())
+    {
+      createPass(m_passes[i], m_targets[i]);
+    }
+  }
+}
+
+vk::CommandBuffer VKDRenderer::record(uint32_t frameIndex, const std::vector<TargetImage>& images, const SceneData& scene, const std::vector<Draw>& draws)
+{
+  auto& f = m_frames[frameIndex];
+
+  // the previous submit of this frame is done, its uniform buffer can be replaced or rewritten
+  if(draws.size() > f.capacity)
+  {
+    createUniforms(f, uint32_t(draws.size() * 2));
+  }
+  auto* uniforms = static_cast<uint8_t*>(f.uniforms.mapped);
+  memcpy(uniforms, &scene, sizeof(SceneData));
+  for(size_t i = 0; i < draws.size(); ++i)
+  {
+    memcpy(uniforms + m_sceneStride + i * m_objectStride, &draws[i].object, sizeof(ObjectData));
+  }
+
+  // nothing to draw until setGeometry(), the images are still cleared
+  size_t const numDraws = m_vertices.buffer ? draws.size() : 0;
+
+  auto buf = f.commandBuffer;
+  buf.reset();
+  buf.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+
+  auto const&                   background = scene.backgroundColor;
+  std::array<vk::ClearValue, 2> clearValues{ vk::ClearColorValue(std::array<float, 4>{ background.r, background.g, background.b, 0.0f }),
+                                             vk::ClearDepthStencilValue(1.0f, 0) };
+  for(const auto& ti : images)
+  {
+    auto const& t = m_targets[ti.target];
+    auto const& p = m_passes[ti.target];
+
+    buf.beginRenderPass({ p.renderPass.get(), p.framebuffers[ti.image].get(), vk::Rect2D{ {}, t.extent }, clearValues },
+                        vk::SubpassContents::eInline);
+
+    // the whole canvas, shifted so the target's region lands on its image, with a GL lower left origin
+    vk::Viewport viewport{ float(-t.offset.x), float(int32_t(m_canvas.height) - t.offset.y), float(m_canvas.width),
+                           -float(m_canvas.height), 0.0f, 1.0f };
+    buf.setViewport(0, viewport);
+    buf.setScissor(0, vk::Rect2D{ {}, t.extent });
+
+    buf.bindPipeline(vk::PipelineBindPoint::eGraphics, p.pipeline.get());
+    buf.bindVertexBuffers(0, { m_vertices.buffer.get(), m_vertices.buffer.get() }, { vk::DeviceSize(0), m_normalOffset });
+    buf.bindIndexBuffer(m_indices.buffer.get(), 0, vk::IndexType::eUint32);
+    for(size_t i = 0; i < numDraws; ++i)
+    {
+      uint32_t const offset = uint32_t(i * m_objectStride);
+      buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_pipelineLayout.get(), 0, f.descriptorSet, offset);
+      buf.drawIndexed(draws[i].count, 1, 0, 0, 0);
+    }
+
+    buf.endRenderPass();
+
+    if(m_releaseFamily != VK_QUEUE_FAMILY_IGNORED)
+    {
+      // release to the present family, which acquires it with the matching barrier
+      vk::ImageMemoryBarrier barrier{ vk::AccessFlagBits::eColorAttachmentWrite, vk::AccessFlagBits::eNone,
+                                      vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR,
+                                      m_queueFamily, m_releaseFamily, t.images[ti.image],
+                                      { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
+      buf.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier);
+    }
+  }
+
+  buf.end();
+  return buf;
+}
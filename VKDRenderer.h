@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+#pragma once
+
+// native Vulkan version of the GL scene, renders the tori straight into the swapchain images
+// same shaders (compiled to SPIR-V), same SceneData / ObjectData layouts, same geometry and placement
+// used by VKDirectDisplay with Config::nativeRenderer, to compare against the GL interop path
+
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+
+#include <vulkan/vulkan.hpp>
+#include <nvvk/shadermodulemanager_vk.hpp>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "common.h"
+
+class VKDRenderer
+{
+public:
+  // one torus, count is the number of indices to draw
+  struct Draw
+  {
+    ObjectData object;
+    uint32_t   count;
+  };
+
+  // swapchain images of one output, which shows its region of the canvas the scene is laid out on
+  struct Target
+  {
+    std::vector<vk::Image> images;
+    vk::Format             format;
+    vk::Extent2D           extent;
+    vk::Offset2D           offset;
+  };
+
+  // swapchain image of a target rendered in a frame
+  struct TargetImage
+  {
+    uint32_t target;
+    uint32_t image;
+  };
+
+  // compiles the shaders, throws on failure
+  // all commands are recorded for and submitted to the given queue
+  void init(vk::PhysicalDevice gpu, vk::Device device, uint32_t queueFamily, vk::Queue queue);
+  void deinit();
+
+  // vertex positions followed by normals, like the GL vertex buffer
+  // waits for the device to be idle
+  void setGeometry(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const std::vector<uint32_t>& indices);
+
+  // per frame command buffers and uniform buffers, call when no frame is in flight
+  void setFramesInFlight(uint32_t count);
+
+  // render passes, pipelines and framebuffers for the swapchain images, call when no frame is in flight
+  // releaseFamily: the images are handed to this queue family at the end of the frame, VK_QUEUE_FAMILY_IGNORED if not
+  void setTargets(const std::vector<Target>& targets, vk::Extent2D canvas, uint32_t releaseFamily);
+
+  // records the frame into the command buffer of frameIndex, whose previous submit has to be finished
+  // the images end up in the present layout, or the color attachment layout if they are released to another family
+  vk::CommandBuffer record(uint32_t frameIndex, const std::vector<TargetImage>& images, const SceneData& scene, const std::vector<Draw>& draws);
+
+private:
+  struct Buffer
+  {
+    vk::UniqueBuffer       buffer;
+    vk::UniqueDeviceMemory memory;
+    vk::DeviceSize         size{ 0 };
+    void*                  mapped{ nullptr };
+  };
+
+  // per frame in flight
+  struct Frame
+  {
+    vk::CommandBuffer commandBuffer;
+    Buffer            uniforms;   // SceneData, followed by one ObjectData per draw
+    uint32_t          capacity{ 0 };  // draws that fit into uniforms
+    vk::DescriptorSet descriptorSet;
+  };
+
+  // per target
+  struct Pass
+  {
+    vk::UniqueRenderPass                 renderPass;
+    vk::UniquePipeline                   pipeline;
+    vk::UniqueImage                      depthImage;
+    vk::UniqueDeviceMemory               depthMemory;
+    vk::UniqueImageView                  depthView;
+    std::vector<vk::UniqueImageView>     views;
+    std::vector<vk::UniqueFramebuffer>   framebuffers;
+  };
+
+  vk::PhysicalDevice             m_gpu;
+  vk::Device                     m_device;
+  uint32_t                       m_queueFamily{ 0 };
+  vk::Queue                      m_queue;
+  nvvk::ShaderModuleManager      m_shaderManager;
+  nvvk::ShaderModuleID           m_vertexShader;
+  nvvk::ShaderModuleID           m_fragmentShader;
+  vk::UniqueCommandPool          m_commandPool;
+  vk::UniqueDescriptorSetLayout  m_descriptorSetLayout;
+  vk::UniquePipelineLayout       m_pipelineLayout;
+  vk::UniqueDescriptorPool       m_descriptorPool;
+  vk::Format                     m_depthFormat{ vk::Format::eD32Sfloat };
+  vk::DeviceSize                 m_sceneStride{ 0 };   // uniform buffer offsets, aligned to minUniformBufferOffsetAlignment
+  vk::DeviceSize                 m_objectStride{ 0 };
+  Buffer                         m_vertices;
+  Buffer                         m_indices;
+  vk::DeviceSize                 m_normalOffset{ 0 };
+  std::vector<Frame>             m_frames;
+  std::vector<Pass>              m_passes;
+  std::vector<Target>            m_targets;
+  vk::Extent2D                   m_canvas;
+  uint32_t                       m_releaseFamily{ VK_QUEUE_FAMILY_IGNORED };
+
+  void     createBuffer(Buffer& b, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+  void     upload(Buffer& b, const void* data, vk::DeviceSize size, vk::BufferUsageFlags usage);
+  void     createUniforms(Frame& f, uint32_t capacity);
+  void     createPass(Pass& p, const Target& t);
+  vk::UniquePipeline createPipeline(vk::RenderPass renderPass);
+};
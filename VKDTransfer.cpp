@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+
+#include "VKDTransfer.h"
+
+#include <nvh/nvprint.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+// alignment of pointers and sizes imported with VK_EXT_external_memory_host
+vk::DeviceSize getHostAlignment(vk::PhysicalDevice gpu, const vk::DispatchLoaderDynamic& d)
+{
+  auto const props = gpu.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>(d);
+  return props.get<vk::PhysicalDeviceExternalMemoryHostPropertiesEXT>().minImportedHostPointerAlignment;
+}
+}  // namespace
+
+vk::PhysicalDevice VKDTransfer::findGLDevice(vk::Instance instance)
+{
+  // GL_EXT_memory_object
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_DEVICE_UUIDS_EXT, &count);
+  if(count < 1)
+  {
+    return {};
+  }
+
+  // the first device of the context renders
+  GLubyte uuid[GL_UUID_SIZE_EXT] = {};
+  glGetUnsignedBytei_vEXT(GL_DEVICE_UUID_EXT, 0, uuid);
+#ifdef _WIN32
+  // GL_EXT_memory_object_win32
+  GLubyte luid[GL_LUID_SIZE_EXT] = {};
+  glGetUnsignedBytevEXT(GL_DEVICE_LUID_EXT, luid);
+#endif
+
+  for(const auto& gpu : instance.enumeratePhysicalDevices())
+  {
+    auto const  props = gpu.getProperties2KHR<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+    auto const& id    = props.get<vk::PhysicalDeviceIDProperties>();
+    if(std::memcmp(id.deviceUUID.data(), uuid, VK_UUID_SIZE) == 0)
+    {
+      return gpu;
+    }
+#ifdef _WIN32
+    if(id.deviceLUIDValid && std::memcmp(id.deviceLUID.data(), luid, VK_LUID_SIZE) == 0)
+    {
+      return gpu;
+    }
+#endif
+  }
+  return {};
+}
+
+void VKDTransfer::init(vk::Instance instance, vk::PhysicalDevice renderGpu, vk::PhysicalDevice displayGpu, vk::Device displayDevice, bool displayHostImport)
+{
+  // own entry points for the render device, the default dispatcher's device level ones belong to the display device
+  m_dispatch.init(instance, VULKAN_HPP_DEFAULT_DISPATCHER.vkGetInstanceProcAddr);
+  m_gpu           = renderGpu;
+  m_displayGpu    = displayGpu;
+  m_displayDevice = displayDevice;
+
+  std::vector<const char*> extensions = {
+    VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME,
+    VK_KHR_EXTERNAL_SEMAPHORE_EXTENSION_NAME,
+    VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
+  };
+  extensions.insert(extensions.end(), VKDPlatform::getDeviceExtensions().begin(), VKDPlatform::getDeviceExtensions().end());
+  for(const char* name : extensions)
+  {
+    if(!VKDPlatform::hasDeviceExtension(m_gpu, name, m_dispatch))
+    {
+      throw std::runtime_error(std::string("render GPU doesn't support ") + name);
+    }
+  }
+  m_hasDedicated = VKDPlatform::hasDeviceExtension(m_gpu, VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, m_dispatch)
+                   && VKDPlatform::hasDeviceExtension(m_gpu, VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME, m_dispatch);
+  if(m_hasDedicated)
+  {
+    extensions.push_back(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+    extensions.push_back(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+  }
+  m_hostImport = displayHostImport && VKDPlatform::hasDeviceExtension(m_gpu, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME, m_dispatch);
+  if(m_hostImport)
+  {
+    extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+    m_hostAlignment = std::max(getHostAlignment(m_gpu, m_dispatch), getHostAlignment(m_displayGpu, m_dispatch));
+  }
+
+  // a dedicated transfer (DMA) queue copies while the render GPU's graphics queue works on the next frame
+  auto const families = m_gpu.getQueueFamilyProperties(m_dispatch);
+  m_queueFamily       = VK_QUEUE_FAMILY_IGNORED;
+  for(uint32_t i = 0; i < families.size(); ++i)
+  {
+    auto const flags    = families[i].queueFlags;
+    bool const transfer = bool(flags & (vk::QueueFlagBits::eTransfer | vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+    bool const copyOnly = !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
+    if(transfer && (m_queueFamily == VK_QUEUE_FAMILY_IGNORED || copyOnly))
+    {
+      m_queueFamily = i;
+    }
+  }
+  if(m_queueFamily == VK_QUEUE_FAMILY_IGNORED)
+  {
+    throw std::runtime_error("render GPU has no queue that can copy");
+  }
+
+  float                       priority = 1.0f;
+  vk::DeviceQueueCreateInfo   queueCreateInfo{ {}, m_queueFamily, 1, &priority };
+  vk::PhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{ VK_TRUE };
+  vk::DeviceCreateInfo deviceCreateInfo{ {}, 1, &queueCreateInfo, 0, nullptr, uint32_t(extensions.size()), extensions.data() };
+  deviceCreateInfo.setPNext(&timelineFeatures);
+  m_device = m_gpu.createDeviceUnique(deviceCreateInfo, nullptr, m_dispatch);
+  m_dispatch.init(m_device.get());
+  m_queue = m_device->getQueue(m_queueFamily, 0, m_dispatch);
+
+  vk::CommandPoolCreateInfo commandPoolCreateInfo{ {}, m_queueFamily };
+  m_commandPool = m_device->createCommandPoolUnique(commandPoolCreateInfo, nullptr, m_dispatch);
+
+  PRINTI("VKDTransfer: render GPU {}, queue family {}, {}\n", m_gpu.getProperties(m_dispatch).deviceName.data(), m_queueFamily,
+         m_hostImport ? "host memory imported into both GPUs" : "host copy between the GPUs");
+}
+
+void VKDTransfer::deinit()
+{
+  if(!m_device)
+  {
+    return;
+  }
+
+  destroyFrames();
+  m_commandPool.reset();
+  m_device.reset();
+  m_gpu           = nullptr;
+  m_displayGpu    = nullptr;
+  m_displayDevice = nullptr;
+  m_hostImport    = false;
+  m_hostAlignment = 1;
+}
+
+void VKDTransfer::createFrames(uint32_t count, vk::Extent2D extent, vk::Format format, uint32_t texelSize)
+{
+  destroyFrames();
+
+  m_slotSize = VKDPlatform::alignUp(vk::DeviceSize(extent.width) * extent.height * texelSize, m_hostAlignment);
+  m_frames.resize(count);
+
+  vk::CommandBufferAllocateInfo allocateInfo{ m_commandPool.get(), vk::CommandBufferLevel::ePrimary, count + 1 };
+  auto const                    buffers = m_device->allocateCommandBuffers(allocateInfo, m_dispatch);
+
+  // initial layout of all textures in one submit, GL renders into them as color attachments
+  auto init = buffers[count];
+  init.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit }, m_dispatch);
+  for(uint32_t i = 0; i < count; ++i)
+  {
+    auto& f = m_frames[i];
+    createTexture(f, extent, format);
+    createStaging(f);
+    f.commandBuffer = buffers[i];
+    recordCopy(f, extent);
+
+    vk::ImageMemoryBarrier barrier{ {}, {}, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal,
+                                    VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, f.image.get(),
+                                    { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } };
+    init.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, barrier, m_dispatch);
+  }
+  init.end(m_dispatch);
+  vk::SubmitInfo submitInfo{ {}, {}, init };
+  m_queue.submit(submitInfo, nullptr, m_dispatch);
+  m_queue.waitIdle(m_dispatch);
+  m_device->freeCommandBuffers(m_commandPool.get(), init, m_dispatch);
+
+  createSemaphore(m_glDone);
+  createSemaphore(m_copyDone);
+}
+
+void VKDTransfer::destroyFrames()
+{
+  if(!m_device)
+  {
+    return;
+  }
+
+  // GL may still render into the textures, the queue may still copy from them
+  glFinish();
+  m_queue.waitIdle(m_dispatch);
+
+  for(auto& f : m_frames)
+  {
+    glDeleteTextures(1, &f.textureGL);
+    if(f.memoryObject)
+    {
+      glDeleteMemoryObjectsEXT(1, &f.memoryObject);
+    }
+    VKDPlatform::closeHandle(f.handle);
+    if(f.commandBuffer)
+    {
+      m_device->freeCommandBuffers(m_commandPool.get(), f.commandBuffer, m_dispatch);
+    }
+  }
+  // members go in reverse order, the imported memory before the host memory it was imported from
+  m_frames.clear();
+  destroySemaphore(m_glDone);
+  destroySemaphore(m_copyDone);
+}
+
+void VKDTransfer::createTexture(Frame& f, vk::Extent2D extent, vk::Format format)
+{
+  // like VKDirectDisplay::createInteropImage(), with a dedicated allocation each
+  vk::ImageCreateInfo imageCreateInfo{ {},
+                                       vk::ImageType::e2D,
+                                       format,
+                                       vk::Extent3D(extent, 1),
+                                       1,
+                                       1,
+                                       vk::SampleCountFlagBits::e1,
+                                       vk::ImageTiling::eOptimal,
+                                       vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+                                       vk::SharingMode::eExclusive,
+                                       0,
+                                       nullptr,
+                                       vk::ImageLayout::eUndefined };
+  vk::ExternalMemoryImageCreateInfo externalMemoryImageCreateInfo{ VKDPlatform::memoryHandleType };
+  imageCreateInfo.setPNext(&externalMemoryImageCreateInfo);
+  f.image = m_device->createImageUnique(imageCreateInfo, nullptr, m_dispatch);
+
+  auto const             requirements = m_device->getImageMemoryRequirements(f.image.get(), m_dispatch);
+  vk::MemoryAllocateInfo memoryAllocateInfo{ requirements.size,
+                                             VKDPlatform::findMemoryType(m_gpu, requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal, m_dispatch) };
+  vk::ExportMemoryAllocateInfo    exportMemoryAllocateInfo{ VKDPlatform::memoryHandleType };
+  vk::MemoryDedicatedAllocateInfo dedicatedAllocateInfo{ f.image.get() };
+  memoryAllocateInfo.setPNext(&exportMemoryAllocateInfo);
+  if(m_hasDedicated)
+  {
+    exportMemoryAllocateInfo.setPNext(&dedicatedAllocateInfo);
+  }
+  f.memory = m_device->allocateMemoryUnique(memoryAllocateInfo, nullptr, m_dispatch);
+  m_device->bindImageMemory(f.image.get(), f.memory.get(), 0, m_dispatch);
+
+  f.handle = VKDPlatform::exportMemory(m_device.get(), f.memory.get(), m_dispatch);
+  glCreateMemoryObjectsEXT(1, &f.memoryObject);
+  if(m_hasDedicated)
+  {
+    GLint dedicated = GL_TRUE;
+    glMemoryObjectParameterivEXT(f.memoryObject, GL_DEDICATED_MEMORY_OBJECT_EXT, &dedicated);
+  }
+  VKDPlatform::importMemory(f.memoryObject, requirements.size, f.handle);
+
+  glCreateTextures(GL_TEXTURE_2D, 1, &f.textureGL);
+  glTextureStorageMem2DEXT(f.textureGL, 1, VKDPlatform::getGLFormat(format), extent.width, extent.height, f.memoryObject, 0);
+}
+
+void VKDTransfer::createStaging(Frame& f)
+{
+  vk::BufferCreateInfo bufferCreateInfo{ {}, m_slotSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc };
+
+  if(m_hostImport)
+  {
+    // VK_EXT_external_memory_host: both devices access the same pages, no copy on the host
+    f.hostStorage.resize(m_slotSize + m_hostAlignment);
+    f.host = reinterpret_cast<void*>(VKDPlatform::alignUp(reinterpret_cast<uintptr_t>(f.hostStorage.data()), m_hostAlignment));
+
+    auto import = [&](vk::PhysicalDevice gpu, vk::Device device, const vk::DispatchLoaderDynamic& d, vk::UniqueBuffer& buffer,
+                      vk::UniqueDeviceMemory& memory) {
+      vk::ExternalMemoryBufferCreateInfo externalCreateInfo{ vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT };
+      bufferCreateInfo.setPNext(&externalCreateInfo);
+      buffer = device.createBufferUnique(bufferCreateInfo, nullptr, d);
+
+      auto const pointerProperties = device.getMemoryHostPointerPropertiesEXT(vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, f.host, d);
+      auto const requirements      = device.getBufferMemoryRequirements(buffer.get(), d);
+      vk::ImportMemoryHostPointerInfoEXT importInfo{ vk::ExternalMemoryHandleTypeFlagBits::eHostAllocationEXT, f.host };
+      uint32_t const                     type = VKDPlatform::findMemoryType(gpu, requirements.memoryTypeBits & pointerProperties.memoryTypeBits,
+                                                                            vk::MemoryPropertyFlagBits::eHostVisible, d);
+      vk::MemoryAllocateInfo             allocateInfo{ m_slotSize, type };
+      allocateInfo.setPNext(&importInfo);
+      memory = device.allocateMemoryUnique(allocateInfo, nullptr, d);
+      device.bindBufferMemory(buffer.get(), memory.get(), 0, d);
+    };
+    import(m_gpu, m_device.get(), m_dispatch, f.renderBuffer, f.renderMemory);
+    import(m_displayGpu, m_displayDevice, VULKAN_HPP_DEFAULT_DISPATCHER, f.displayBuffer, f.displayMemory);
+    return;
+  }
+
+  // a mapped buffer on each device, the host copies between them
+  auto create = [&](vk::PhysicalDevice gpu, vk::Device device, const vk::DispatchLoaderDynamic& d, vk::MemoryPropertyFlags preferred,
+                    vk::UniqueBuffer& buffer, vk::UniqueDeviceMemory& memory, void*& mapped) {
+    buffer                  = device.createBufferUnique(bufferCreateInfo, nullptr, d);
+    auto const requirements = device.getBufferMemoryRequirements(buffer.get(), d);
+    auto const required     = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    uint32_t   type         = 0;
+    try
+    {
+      type = VKDPlatform::findMemoryType(gpu, requirements.memoryTypeBits, required | preferred, d);
+    }
+    catch(std::exception const&)
+    {
+      type = VKDPlatform::findMemoryType(gpu, requirements.memoryTypeBits, required, d);
+    }
+    memory = device.allocateMemoryUnique({ requirements.size, type }, nullptr, d);
+    device.bindBufferMemory(buffer.get(), memory.get(), 0, d);
+    mapped = device.mapMemory(memory.get(), 0, VK_WHOLE_SIZE, {}, d);
+  };
+  // the host reads the render side, cached memory makes that fast
+  create(m_gpu, m_device.get(), m_dispatch, vk::MemoryPropertyFlagBits::eHostCached, f.renderBuffer, f.renderMemory, f.renderMapped);
+  create(m_displayGpu, m_displayDevice, VULKAN_HPP_DEFAULT_DISPATCHER, {}, f.displayBuffer, f.displayMemory, f.displayMapped);
+}
+
+void VKDTransfer::createSemaphore(Semaphore& s)
+{
+  // timeline semaphores shared with GL, see VKDirectDisplay::createInteropSemaphore()
+  vk::SemaphoreCreateInfo       createInfo{};
+  vk::ExportSemaphoreCreateInfo exportCreateInfo{ VKDPlatform::semaphoreHandleType };
+  vk::SemaphoreTypeCreateInfo   typeCreateInfo{ vk::SemaphoreType::eTimeline, 0 };
+  createInfo.setPNext(&exportCreateInfo);
+  exportCreateInfo.setPNext(&typeCreateInfo);
+  s.semaphore = m_device->createSemaphoreUnique(createInfo, nullptr, m_dispatch);
+  s.handle    = VKDPlatform::exportSemaphore(m_device.get(), s.semaphore.get(), m_dispatch);
+
+  GLint semaphoreType = GL_SEMAPHORE_TYPE_TIMELINE_NV;
+  glCreateSemaphoresNV(1, &s.gl);
+  glSemaphoreParameterivNV(s.gl, GL_SEMAPHORE_TYPE_NV, &semaphoreType);
+  VKDPlatform::importSemaphore(s.gl, s.handle);
+}
+
+void VKDTransfer::destroySemaphore(Semaphore& s)
+{
+  if(s.gl)
+  {
+    glDeleteSemaphoresEXT(1, &s.gl);
+    s.gl = 0;
+  }
+  VKDPlatform::closeHandle(s.handle);
+  s.semaphore.reset();
+}
+
+void VKDTransfer::recordCopy(Frame& f, vk::Extent2D extent)
+{
+  // the semaphore wait makes GL's writes visible to the transfer stage, the barriers only change the layout
+  vk::ImageSubresourceRange const range{ vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 };
+  vk::ImageMemoryBarrier const    toSource{ {},
+                                         vk::AccessFlagBits::eTransferRead,
+                                         vk::ImageLayout::eColorAttachmentOptimal,
+                                         vk::ImageLayout::eTransferSrcOptimal,
+                                         VK_QUEUE_FAMILY_IGNORED,
+                                         VK_QUEUE_FAMILY_IGNORED,
+                                         f.image.get(),
+                                         range };
+  vk::ImageMemoryBarrier const toAttachment{ {},
+                                             {},
+                                             vk::ImageLayout::eTransferSrcOptimal,
+                                             vk::ImageLayout::eColorAttachmentOptimal,
+                                             VK_QUEUE_FAMILY_IGNORED,
+                                             VK_QUEUE_FAMILY_IGNORED,
+                                             f.image.get(),
+                                             range };
+  vk::BufferMemoryBarrier const toHost{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead, VK_QUEUE_FAMILY_IGNORED,
+                                        VK_QUEUE_FAMILY_IGNORED, f.renderBuffer.get(), 0, VK_WHOLE_SIZE };
+  vk::BufferImageCopy const region{ 0, 0, 0, { vk::ImageAspectFlagBits::eColor, 0, 0, 1 }, {}, vk::Extent3D(extent, 1) };
+
+  auto buf = f.commandBuffer;
+  buf.begin(vk::CommandBufferBeginInfo{}, m_dispatch);
+  buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, toSource, m_dispatch);
+  buf.copyImageToBuffer(f.image.get(), vk::ImageLayout::eTransferSrcOptimal, f.renderBuffer.get(), region, m_dispatch);
+  buf.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eHost, {}, {},
+                      toHost, toAttachment, m_dispatch);
+  buf.end(m_dispatch);
+}
+
+void VKDTransfer::copy(uint32_t frame, uint64_t value)
+{
+  auto& f = m_frames[frame];
+
+  // wait for GL frame <value>, copy, signal the copy of frame <value> done
+  vk::Semaphore const             glDone    = m_glDone.semaphore.get();
+  vk::Semaphore const             copyDone  = m_copyDone.semaphore.get();
+  vk::PipelineStageFlags const    waitStage = vk::PipelineStageFlagBits::eTransfer;
+  vk::TimelineSemaphoreSubmitInfo timelineInfo{ 1, &value, 1, &value };
+  vk::SubmitInfo                  submitInfo{ 1, &glDone, &waitStage, 1, &f.commandBuffer, 1, &copyDone };
+  submitInfo.setPNext(&timelineInfo);
+  m_queue.submit(submitInfo, nullptr, m_dispatch);
+
+  // the devices can't share a semaphore, the host is the only common ground
+  vk::SemaphoreWaitInfo waitInfo{ {}, 1, &copyDone, &value };
+  if(m_device->waitSemaphoresKHR(waitInfo, UINT64_MAX, m_dispatch) != vk::Result::eSuccess)
+  {
+    throw std::runtime_error("waiting for the render GPU copy failed");
+  }
+
+  if(!m_hostImport)
+  {
+    std::memcpy(f.displayMapped, f.renderMapped, m_slotSize);
+  }
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2014-2023, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2014-2023, NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+
+ /* Contact iesser@nvidia.com (Ingo Esser) for feedback */
+
+#pragma once
+
+// cross device frame transfer, used by VKDirectDisplay when GL renders on another GPU than the one driving the displays
+// GL renders into textures shared with a VK device on the render GPU, like the interop textures,
+// a transfer queue there copies each frame into a host memory staging slot the display GPU uploads it from
+// the host memory is imported into both devices with VK_EXT_external_memory_host if they support it,
+// otherwise each device gets its own host visible buffer and the host copies between them
+
+#define VULKAN_HPP_DISPATCH_LOADER_DYNAMIC 1
+
+#include <include_gl.h>
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "VKDPlatform.h"
+
+class VKDTransfer
+{
+public:
+  // the GPU the current GL context renders on, matched by GL_DEVICE_UUID_EXT (GL_DEVICE_LUID_EXT on Windows)
+  // nullptr if GL doesn't report it or none of the instance's GPUs matches
+  static vk::PhysicalDevice findGLDevice(vk::Instance instance);
+
+  // creates a device with one queue on renderGpu, preferably a dedicated transfer queue, throws on failure
+  // displayHostImport: VK_EXT_external_memory_host is enabled on displayDevice
+  void init(vk::Instance instance, vk::PhysicalDevice renderGpu, vk::PhysicalDevice displayGpu, vk::Device displayDevice, bool displayHostImport);
+  void deinit();
+  bool isActive() const { return bool(m_device); }
+
+  // one GL texture and one staging slot per frame, call with the GL context current when no frame is in flight
+  // the textures are in eColorAttachmentOptimal, both timeline semaphores start at 0
+  void createFrames(uint32_t count, vk::Extent2D extent, vk::Format format, uint32_t texelSize);
+  void destroyFrames();
+
+  GLuint getTexture(uint32_t frame) const { return m_frames[frame].textureGL; }
+
+  // GL signals <value> when it is done rendering frame <value>, like TimelineSync::m_glDone
+  // VK signals <value> when frame <value> is copied out of its texture, GL may render into it again then
+  GLuint getGLDoneSemaphore() const { return m_glDone.gl; }
+  GLuint getCopyDoneSemaphore() const { return m_copyDone.gl; }
+
+  // display device buffer the frame is in after copy(), tightly packed rows in the texture's row order
+  vk::Buffer getStagingBuffer(uint32_t frame) const { return m_frames[frame].displayBuffer.get(); }
+  bool       isZeroCopy() const { return m_hostImport; }
+
+  // copies the texture of frame into its staging slot once GL signaled value
+  // blocks until the display device can read it, the slot must not be in use by the display device
+  void copy(uint32_t frame, uint64_t value);
+
+private:
+  struct Semaphore
+  {
+    vk::UniqueSemaphore semaphore;
+    VKDPlatform::Handle handle{ VKDPlatform::invalidHandle };
+    GLuint              gl{ 0 };
+  };
+
+  struct Frame
+  {
+    // render GPU texture, exported and imported into GL
+    vk::UniqueImage        image;
+    vk::UniqueDeviceMemory memory;
+    VKDPlatform::Handle    handle{ VKDPlatform::invalidHandle };
+    GLuint                 memoryObject{ 0 };
+    GLuint                 textureGL{ 0 };
+
+    // staging slot: host memory imported into both devices, or a mapped buffer on each and a copy on the host
+    std::vector<uint8_t>   hostStorage;
+    void*                  host{ nullptr };  // aligned to the import alignment of both devices
+    vk::UniqueDeviceMemory renderMemory;
+    vk::UniqueBuffer       renderBuffer;
+    void*                  renderMapped{ nullptr };
+    vk::UniqueDeviceMemory displayMemory;
+    vk::UniqueBuffer       displayBuffer;
+    void*                  displayMapped{ nullptr };
+
+    vk::CommandBuffer      commandBuffer;  // image to staging slot, prerecorded
+  };
+
+  vk::DispatchLoaderDynamic m_dispatch;  // the default dispatcher has the display device's entry points
+  vk::PhysicalDevice        m_gpu;
+  vk::PhysicalDevice        m_displayGpu;
+  vk::Device                m_displayDevice;
+  vk::UniqueDevice          m_device;
+  uint32_t                  m_queueFamily{ 0 };
+  vk::Queue                 m_queue;
+  vk::UniqueCommandPool     m_commandPool;
+  bool                      m_hasDedicated{ false };  // VK_KHR_dedicated_allocation on the render GPU
+  bool                      m_hostImport{ false };    // VK_EXT_external_memory_host on both
+  vk::DeviceSize            m_hostAlignment{ 1 };
+  vk::DeviceSize            m_slotSize{ 0 };
+  std::vector<Frame>        m_frames;
+  Semaphore                 m_glDone;
+  Semaphore                 m_copyDone;
+
+  void            createTexture(Frame& f, vk::Extent2D extent, vk::Format format);
+  void            createStaging(Frame& f);
+  void            createSemaphore(Semaphore& s);
+  void            destroySemaphore(Semaphore& s);
+  void            recordCopy(Frame& f, vk::Extent2D extent);
+};
@@ -21,8 +21,17 @@ struct SceneData
   mat4 projMatrix;      // proj matrix: view ->proj
   mat4 viewProjMatrix;  // viewproj   : world->proj
   vec3 lightPos_world;  // light position in world space
+#ifdef __cplusplus
+  float lightPos_pad = 0.0f;  // std140 aligns a vec3 like a vec4, the C++ structs pad to match
+#endif
   vec3 eyepos_world;    // eye position in world space
+#ifdef __cplusplus
+  float eyepos_pad = 0.0f;
+#endif
   vec3 eyePos_view;     // eye position in view space
+#ifdef __cplusplus
+  float eyePos_pad = 0.0f;
+#endif
   vec3 backgroundColor; // scene background color
 
   int  fragmentLoad;
@@ -37,6 +46,9 @@ struct SceneData
     = 100.0f
 #endif
     ;
+#ifdef __cplusplus
+  float tail_pad[2] = {};  // std140 rounds the struct size up to 16 bytes
+#endif
 };
 
 struct ObjectData
@@ -46,6 +58,9 @@ struct ObjectData
   mat4 modelViewIT;   // model -> view for normals
   mat4 modelViewProj; // model -> proj
   vec3 color;         // object color
+#ifdef __cplusplus
+  float color_pad = 0.0f;
+#endif
 };
 
 struct ComposeData
@@ -54,6 +69,7 @@ struct ComposeData
   int in_height;    // height of the input textures
   int out_width;    // width of the output buffer
   int out_height;   // height of the output buffer
+  int flip_y;       // input textures have an upper left origin
 };
 
 #if defined(GL_core_profile) || defined(GL_compatibility_profile) || defined(GL_es_profile)
@@ -14,6 +14,10 @@ void main()
 
   float in_x = compose.in_width  * out_x / compose.out_width;
   float in_y = compose.in_height * out_y / compose.out_height;
+  if(compose.flip_y != 0)
+  {
+    in_y = compose.in_height - 1 - in_y;
+  }
 
   Color = texelFetch( tex, ivec2( in_x, in_y ), 0 );
 }
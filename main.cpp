@@ -24,7 +24,9 @@
 #define NVGLF_DEBUG_FILTER 1
 
 #include <include_gl.h>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 #include <imgui/backends/imgui_impl_gl.h>
 #include <imgui/imgui_helper.h>
@@ -35,8 +37,13 @@
 #include <nvh/cameracontrol.hpp>
 #include <nvh/geometry.hpp>
 
+#include <algorithm>
 #include <array>
+#include <cfloat>
 #include <chrono>
+#include <cinttypes>
+#include <cstring>
+#include <future>
 #include <iostream>
 #include <locale>
 #include <map>
@@ -57,6 +64,13 @@ int const SAMPLE_MINOR_VERSION = 5;
 
 namespace render {
 
+enum GuiEnums
+{
+  GUI_PRESENTPOLICY,
+  GUI_PRESENTMODE,
+  GUI_MODEPOLICY,
+};
+
 struct UIData
 {
   bool  m_drawUI       = true;
@@ -65,6 +79,18 @@ struct UIData
   float m_vertexLoad   = 42.0f;
   int   m_fragmentLoad = 10;
 
+  int   m_framesInFlight  = 0;
+  int   m_swapchainImages = 0;
+  int   m_presentPolicy   = 0;
+  int   m_presentMode     = 0;
+  bool  m_reinitDisplay   = false;
+  bool  m_autoRenderScale = true;
+  float m_renderScale     = 1.0f;
+  bool  m_skipUnchanged   = false;
+  int   m_refreshDivisor  = 0;
+  int   m_modePolicy      = 0;
+  bool  m_fitMode         = false;
+
   int   m_torus_n       = 420;
   int   m_torus_m       = 420;
   float m_numTriangles  = 0.0f;
@@ -110,6 +136,24 @@ struct Buffers
   GLsizei numIndices;
 };
 
+// torus geometry, uploaded to GL and to the native VK renderer
+struct Torus
+{
+  std::vector<glm::vec3>    vertices;
+  std::vector<glm::vec3>    normals;
+  std::vector<glm::vec2>    texcoords;
+  std::vector<unsigned int> indices;
+};
+
+// what the last presented frame was rendered from, to skip frames that would look the same
+struct Presented
+{
+  bool                           valid = false;
+  SceneData                      sceneData;
+  std::vector<VKDRenderer::Draw> draws;
+  GLuint                         tex = 0;  // interop texture it was rendered into
+};
+
 struct Textures
 {
   GLuint colorTex;
@@ -129,6 +173,7 @@ struct Data
   ImGuiH::Registry ui;
   double           uiTime = 0;
 
+  Torus    torus;
   Buffers  buf;
   Textures tex;
   Programs prog;
@@ -139,6 +184,8 @@ struct Data
 
   GLuint renderFBO = 0;
 
+  Presented presented;
+
   nvgl::ProgramManager pm;
 
   int windowWidth  = SAMPLE_SIZE_WIDTH;
@@ -176,84 +223,90 @@ auto initFBOs(Data& rd) -> void
   nvgl::newFramebuffer(rd.renderFBO);
 }
 
-auto initBuffers(Data& rd) -> void
+auto buildTorus(Data& rd) -> void
 {
-  Buffers& buffers = rd.buf;
-
-  // Torus geometry
+  unsigned int m           = rd.uiData.m_torus_m;
+  unsigned int n           = rd.uiData.m_torus_n;
+  float        innerRadius = 0.8f;
+  float        outerRadius = 0.2f;
+
+  std::vector<glm::vec3>&    vertices  = rd.torus.vertices;
+  std::vector<glm::vec3>&    normals   = rd.torus.normals;
+  std::vector<glm::vec2>&    texcoords = rd.torus.texcoords;
+  std::vector<unsigned int>& indices   = rd.torus.indices;
+
+  unsigned int size_v = (m + 1) * (n + 1);
+
+  vertices.clear();
+  normals.clear();
+  texcoords.clear();
+  indices.clear();
+  vertices.reserve(size_v);
+  normals.reserve(size_v);
+  texcoords.reserve(size_v);
+  indices.reserve(6 * m * n);
+
+  float mf = (float)m;
+  float nf = (float)n;
+
+  float phi_step   = glm::two_pi<float>() / mf;
+  float theta_step = glm::two_pi<float>() / nf;
+
+  // Setup vertices and normals
+  // Generate the Torus exactly like the sphere with rings around the origin along the latitudes.
+  for(unsigned int latitude = 0; latitude <= n; latitude++)  // theta angle
   {
-    unsigned int m           = rd.uiData.m_torus_m;
-    unsigned int n           = rd.uiData.m_torus_n;
-    float        innerRadius = 0.8f;
-    float        outerRadius = 0.2f;
-
-    std::vector<glm::vec3>    vertices;
-    std::vector<glm::vec3>    tangents;
-    std::vector<glm::vec3>    binormals;
-    std::vector<glm::vec3>    normals;
-    std::vector<glm::vec2>    texcoords;
-    std::vector<unsigned int> indices;
-
-    unsigned int size_v = (m + 1) * (n + 1);
-
-    vertices.reserve(size_v);
-    tangents.reserve(size_v);
-    binormals.reserve(size_v);
-    normals.reserve(size_v);
-    texcoords.reserve(size_v);
-    indices.reserve(6 * m * n);
+    float theta    = (float)latitude * theta_step;
+    float sinTheta = sinf(theta);
+    float cosTheta = cosf(theta);
 
-    float mf = (float)m;
-    float nf = (float)n;
+    float radius = innerRadius + outerRadius * cosTheta;
 
-    float phi_step   = glm::two_pi<float>() / mf;
-    float theta_step = glm::two_pi<float>() / nf;
-
-    // Setup vertices and normals
-    // Generate the Torus exactly like the sphere with rings around the origin along the latitudes.
-    for(unsigned int latitude = 0; latitude <= n; latitude++)  // theta angle
+    for(unsigned int longitude = 0; longitude <= m; longitude++)  // phi angle
     {
-      float theta    = (float)latitude * theta_step;
-      float sinTheta = sinf(theta);
-      float cosTheta = cosf(theta);
-
-      float radius = innerRadius + outerRadius * cosTheta;
-
-      for(unsigned int longitude = 0; longitude <= m; longitude++)  // phi angle
-      {
-        float phi    = (float)longitude * phi_step;
-        float sinPhi = sinf(phi);
-        float cosPhi = cosf(phi);
-
-        vertices.push_back(glm::vec3(radius * cosPhi, outerRadius * sinTheta, radius * -sinPhi));
+      float phi    = (float)longitude * phi_step;
+      float sinPhi = sinf(phi);
+      float cosPhi = cosf(phi);
 
-        tangents.push_back(glm::vec3(-sinPhi, 0.0f, -cosPhi));
+      vertices.push_back(glm::vec3(radius * cosPhi, outerRadius * sinTheta, radius * -sinPhi));
 
-        binormals.push_back(glm::vec3(cosPhi * -sinTheta, cosTheta, sinPhi * sinTheta));
+      normals.push_back(glm::vec3(cosPhi * cosTheta, sinTheta, -sinPhi * cosTheta));
 
-        normals.push_back(glm::vec3(cosPhi * cosTheta, sinTheta, -sinPhi * cosTheta));
-
-        texcoords.push_back(glm::vec2((float)longitude / mf, (float)latitude / nf));
-      }
+      texcoords.push_back(glm::vec2((float)longitude / mf, (float)latitude / nf));
     }
+  }
 
-    const unsigned int columns = m + 1;
+  const unsigned int columns = m + 1;
 
-    // Setup indices
-    for(unsigned int latitude = 0; latitude < n; latitude++)
+  // Setup indices
+  for(unsigned int latitude = 0; latitude < n; latitude++)
+  {
+    for(unsigned int longitude = 0; longitude < m; longitude++)
     {
-      for(unsigned int longitude = 0; longitude < m; longitude++)
-      {
-        // two triangles
-        indices.push_back(latitude * columns + longitude);        // lower left
-        indices.push_back(latitude * columns + longitude + 1);    // lower right
-        indices.push_back((latitude + 1) * columns + longitude);  // upper left
-
-        indices.push_back((latitude + 1) * columns + longitude);      // upper left
-        indices.push_back(latitude * columns + longitude + 1);        // lower right
-        indices.push_back((latitude + 1) * columns + longitude + 1);  // upper right
-      }
+      // two triangles
+      indices.push_back(latitude * columns + longitude);        // lower left
+      indices.push_back(latitude * columns + longitude + 1);    // lower right
+      indices.push_back((latitude + 1) * columns + longitude);  // upper left
+
+      indices.push_back((latitude + 1) * columns + longitude);      // upper left
+      indices.push_back(latitude * columns + longitude + 1);        // lower right
+      indices.push_back((latitude + 1) * columns + longitude + 1);  // upper right
     }
+  }
+}
+
+auto initBuffers(Data& rd) -> void
+{
+  Buffers& buffers = rd.buf;
+
+  // Torus geometry
+  {
+    buildTorus(rd);
+
+    const std::vector<glm::vec3>&    vertices  = rd.torus.vertices;
+    const std::vector<glm::vec3>&    normals   = rd.torus.normals;
+    const std::vector<glm::vec2>&    texcoords = rd.torus.texcoords;
+    const std::vector<unsigned int>& indices   = rd.torus.indices;
 
     buffers.numVertices                        = static_cast<GLsizei>(vertices.size());
     GLsizeiptr const sizePositionAttributeData = vertices.size() * sizeof(vertices[0]);
@@ -314,22 +367,12 @@ auto initTextures(Data& rd) -> void
   nvgl::bindMultiTexture(GL_TEXTURE0, GL_TEXTURE_2D, 0);
 }
 
-auto renderTori(Data& rd, float numTori, size_t width, size_t height, glm::mat4 view) -> void
+auto layoutTori(Data& rd, float numTori, size_t width, size_t height, glm::mat4 view, glm::mat4 viewProj) -> std::vector<VKDRenderer::Draw>
 {
+  // object data and index count per torus, shared by the GL and the native VK renderer
+  std::vector<VKDRenderer::Draw> draws;
   float num = ceil(numTori);
 
-  // bind geometry
-  glBindBuffer(GL_ARRAY_BUFFER, rd.buf.vbo);
-  glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
-  glVertexAttribPointer(VERTEX_NORMAL, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (GLvoid*)(rd.buf.numVertices * 3 * sizeof(float)));
-  glVertexAttribPointer(VERTEX_TEX, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)(rd.buf.numVertices * 6 * sizeof(float)));
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rd.buf.ibo);
-
-  glEnableVertexAttribArray(VERTEX_POS);
-  glEnableVertexAttribArray(VERTEX_NORMAL);
-  glEnableVertexAttribArray(VERTEX_TEX);
-
   // distribute num tori into an numX x numY pattern
   // with numX * numY > num, numX = aspect * numY
 
@@ -362,34 +405,121 @@ auto renderTori(Data& rd, float numTori, size_t width, size_t height, glm::mat4
       float y = y0 + i * dy;
       float x = x0 + j * dx;
 
-      // set and upload object UBO data
-      rd.objectData.model = glm::scale(glm::mat4(1.f), glm::vec3(scale)) * glm::translate(glm::mat4(1.f), glm::vec3(x, y, 0.0f))
-                            * glm::rotate(glm::mat4(1), (j % 2 ? -1.0f : 1.0f) * 45.0f * glm::pi<float>() / 180.0f, glm::vec3(1, 0, 0));
-      rd.objectData.modelView     = view * rd.objectData.model;
-      rd.objectData.modelViewIT   = glm::transpose(glm::inverse(rd.objectData.modelView));
-      rd.objectData.modelViewProj = rd.sceneData.viewProjMatrix * rd.objectData.model;
-      //rd.objectData.color = glm::vec3((torusIndex + 1) & 1, ((torusIndex + 1) & 2) / 2, ((torusIndex + 1) & 4) / 4);
-      rd.objectData.color = glm::vec3(0.0f, 0.0f, 1.0f);
-      glNamedBufferSubData(rd.buf.objectUbo, 0, sizeof(ObjectData), &rd.objectData);
-      glBindBufferBase(GL_UNIFORM_BUFFER, UBO_OBJECT, rd.buf.objectUbo);
-
-      GLsizei count = 0;
+      VKDRenderer::Draw draw;
+      draw.object.model = glm::scale(glm::mat4(1.f), glm::vec3(scale)) * glm::translate(glm::mat4(1.f), glm::vec3(x, y, 0.0f))
+                          * glm::rotate(glm::mat4(1), (j % 2 ? -1.0f : 1.0f) * 45.0f * glm::pi<float>() / 180.0f, glm::vec3(1, 0, 0));
+      draw.object.modelView     = view * draw.object.model;
+      draw.object.modelViewIT   = glm::transpose(glm::inverse(draw.object.modelView));
+      draw.object.modelViewProj = viewProj * draw.object.model;
+      //draw.object.color = glm::vec3((torusIndex + 1) & 1, ((torusIndex + 1) & 2) / 2, ((torusIndex + 1) & 4) / 4);
+      draw.object.color = glm::vec3(0.0f, 0.0f, 1.0f);
+
       if(torusIndex < floor(numTori))
       {
-        count = rd.buf.numIndices;
+        draw.count = uint32_t(rd.buf.numIndices);
       }
       else
       {
         // render the fraction of the last torus
-        count = GLsizei(rd.buf.numIndices * (numTori - floor(numTori)));
+        draw.count = uint32_t(rd.buf.numIndices * (numTori - floor(numTori)));
       }
-
-      glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, NV_BUFFER_OFFSET(0));
+      draws.push_back(draw);
 
       ++torusIndex;
     }
   }
 
+  return draws;
+}
+
+// screen space bounds of a torus in canvas pixels, upper left origin, false if it reaches behind the camera
+auto getTorusBounds(const glm::mat4& modelViewProj, int width, int height, vk::Rect2D& rect) -> bool
+{
+  // innerRadius + outerRadius and outerRadius of buildTorus()
+  const glm::vec3 extent(1.0f, 0.2f, 1.0f);
+
+  glm::vec2 lo(FLT_MAX);
+  glm::vec2 hi(-FLT_MAX);
+  for(int i = 0; i < 8; ++i)
+  {
+    glm::vec4 const corner =
+        modelViewProj * glm::vec4(i & 1 ? extent.x : -extent.x, i & 2 ? extent.y : -extent.y, i & 4 ? extent.z : -extent.z, 1.0f);
+    if(corner.w <= 0.0f)
+    {
+      return false;
+    }
+    lo = glm::min(lo, glm::vec2(corner) / corner.w);
+    hi = glm::max(hi, glm::vec2(corner) / corner.w);
+  }
+
+  // NDC y points up, a margin for rasterization and the scaling filter of dynamic resolution
+  int32_t const x0 = std::clamp(int32_t(std::floor((lo.x * 0.5f + 0.5f) * width)) - 2, 0, width);
+  int32_t const x1 = std::clamp(int32_t(std::ceil((hi.x * 0.5f + 0.5f) * width)) + 2, 0, width);
+  int32_t const y0 = std::clamp(int32_t(std::floor((0.5f - hi.y * 0.5f) * height)) - 2, 0, height);
+  int32_t const y1 = std::clamp(int32_t(std::ceil((0.5f - lo.y * 0.5f) * height)) + 2, 0, height);
+  rect             = vk::Rect2D({ x0, y0 }, { uint32_t(x1 - x0), uint32_t(y1 - y0) });
+  return true;
+}
+
+// compares the frame about to be rendered with the last presented one, false if they look the same
+// damage: where the tori moved from and to, empty if the whole frame changed
+auto findChanges(const Data& rd, const std::vector<VKDRenderer::Draw>& draws, int width, int height, std::vector<vk::Rect2D>& damage) -> bool
+{
+  damage.clear();
+
+  const Presented& last = rd.presented;
+  if(!last.valid || last.draws.size() != draws.size() || memcmp(&last.sceneData, &rd.sceneData, sizeof(SceneData)) != 0)
+  {
+    return true;
+  }
+
+  bool changed = false;
+  for(size_t i = 0; i < draws.size(); ++i)
+  {
+    if(draws[i].count == last.draws[i].count && memcmp(&draws[i].object, &last.draws[i].object, sizeof(ObjectData)) == 0)
+    {
+      continue;
+    }
+    changed = true;
+
+    vk::Rect2D before;
+    vk::Rect2D after;
+    if(!getTorusBounds(last.draws[i].object.modelViewProj, width, height, before)
+       || !getTorusBounds(draws[i].object.modelViewProj, width, height, after))
+    {
+      damage.clear();
+      return true;
+    }
+    damage.push_back(before);
+    damage.push_back(after);
+  }
+  return changed;
+}
+
+auto renderTori(Data& rd, const std::vector<VKDRenderer::Draw>& draws) -> void
+{
+  // bind geometry
+  glBindBuffer(GL_ARRAY_BUFFER, rd.buf.vbo);
+  glVertexAttribPointer(VERTEX_POS, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+  glVertexAttribPointer(VERTEX_NORMAL, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (GLvoid*)(rd.buf.numVertices * 3 * sizeof(float)));
+  glVertexAttribPointer(VERTEX_TEX, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (GLvoid*)(rd.buf.numVertices * 6 * sizeof(float)));
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rd.buf.ibo);
+
+  glEnableVertexAttribArray(VERTEX_POS);
+  glEnableVertexAttribArray(VERTEX_NORMAL);
+  glEnableVertexAttribArray(VERTEX_TEX);
+
+  for(const auto& draw : draws)
+  {
+    // set and upload object UBO data
+    rd.objectData = draw.object;
+    glNamedBufferSubData(rd.buf.objectUbo, 0, sizeof(ObjectData), &rd.objectData);
+    glBindBufferBase(GL_UNIFORM_BUFFER, UBO_OBJECT, rd.buf.objectUbo);
+
+    glDrawElements(GL_TRIANGLES, GLsizei(draw.count), GL_UNSIGNED_INT, NV_BUFFER_OFFSET(0));
+  }
+
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
@@ -445,6 +575,7 @@ public:
   void rebuild_geometry()
   {
     render::initBuffers(m_rd);
+    m_vkdd.setNativeGeometry(m_rd.torus.vertices, m_rd.torus.normals, m_rd.torus.indices);
     PRINTSTATS("Scene data:\n");
     PRINTSTATS("Vertices per torus:  {}\n", m_rd.buf.numVertices);
     PRINTSTATS("Triangles per torus: {}\n", m_rd.buf.numIndices / 3);
@@ -455,13 +586,54 @@ protected:
   size_t             m_frameCount;
   render::Data       m_rd;
 
-  VKDirectDisplay m_vkdd;
+  VKDirectDisplay         m_vkdd;
+  VKDirectDisplay::Config m_vkddConfig;
 };
 
 Sample::Sample()
     : nvgl::AppWindowProfilerGL(/*singleThreaded=*/true)
     , m_frameCount(0)
 {
+  m_parameterList.add("vkddsync|GL/VK sync mode. 0: binary semaphores, 1: timeline semaphores", (uint32_t*)&m_vkddConfig.syncMode);
+  m_parameterList.add("vkddframes|interop textures in flight, 0: swapchain image count", &m_vkddConfig.framesInFlight);
+  m_parameterList.add("vkddimages|swapchain image count, 0: minimum + 1", &m_vkddConfig.swapchainImageCount);
+  m_parameterList.add("vkddthread|acquire, blit and present on a separate thread", &m_vkddConfig.presentThread);
+  m_parameterList.add("vkddpacing|start rendering just in time for the next vblank", &m_vkddConfig.framePacing);
+  m_parameterList.add("vkddpresentpolicy|0: no tearing, 1: lowest latency, 2: lowest power, 3: explicit", (uint32_t*)&m_vkddConfig.presentPolicy);
+  m_parameterList.add("vkddpresentmode|VkPresentModeKHR used with explicit present policy", (uint32_t*)&m_vkddConfig.presentMode);
+  m_parameterList.add("vkddstallbudget|ms budgets for GL finish, acquire, blit and present", m_vkddConfig.stallBudgetMs, nullptr, 4);
+  m_parameterList.add("vkddcopy|copy instead of blit if the swapchain format allows, GL renders upside down", &m_vkddConfig.copyFastPath);
+  m_parameterList.add("vkddpool|sub-allocate all interop textures from one exported allocation", &m_vkddConfig.pooledInteropMemory);
+  m_parameterList.add("vkddheadless|VK_EXT_headless_surface instead of direct displays, for benchmarking", &m_vkddConfig.headless);
+  m_parameterList.add("vkddheadlesswidth|headless: width of the made up display mode", &m_vkddConfig.headlessWidth);
+  m_parameterList.add("vkddheadlessheight|headless: height of the made up display mode", &m_vkddConfig.headlessHeight);
+  m_parameterList.add("vkddheadlessrefresh|headless: refresh rate of the made up display mode in Hz", &m_vkddConfig.headlessRefreshHz);
+  m_parameterList.add("vkddtransfer|copy on a dedicated transfer or async compute queue if available", &m_vkddConfig.transferQueue);
+  m_parameterList.add("vkdddisplay|index of the first direct display", &m_vkddConfig.firstDisplay);
+  m_parameterList.add("vkdddisplays|number of direct displays to drive, 0: all from the first", &m_vkddConfig.displayCount);
+  m_parameterList.add("vkdddisplayname|first direct display by name, any display whose name contains this", &m_vkddConfig.displayName);
+  m_parameterList.add("vkddmodepolicy|0: largest, 1: max refresh at min size, 2: exact size and refresh, 3: fit frame time", (uint32_t*)&m_vkddConfig.modePolicy);
+  m_parameterList.add("vkddmodewidth|display mode width, exact or minimum depending on the mode policy", &m_vkddConfig.modeWidth);
+  m_parameterList.add("vkddmodeheight|display mode height, exact or minimum depending on the mode policy", &m_vkddConfig.modeHeight);
+  m_parameterList.add("vkddmoderefresh|display mode refresh rate in Hz for the exact mode policy, 0: highest", &m_vkddConfig.modeRefreshHz);
+  m_parameterList.add("vkddmodeframetime|ms a frame takes, the fit frame time mode policy picks a refresh period that fits", &m_vkddConfig.modeFrameTimeMs);
+  m_parameterList.add("vkdddrop|drop frames instead of blocking when acquire stalls", &m_vkddConfig.dropFramesOnStall);
+  m_parameterList.add("vkddscale|dynamic render resolution, VK scales the rendered part of the interop textures up", &m_vkddConfig.dynamicResolution);
+  m_parameterList.add("vkddscalemin|minimum render scale per axis for dynamic resolution", &m_vkddConfig.minRenderScale);
+  m_parameterList.add("vkddscalebudget|fraction of the refresh period dynamic resolution keeps render and blit time in", &m_vkddConfig.renderBudget);
+  m_parameterList.add("vkddsynth|present the last frame again when GL misses a vblank, needs the present thread", &m_vkddConfig.frameSynthesis);
+  m_parameterList.add("vkddreproject|shift repeated frames by the camera motion since they were rendered", &m_vkddConfig.reprojection);
+  m_parameterList.add("vkddslices|beam racing: present each frame in this many slices with immediate present, 0: off", &m_vkddConfig.beamRacingSlices);
+  m_parameterList.add("vkddslicelead|beam racing: ms before the scanout reaches a slice to start rendering it", &m_vkddConfig.beamRacingLeadMs);
+  m_parameterList.add("vkddskip|skip rendering and presenting frames that look like the last one", &m_rd.uiData.m_skipUnchanged);
+  m_parameterList.add("vkdddivisor|cap the frame rate at the refresh rate divided by this, without frame pacing, 0: off", &m_vkddConfig.refreshDivisor);
+  m_parameterList.add("vkddvrr|the displays run with variable refresh, the frame rate cap is a minimum frame time", &m_vkddConfig.variableRefresh);
+  m_parameterList.add("vkdddevice|display GPU by UUID in hex or by any part of its name", &m_vkddConfig.displayDevice);
+  m_parameterList.add("vkddcrossdevice|stage frames through host memory when GL renders on another GPU than the display GPU", &m_vkddConfig.crossDeviceTransfer);
+  m_parameterList.add("vkddlayers|compositor: render this many layers side by side at different rates, VK composes them, 0: off", &m_vkddConfig.layerCount);
+  m_parameterList.add("vkddlayerframes|compositor: interop textures per layer", &m_vkddConfig.layerFrames);
+  m_parameterList.add("vkddexport|hand the interop textures to other processes, socket path (Linux) or pipe name (Windows)", &m_vkddConfig.exportName);
+  m_parameterList.add("vkddnative|render the scene with Vulkan straight into the swapchain images, no GL interop", &m_vkddConfig.nativeRenderer);
 }
 
 bool Sample::begin()
@@ -473,6 +645,10 @@ bool Sample::begin()
 
   bool validated(true);
 
+  // VK_KHR_display
+  // the VK only part of the VK ddisplay init overlaps with GL setup below
+  std::future<bool> vkddDevice = std::async(std::launch::async, [this]() { return m_vkdd.initDevice(m_vkddConfig); });
+
   // control setup
   m_control.m_sceneOrbit     = glm::vec3(0.0f);
   m_control.m_sceneDimension = 1.0f;
@@ -492,12 +668,36 @@ bool Sample::begin()
   glFrontFace(GL_CCW);
 
   // VK_KHR_display
-  // initialize VK ddisplay class
-  validated &= m_vkdd.init();
+  // initialize VK ddisplay class: join the device init, create the interop resources with the GL context current
+  validated &= vkddDevice.get() && m_vkdd.initInterop();
+  m_vkdd.setNativeGeometry(m_rd.torus.vertices, m_rd.torus.normals, m_rd.torus.indices);
 
   m_rd.uiData.m_texWidth  = m_vkdd.getWidth();
   m_rd.uiData.m_texHeight = m_vkdd.getHeight();
 
+  m_rd.uiData.m_framesInFlight  = m_vkdd.getFramesInFlight();
+  m_rd.uiData.m_swapchainImages = m_vkdd.getSwapchainImageCount();
+  m_rd.uiData.m_presentPolicy   = int(m_vkddConfig.presentPolicy);
+  m_rd.uiData.m_presentMode     = int(m_vkdd.getPresentMode());
+  m_rd.uiData.m_autoRenderScale = m_vkdd.isAutoRenderScale();
+  m_rd.uiData.m_renderScale     = m_vkdd.getRenderScale();
+  m_rd.uiData.m_refreshDivisor  = int(m_vkdd.getRefreshDivisor());
+  m_rd.uiData.m_modePolicy      = int(m_vkddConfig.modePolicy);
+  m_rd.lastUIData               = m_rd.uiData;
+
+  m_rd.ui.enumAdd(render::GUI_PRESENTPOLICY, int(VKDirectDisplay::PresentPolicy::eNoTearing), "no tearing");
+  m_rd.ui.enumAdd(render::GUI_PRESENTPOLICY, int(VKDirectDisplay::PresentPolicy::eLowestLatency), "lowest latency");
+  m_rd.ui.enumAdd(render::GUI_PRESENTPOLICY, int(VKDirectDisplay::PresentPolicy::eLowestPower), "lowest power");
+  m_rd.ui.enumAdd(render::GUI_PRESENTPOLICY, int(VKDirectDisplay::PresentPolicy::eExplicit), "explicit");
+  for(auto mode : m_vkdd.getSupportedPresentModes())
+  {
+    m_rd.ui.enumAdd(render::GUI_PRESENTMODE, int(mode), vk::to_string(mode).c_str());
+  }
+  m_rd.ui.enumAdd(render::GUI_MODEPOLICY, int(VKDirectDisplay::ModePolicy::eLargest), "largest");
+  m_rd.ui.enumAdd(render::GUI_MODEPOLICY, int(VKDirectDisplay::ModePolicy::eMaxRefresh), "max refresh");
+  m_rd.ui.enumAdd(render::GUI_MODEPOLICY, int(VKDirectDisplay::ModePolicy::eExact), "exact");
+  m_rd.ui.enumAdd(render::GUI_MODEPOLICY, int(VKDirectDisplay::ModePolicy::eFitRenderTime), "fit frame time");
+
   render::initTextures(m_rd);
 
   return validated;
@@ -539,16 +739,110 @@ void Sample::processUI(double time)
   {
     ImGui::PushItemWidth(ImGuiH::dpiScaled(150));
 
-    // TODO: reactivate, handle change in GL and VK?
-    //ImGuiH::InputIntClamped("tex w", &m_rd.uiData.m_texWidth, 10, INT_MAX, 10, 100, ImGuiInputTextFlags_EnterReturnsTrue);
-    //ImGuiH::InputIntClamped("tex h", &m_rd.uiData.m_texHeight, 10, INT_MAX, 10, 100, ImGuiInputTextFlags_EnterReturnsTrue);
+    // VK_KHR_display
+    // the interop textures follow the display mode, GL renders into a scaled part of them with dynamic resolution
+    if(m_vkdd.isDynamicResolutionEnabled())
+    {
+      ImGui::Checkbox("auto render scale", &m_rd.uiData.m_autoRenderScale);
+      if(m_rd.uiData.m_autoRenderScale)
+      {
+        m_rd.uiData.m_renderScale = m_vkdd.getRenderScale();
+        ImGui::LabelText("render scale", "%.2f (%u x %u)", m_rd.uiData.m_renderScale, m_vkdd.getRenderWidth(), m_vkdd.getRenderHeight());
+      }
+      else
+      {
+        ImGui::SliderFloat("render scale", &m_rd.uiData.m_renderScale, m_vkddConfig.minRenderScale, 1.0f, "%.2f");
+      }
+    }
 
     ImGuiH::InputFloatClamped("vertex load", &m_rd.uiData.m_vertexLoad, 1.0f, (float)INT_MAX, 1, 10, "%.1f",
                               ImGuiInputTextFlags_EnterReturnsTrue);
     ImGuiH::InputIntClamped("fragment load", &m_rd.uiData.m_fragmentLoad, 1, INT_MAX, 1, 10, ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGuiH::InputIntClamped("frames in flight", &m_rd.uiData.m_framesInFlight, 1, 8, 1, 1, ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGuiH::InputIntClamped("swapchain images", &m_rd.uiData.m_swapchainImages, 1, 8, 1, 1, ImGuiInputTextFlags_EnterReturnsTrue);
+    m_rd.ui.enumCombobox(render::GUI_PRESENTPOLICY, "present policy", &m_rd.uiData.m_presentPolicy);
+    if(m_rd.uiData.m_presentPolicy == int(VKDirectDisplay::PresentPolicy::eExplicit))
+    {
+      m_rd.ui.enumCombobox(render::GUI_PRESENTMODE, "present mode", &m_rd.uiData.m_presentMode);
+    }
+    ImGui::Checkbox("skip unchanged frames", &m_rd.uiData.m_skipUnchanged);
+    ImGuiH::InputIntClamped("refresh divisor", &m_rd.uiData.m_refreshDivisor, 0, 8, 1, 1, ImGuiInputTextFlags_EnterReturnsTrue);
+    if(m_vkdd.isFrameRateGoverned())
+    {
+      ImGui::LabelText("frame rate cap", "%.2f Hz", m_vkdd.getRefreshRate() / m_vkdd.getRefreshDivisor());
+    }
+    if(m_vkdd.isCrossDevice())
+    {
+      ImGui::Text("cross device transfer");
+    }
+    if(m_vkdd.isExporting())
+    {
+      ImGui::Text("exporting frames");
+    }
+    if(m_vkdd.isCompositor())
+    {
+      ImGui::LabelText("compositor layers", "%u", m_vkdd.getLayerCount());
+    }
+    m_rd.ui.enumCombobox(render::GUI_MODEPOLICY, "mode policy", &m_rd.uiData.m_modePolicy);
+    m_rd.uiData.m_fitMode       = ImGui::Button("fit mode to render time");
+    m_rd.uiData.m_reinitDisplay = ImGui::Button("reinit display");
+    if(m_vkdd.isSuspended())
+    {
+      ImGui::Text("display lost, retrying");
+    }
     ImGui::LabelText("frames / s", "%.2f", m_rd.uiData.m_fps);
     ImGui::LabelText("M triangles", "%.2f", m_rd.uiData.m_numTriangles / 1E6f);
     ImGui::LabelText("B tris / s", "%.2f", m_rd.uiData.m_numTrisPerSec / 1E9f);
+    if(ImGui::TreeNode("display modes"))
+    {
+      for(uint32_t i = 0; i < m_vkdd.getDisplayCount(); ++i)
+      {
+        ImGui::Text("%s", m_vkdd.getDisplayName(i));
+        for(const auto& mode : m_vkdd.getDisplayModes(i))
+        {
+          ImGui::Text("  %u x %u @ %.2f Hz%s", mode.extent.width, mode.extent.height, mode.refreshHz, mode.active ? " (active)" : "");
+        }
+      }
+      ImGui::TreePop();
+    }
+    if(ImGui::TreeNode("present modes"))
+    {
+      for(const auto& stats : m_vkdd.getPresentModeStats())
+      {
+        ImGui::Text("%s%s: %.1f fps, queue depth %.2f", vk::to_string(stats.mode).c_str(),
+                    stats.mode == m_vkdd.getPresentMode() ? " (active)" : "", stats.framesPerSecond, stats.avgQueueDepth);
+      }
+      ImGui::TreePop();
+    }
+    if(ImGui::TreeNode("stalls"))
+    {
+      auto const stats = m_vkdd.getStallStats();
+      for(uint32_t i = 0; i < uint32_t(VKDirectDisplay::StallStage::eCount); ++i)
+      {
+        ImGui::Text("%s: %" PRIu64, VKDirectDisplay::getStallStageName(VKDirectDisplay::StallStage(i)), stats.stalls[i]);
+      }
+      ImGui::Text("timeouts: %" PRIu64 ", dropped frames: %" PRIu64, stats.timeouts, stats.droppedFrames);
+      ImGui::Text("suboptimal: %" PRIu64 ", out of date: %" PRIu64, stats.suboptimal, stats.outOfDate);
+      ImGui::Text("surface lost: %" PRIu64 ", recoveries: %" PRIu64, stats.surfaceLost, stats.recoveries);
+      ImGui::Text("synthesized frames: %" PRIu64 ", skipped frames: %" PRIu64, stats.synthesizedFrames, stats.skippedFrames);
+      if(m_vkdd.getSliceCount())
+      {
+        ImGui::Text("late slices: %" PRIu64, stats.lateSlices);
+      }
+      for(uint32_t i = 0; i < uint32_t(VKDirectDisplay::StallStage::eCount); ++i)
+      {
+        ImGui::Text("%s avg: %.3f ms", VKDirectDisplay::getStallStageName(VKDirectDisplay::StallStage(i)),
+                    stats.samples[i] ? stats.totalMs[i] / double(stats.samples[i]) : 0.0);
+      }
+      ImGui::TreePop();
+    }
+    if(m_vkdd.isFramePacingEnabled())
+    {
+      auto const stats = m_vkdd.getPacingStats();
+      ImGui::LabelText("render ms", "%.2f", stats.renderTimeMs);
+      ImGui::LabelText("blit ms", "%.2f", stats.blitTimeMs);
+      ImGui::LabelText("present error ms", "%.2f", stats.actualPresentMs - stats.predictedPresentMs);
+    }
   }
   ImGui::End();
 }
@@ -558,23 +852,69 @@ void Sample::think(double time)
   processUI(time);
 
   // handle ui data changes
-  /*
-  TODO: see processUI
-  if(m_rd.lastUIData.m_texWidth != m_rd.uiData.m_texWidth || m_rd.lastUIData.m_texHeight != m_rd.uiData.m_texHeight)
+
+  // VK_KHR_display
+  // change pipeline depth of the VK ddisplay class
+  if(m_rd.lastUIData.m_framesInFlight != m_rd.uiData.m_framesInFlight
+     || m_rd.lastUIData.m_swapchainImages != m_rd.uiData.m_swapchainImages)
   {
-    render::initTextures(m_rd);
-  }*/
+    m_vkdd.setFrameCounts(m_rd.uiData.m_framesInFlight, m_rd.uiData.m_swapchainImages);
+    m_rd.presented.valid = false;
+    m_rd.uiData.m_framesInFlight  = m_vkdd.getFramesInFlight();
+    m_rd.uiData.m_swapchainImages = m_vkdd.getSwapchainImageCount();
+  }
+  if(m_rd.lastUIData.m_presentPolicy != m_rd.uiData.m_presentPolicy || m_rd.lastUIData.m_presentMode != m_rd.uiData.m_presentMode)
+  {
+    m_vkdd.setPresentPolicy(VKDirectDisplay::PresentPolicy(m_rd.uiData.m_presentPolicy), vk::PresentModeKHR(m_rd.uiData.m_presentMode));
+  }
+  if(m_rd.lastUIData.m_refreshDivisor != m_rd.uiData.m_refreshDivisor)
+  {
+    m_vkdd.setRefreshDivisor(uint32_t(m_rd.uiData.m_refreshDivisor));
+  }
+  if(m_rd.lastUIData.m_autoRenderScale != m_rd.uiData.m_autoRenderScale || m_rd.lastUIData.m_renderScale != m_rd.uiData.m_renderScale)
+  {
+    m_vkdd.setAutoRenderScale(m_rd.uiData.m_autoRenderScale);
+    if(!m_rd.uiData.m_autoRenderScale)
+    {
+      m_vkdd.setRenderScale(m_rd.uiData.m_renderScale);
+    }
+    m_rd.presented.valid = false;
+  }
+  if(m_rd.lastUIData.m_modePolicy != m_rd.uiData.m_modePolicy)
+  {
+    // display modes only change with new display surfaces
+    m_vkdd.setModePolicy(VKDirectDisplay::ModePolicy(m_rd.uiData.m_modePolicy), m_vkddConfig.modeWidth,
+                         m_vkddConfig.modeHeight, m_vkddConfig.modeRefreshHz);
+    m_rd.uiData.m_reinitDisplay = true;
+  }
+  if(m_rd.uiData.m_fitMode && m_vkdd.fitModeToRenderTime() > 0.0f)
+  {
+    m_rd.uiData.m_modePolicy    = int(VKDirectDisplay::ModePolicy::eFitRenderTime);
+    m_rd.uiData.m_reinitDisplay = true;
+  }
+  if(m_rd.uiData.m_reinitDisplay)
+  {
+    // full VK teardown and init, the GL side keeps its programs and geometry
+    m_vkdd.reinit();
+    m_rd.presented.valid = false;
+    m_vkdd.setNativeGeometry(m_rd.torus.vertices, m_rd.torus.normals, m_rd.torus.indices);
+    m_rd.uiData.m_reinitDisplay = false;
+  }
 
   m_rd.lastUIData = m_rd.uiData;
 
   // VK_KHR_display
-  // obtain next render texture from VK ddisplay class
-  GLuint tex = m_vkdd.getTexture();
+  // wait until the frame should start to hit the next vblank with minimum latency
+  m_vkdd.waitForRenderStart();
 
   // depending on the algorithm the display w/h depends on window or texture size(s)
+  // the display mode may change while getting the texture, the next frame catches up then
   const int displayWidth  = m_vkdd.getWidth();
   const int displayHeight = m_vkdd.getHeight();
 
+  float           depth      = 1.0f;
+  const glm::vec4 background = glm::vec4(118.f / 255.f, 185.f / 255.f, 0.f / 255.f, 0.f / 255.f);
+
   // setup
   glm::mat4 view;
   {
@@ -596,9 +936,6 @@ void Sample::think(double time)
     auto proj =
         glm::perspectiveRH_ZO(45.f, float(displayWidth) / float(displayHeight), m_rd.sceneData.projNear, m_rd.sceneData.projFar);
 
-    float           depth      = 1.0f;
-    const glm::vec4 background = glm::vec4(118.f / 255.f, 185.f / 255.f, 0.f / 255.f, 0.f / 255.f);
-
     // calculate some coordinate systems
     view                    = m_control.m_viewMatrix;
     glm::mat4 iview         = glm::inverse(view);
@@ -620,39 +957,172 @@ void Sample::think(double time)
     m_rd.sceneData.eyePos_view     = eyePos_view;
     m_rd.sceneData.backgroundColor = glm::vec3(background);
     m_rd.sceneData.fragmentLoad    = m_rd.uiData.m_fragmentLoad;
+  }
+
+  // the displays only show the tori, skip frames that would look like the last presented one
+  // with dynamic resolution keep rendering until the automatic scale is back at full resolution
+  auto const              draws = render::layoutTori(m_rd, m_rd.uiData.m_vertexLoad, displayWidth, displayHeight, view, m_rd.sceneData.viewProjMatrix);
+  std::vector<vk::Rect2D> damage;
+  bool const              changed = render::findChanges(m_rd, draws, displayWidth, displayHeight, damage)
+                       || (m_vkdd.isDynamicResolutionEnabled() && m_vkdd.isAutoRenderScale() && m_vkdd.getRenderScale() < 1.0f);
+  bool const              skip    = m_rd.uiData.m_skipUnchanged && !changed && m_vkdd.canSkipFrame();
+  // a single texture from getTexture() / submitTexture(), not the native renderer or the compositor
+  bool const              interop = !m_vkdd.isNative() && !m_vkdd.isCompositor();
+  if(skip)
+  {
+    NV_PROFILE_GL_SECTION("skip");
+    // VK_KHR_display
+    // no render, no present, the displays keep the last frame
+    m_vkdd.skipFrame();
+  }
+  else
+  {
+    m_rd.presented.valid     = true;
+    m_rd.presented.sceneData = m_rd.sceneData;
+    m_rd.presented.draws     = draws;
+  }
+
+  // VK_KHR_display
+  // obtain next render texture from VK ddisplay class
+  // the native renderer and the compositor draw straight into the swapchain images, GL only shows the UI then
+  GLuint tex = skip ? m_rd.presented.tex : 0;
+  if(!skip && interop)
+  {
+    NV_PROFILE_GL_SECTION("getTexture");
+    tex = m_vkdd.getTexture();
+  }
+  m_rd.presented.tex = tex;
+
+  // the display mode may have changed while rebuilding the swapchain
+  if(int(m_vkdd.getWidth()) != m_rd.uiData.m_texWidth || int(m_vkdd.getHeight()) != m_rd.uiData.m_texHeight)
+  {
+    m_rd.uiData.m_texWidth  = m_vkdd.getWidth();
+    m_rd.uiData.m_texHeight = m_vkdd.getHeight();
+    render::initTextures(m_rd);
+  }
+
+  if(!skip)
+  {
+    NV_PROFILE_GL_SECTION("prepare");
 
     // fill scene UBO
     glNamedBufferSubData(m_rd.buf.sceneUbo, 0, sizeof(SceneData), &m_rd.sceneData);
     glBindBufferBase(GL_UNIFORM_BUFFER, UBO_SCENE, m_rd.buf.sceneUbo);
 
-    // prepare an FBO to render into, clear all textures with a dark gray
-    glBindFramebuffer(GL_FRAMEBUFFER, m_rd.renderFBO);
-    glViewport(0, 0, m_rd.uiData.m_texWidth, m_rd.uiData.m_texHeight);
-
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_rd.tex.depthTex, 0);
+    // VK_KHR_display
+    // frame synthesis: repeated frames are shifted by the camera motion since this one
+    m_vkdd.setViewProjection(m_rd.sceneData.viewProjMatrix);
 
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    if(interop)
     {
-      PRINTE("Framebuffer check failed: {}\n", glCheckFramebufferStatus(GL_FRAMEBUFFER));
-    }
+      // prepare an FBO to render into, clear all textures with a dark gray
+      glBindFramebuffer(GL_FRAMEBUFFER, m_rd.renderFBO);
+
+      // VK_KHR_display
+      // dynamic resolution: only the scaled down part of the texture that VK scales up to the display
+      glViewport(0, 0, m_vkdd.getRenderWidth(), m_vkdd.getRenderHeight());
+
+      // VK_KHR_display
+      // copy fast path: render upside down into the interop texture, VK copies it without flipping
+      if(m_vkdd.isUpperLeftOrigin())
+      {
+        glClipControl(GL_UPPER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+        glFrontFace(GL_CW);
+      }
+
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_rd.tex.depthTex, 0);
+
+      if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+      {
+        PRINTE("Framebuffer check failed: {}\n", glCheckFramebufferStatus(GL_FRAMEBUFFER));
+      }
+
+      glClearBufferfv(GL_COLOR, 0, &background[0]);
+      glClearBufferfv(GL_DEPTH, 0, &depth);
 
-    glClearBufferfv(GL_COLOR, 0, &background[0]);
-    glClearBufferfv(GL_DEPTH, 0, &depth);
+      glUseProgram(m_rd.pm.get(m_rd.prog.scene));
+    }
+  }
 
+  if(!skip && m_vkdd.isNative())
+  {
+    NV_PROFILE_GL_SECTION("renderNative");
+    // VK_KHR_display
+    // same tori, rendered and presented by the VK ddisplay class
+    m_vkdd.renderNative(m_rd.sceneData, draws);
+  }
+  else if(!skip && m_vkdd.isCompositor())
+  {
+    NV_PROFILE_GL_SECTION("renderLayers");
+    // VK_KHR_display
+    // compositor: layer i gets a new frame every i + 1 frames, standing in for producers running at different rates
+    // the VK ddisplay class composes the newest finished frame of each at every frame
+    glBindFramebuffer(GL_FRAMEBUFFER, m_rd.renderFBO);
     glUseProgram(m_rd.pm.get(m_rd.prog.scene));
+    for(uint32_t layer = 0; layer < m_vkdd.getLayerCount(); ++layer)
+    {
+      if(m_frameCount % (layer + 1))
+      {
+        continue;
+      }
+      int const width  = int(m_vkdd.getLayerWidth(layer));
+      int const height = int(m_vkdd.getLayerHeight(layer));
+
+      SceneData scene      = m_rd.sceneData;
+      scene.projMatrix     = glm::perspectiveRH_ZO(45.f, float(width) / float(height), scene.projNear, scene.projFar);
+      scene.viewProjMatrix = scene.projMatrix * view;
+      glNamedBufferSubData(m_rd.buf.sceneUbo, 0, sizeof(SceneData), &scene);
+
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_vkdd.getLayerTexture(layer), 0);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_rd.tex.depthTex, 0);
+      glViewport(0, 0, width, height);
+      glClearBufferfv(GL_COLOR, 0, &background[0]);
+      glClearBufferfv(GL_DEPTH, 0, &depth);
+      renderTori(m_rd, render::layoutTori(m_rd, m_rd.uiData.m_vertexLoad, width, height, view, scene.viewProjMatrix));
+      m_vkdd.submitLayer(layer);
+    }
+    m_vkdd.composeFrame();
   }
+  else if(!skip && m_vkdd.getSliceCount())
+  {
+    NV_PROFILE_GL_SECTION("renderSlices");
+    // VK_KHR_display
+    // beam racing: render and hand over the frame slice by slice, each just before the scanout reaches it
+    // the scissor is in texture rows, which run bottom up unless GL renders upside down for the copy fast path
+    glEnable(GL_SCISSOR_TEST);
+    for(uint32_t slice = 0; slice < m_vkdd.getSliceCount(); ++slice)
+    {
+      int const top    = int(m_vkdd.getSliceTop(slice));
+      int const bottom = int(m_vkdd.getSliceTop(slice + 1));
+      glScissor(0, m_vkdd.isUpperLeftOrigin() ? top : displayHeight - bottom, displayWidth, bottom - top);
+
+      m_vkdd.waitForSlice(slice);
+      renderTori(m_rd, draws);
+      m_vkdd.submitSlice(slice);
+    }
+    glDisable(GL_SCISSOR_TEST);
 
+    glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+    glFrontFace(GL_CCW);
+  }
+  else if(!skip)
   {
     NV_PROFILE_GL_SECTION("render");
     // render tori into texture
-    renderTori(m_rd, m_rd.uiData.m_vertexLoad, displayWidth, displayHeight, view);
+    renderTori(m_rd, draws);
+
+    glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+    glFrontFace(GL_CCW);
   }
 
+  if(!skip && interop && !m_vkdd.getSliceCount())
   {
     NV_PROFILE_GL_SECTION("submit");
     // VK_KHR_display
+    // VK_KHR_incremental_present: only where tori moved, if that's all that changed
     // submit rendered texture to VK ddisplay class
+    m_vkdd.setDamage(damage);
     m_vkdd.submitTexture();
   }
 
@@ -668,8 +1138,9 @@ void Sample::think(double time)
     // set & upload compose data
     m_rd.composeData.out_width  = m_rd.windowWidth;
     m_rd.composeData.out_height = m_rd.windowHeight;
-    m_rd.composeData.in_width   = m_rd.uiData.m_texWidth;
-    m_rd.composeData.in_height  = m_rd.uiData.m_texHeight;
+    m_rd.composeData.in_width   = m_vkdd.getRenderWidth();
+    m_rd.composeData.in_height  = m_vkdd.getRenderHeight();
+    m_rd.composeData.flip_y     = m_vkdd.isUpperLeftOrigin() ? 1 : 0;
     glNamedBufferSubData(m_rd.buf.composeUbo, 0, sizeof(ComposeData), &m_rd.composeData);
     glBindBufferBase(GL_UNIFORM_BUFFER, UBO_COMP, m_rd.buf.composeUbo);
 
@@ -678,8 +1149,11 @@ void Sample::think(double time)
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    // render one triangle covering the whole viewport
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // render one triangle covering the whole viewport, nothing to show from the native renderer
+    if(tex)
+    {
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
   }
 
   if(m_rd.uiData.m_drawUI)
@@ -705,6 +1179,20 @@ void Sample::resize(int width, int height)
 
 void Sample::end()
 {
+  if(m_vkddConfig.headless)
+  {
+    // benchmark summary, getTexture() and submitTexture() themselves are in the profiler output
+    auto const stats = m_vkdd.getStallStats();
+    for(uint32_t i = 0; i < uint32_t(VKDirectDisplay::StallStage::eCount); ++i)
+    {
+      PRINTI("vkdd {}: {} samples, avg {:.3f} ms, {} stalls\n", VKDirectDisplay::getStallStageName(VKDirectDisplay::StallStage(i)),
+             stats.samples[i], stats.samples[i] ? stats.totalMs[i] / double(stats.samples[i]) : 0.0, stats.stalls[i]);
+    }
+    for(const auto& modeStats : m_vkdd.getPresentModeStats())
+    {
+      PRINTI("vkdd {}: {} frames, {:.1f} fps\n", vk::to_string(modeStats.mode), modeStats.frames, modeStats.framesPerSecond);
+    }
+  }
   m_vkdd.shutdown();
 
   nvgl::deleteBuffer(m_rd.buf.vbo);
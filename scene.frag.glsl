@@ -1,10 +1,18 @@
 #version 430
 
+// VULKAN: compiled to SPIR-V for the native renderer, see VKDRenderer
+#ifdef VULKAN
+#extension GL_GOOGLE_include_directive : enable
+#else
 #extension GL_ARB_shading_language_include : enable
+#endif
 #include "common.h"
 #include "noise.glsl"
 
 // inputs in view space
+#ifdef VULKAN
+layout(location=0)
+#endif
 in Interpolants {
   vec3 model_pos;
   vec3 normal;
@@ -1,6 +1,11 @@
  #version 430
 
+// VULKAN: compiled to SPIR-V for the native renderer, see VKDRenderer
+#ifdef VULKAN
+#extension GL_GOOGLE_include_directive : enable
+#else
 #extension GL_ARB_shading_language_include : enable
+#endif
 #include "common.h"
 
 // inputs in model space
@@ -8,6 +13,9 @@ in layout(location=VERTEX_POS)    vec3 vertex_pos_model;
 in layout(location=VERTEX_NORMAL) vec3 normal;
 
 // outputs in view space
+#ifdef VULKAN
+layout(location=0)
+#endif
 out Interpolants {
   vec3 model_pos;
   vec3 normal;